@@ -1,262 +1,6963 @@
+// syscall() (perf_event_open, no Linux) só é declarado em <unistd.h> com
+// _GNU_SOURCE; precisa vir antes de qualquer include
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+#define _GNU_SOURCE
+#endif
 #include <SDL2/SDL.h>
+#include <SDL2/SDL_test_font.h> // SDLTest_DrawString para o overlay
+#include <SDL2/SDL_test_fuzzer.h> // Entradas do teste diferencial (--difftest)
 #include <stdio.h>
 #include <stdlib.h> // Para abs() e qsort()
 #include <math.h>   // Para round() ou floor()
 #include <stdbool.h> // Para bool, true, false
+#include <string.h> // Para strcmp() e memcmp()
+
+// Intrínsecos SSE/AVX. As variantes AVX são compiladas com o atributo
+// target do GCC e só são chamadas se SDL_HasAVX() confirmar o suporte.
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__)) && defined(__SSE2__)
+#include <immintrin.h>
+#define HAVE_X86_SIMD 1
+#define TARGET_AVX  __attribute__((target("avx")))
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define HAVE_X86_SIMD 0
+#endif
+
+// Estado por thread (arena, destino dos rasterizadores): a thread de
+// renderização do modo 14 rasteriza em paralelo com o loop de eventos
+#if defined(_MSC_VER)
+#define THREAD_LOCAL __declspec(thread)
+#else
+#define THREAD_LOCAL _Thread_local
+#endif
+
+// Contadores de hardware (--perf): perf_event_open só existe no Linux
+#if defined(__linux__)
+#include <errno.h>
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#define HAVE_PERF_EVENTS 1
+#else
+#define HAVE_PERF_EVENTS 0
+#endif
 
 // Constantes da tela
 const int SCREEN_WIDTH = 640;
 const int SCREEN_HEIGHT = 480;
 
+// --- Rastreamento de alocações (--alloc-stats) ---
+
+/*
+ * Com --alloc-stats, main() instala alocadores contadores via
+ * SDL_SetMemoryFunctions antes de qualquer outra chamada ao SDL. Toda
+ * alocação do SDL e do próprio main.c (que usa SDL_malloc, inclusive a arena
+ * dos rasterizadores) passa por eles e é atribuída à etiqueta corrente.
+ */
+typedef enum {
+    ALLOC_TAG_RENDERER, // SDL em geral: janela, renderer, eventos, present
+    ALLOC_TAG_FILL,     // Preenchimento de polígonos
+    ALLOC_TAG_CLIP,     // Recorte de linhas
+    ALLOC_TAG_SCENE,    // Montagem da cena
+    ALLOC_TAG_COUNT
+} AllocTag;
+
+const char* const ALLOC_TAG_NAMES[ALLOC_TAG_COUNT] = { "renderer", "fill", "clip", "scene" };
+
+typedef struct {
+    Uint64 calls;  // malloc/calloc/realloc atendidos
+    Uint64 frees;  // free de blocos desta etiqueta
+    Uint64 bytes;  // Bytes entregues (acumulado)
+    Sint64 live;   // Bytes ainda não liberados
+    Sint64 peak;   // Maior valor de 'live'
+} AllocCounters;
+
+AllocCounters alloc_counters[ALLOC_TAG_COUNT];
+THREAD_LOCAL AllocTag alloc_current_tag = ALLOC_TAG_RENDERER;
+bool alloc_tracking = false;
+
+static SDL_malloc_func orig_malloc;
+static SDL_calloc_func orig_calloc;
+static SDL_realloc_func orig_realloc;
+static SDL_free_func orig_free;
+static SDL_SpinLock alloc_lock = 0;
+
+// Cabeçalho escondido antes de cada bloco. A união fixa 16 bytes em qualquer
+// arquitetura (no i386 os campos somam só 8), então o ponteiro entregue
+// mantém o alinhamento que o malloc original deu.
+typedef union {
+    struct {
+        size_t size;
+        int tag;
+    };
+    unsigned char pad[16];
+} AllocHeader;
+SDL_COMPILE_TIME_ASSERT(alloc_header_size, sizeof(AllocHeader) == 16);
+
 /**
- * @brief Desenha uma linha usando o algoritmo do Ponto Médio (Bresenham otimizado).
- * * @param renderer O renderizador SDL.
- * @param x0 Coordenada x inicial.
- * @param y0 Coordenada y inicial.
- * @param x1 Coordenada x final.
- * @param y1 Coordenada y final.
+ * @brief Troca a etiqueta das próximas alocações.
+ * @return A etiqueta anterior, para ser restaurada pelo chamador.
  */
-void draw_line_midpoint(SDL_Renderer* renderer, int x0, int y0, int x1, int y1) {
-    int dx = abs(x1 - x0);
-    int sx = x0 < x1 ? 1 : -1; // Direção do incremento em x
-    int dy = -abs(y1 - y0);
-    int sy = y0 < y1 ? 1 : -1; // Direção do incremento em y
-    int err = dx + dy; // Variável de decisão (erro)
-    int e2; // Erro multiplicado por 2
+AllocTag alloc_set_tag(AllocTag tag) {
+    AllocTag prev = alloc_current_tag;
+    alloc_current_tag = tag;
+    return prev;
+}
 
-    while (1) {
-        SDL_RenderDrawPoint(renderer, x0, y0); // Desenha o pixel atual
+static void* alloc_track(AllocHeader* h, size_t size) {
+    if (!h) return NULL;
+    h->size = size;
+    h->tag = alloc_current_tag;
 
-        // Verifica se alcançou o ponto final
-        if (x0 == x1 && y0 == y1) {
-            break;
+    SDL_AtomicLock(&alloc_lock);
+    AllocCounters* c = &alloc_counters[h->tag];
+    c->calls++;
+    c->bytes += size;
+    c->live += (Sint64)size;
+    if (c->live > c->peak) c->peak = c->live;
+    SDL_AtomicUnlock(&alloc_lock);
+    return h + 1;
+}
+
+static void alloc_untrack(AllocHeader* h) {
+    SDL_AtomicLock(&alloc_lock);
+    AllocCounters* c = &alloc_counters[h->tag];
+    c->frees++;
+    c->live -= (Sint64)h->size;
+    SDL_AtomicUnlock(&alloc_lock);
+}
+
+static void* SDLCALL counting_malloc(size_t size) {
+    return alloc_track((AllocHeader*)orig_malloc(sizeof(AllocHeader) + size), size);
+}
+
+static void* SDLCALL counting_calloc(size_t nmemb, size_t size) {
+    if (size != 0 && nmemb > (SIZE_MAX - sizeof(AllocHeader)) / size) return NULL;
+    return alloc_track((AllocHeader*)orig_calloc(1, sizeof(AllocHeader) + nmemb * size), nmemb * size);
+}
+
+static void* SDLCALL counting_realloc(void* ptr, size_t size) {
+    if (!ptr) return counting_malloc(size);
+    AllocHeader* h = (AllocHeader*)ptr - 1;
+    AllocHeader old = *h;
+    AllocHeader* nh = (AllocHeader*)orig_realloc(h, sizeof(AllocHeader) + size);
+    if (!nh) return NULL; // O bloco antigo continua válido e contado
+    *nh = old;
+    alloc_untrack(nh);
+    return alloc_track(nh, size);
+}
+
+static void SDLCALL counting_free(void* ptr) {
+    if (!ptr) return;
+    AllocHeader* h = (AllocHeader*)ptr - 1;
+    alloc_untrack(h);
+    orig_free(h);
+}
+
+/**
+ * @brief Instala os alocadores contadores. Precisa ser a primeira chamada ao SDL.
+ */
+bool alloc_tracking_install(void) {
+    SDL_GetOriginalMemoryFunctions(&orig_malloc, &orig_calloc, &orig_realloc, &orig_free);
+    if (SDL_SetMemoryFunctions(counting_malloc, counting_calloc, counting_realloc, counting_free) < 0) {
+        printf("Nao foi possivel instalar os alocadores: %s\n", SDL_GetError());
+        return false;
+    }
+    alloc_tracking = true;
+    return true;
+}
+
+/**
+ * @brief Imprime o que cada etiqueta alocou desde 'since' (e atualiza 'since').
+ * Quadros sem nenhuma alocação não imprimem nada: é o estado desejado.
+ */
+void alloc_dump_frame(AllocCounters since[ALLOC_TAG_COUNT], Uint64 frame) {
+    if (!alloc_tracking) return;
+
+    SDL_AtomicLock(&alloc_lock);
+    AllocCounters now[ALLOC_TAG_COUNT];
+    SDL_memcpy(now, alloc_counters, sizeof(now));
+    SDL_AtomicUnlock(&alloc_lock);
+
+    for (int t = 0; t < ALLOC_TAG_COUNT; ++t) {
+        Uint64 calls = now[t].calls - since[t].calls;
+        Uint64 frees = now[t].frees - since[t].frees;
+        if (calls || frees) {
+            printf("[alloc] quadro %llu %-8s +%llu alocs -%llu frees %+lld B (pico %lld B)\n",
+                   (unsigned long long)frame, ALLOC_TAG_NAMES[t],
+                   (unsigned long long)calls, (unsigned long long)frees,
+                   (long long)(now[t].live - since[t].live), (long long)now[t].peak);
         }
+    }
+    SDL_memcpy(since, now, sizeof(now));
+}
 
-        e2 = 2 * err;
+/**
+ * @brief Imprime os totais acumulados por etiqueta.
+ */
+void alloc_dump_totals(void) {
+    if (!alloc_tracking) return;
 
-        // Verifica se é hora de incrementar x
-        if (e2 >= dy) {
-            if (x0 == x1) break; // Evita ultrapassar o limite em retas verticais
-            err += dy;
-            x0 += sx;
+    printf("[alloc] %-8s %10s %10s %12s %12s %12s\n", "etiqueta", "alocs", "frees", "bytes", "vivos", "pico");
+    for (int t = 0; t < ALLOC_TAG_COUNT; ++t) {
+        const AllocCounters* c = &alloc_counters[t];
+        printf("[alloc] %-8s %10llu %10llu %12llu %12lld %12lld\n", ALLOC_TAG_NAMES[t],
+               (unsigned long long)c->calls, (unsigned long long)c->frees,
+               (unsigned long long)c->bytes, (long long)c->live, (long long)c->peak);
+    }
+}
+
+// --- Arena de memória por quadro ---
+
+/*
+ * Alocador "bump" para a memória temporária dos rasterizadores. Tudo que é
+ * alocado durante um quadro é descartado de uma vez por arena_reset() no
+ * loop principal (cada thread tem a sua arena). Os blocos vêm de SDL_malloc; quando um quadro precisa de
+ * mais de um bloco, o reset troca todos por um único bloco maior, então em
+ * regime estável não há nenhuma alocação no heap.
+ */
+typedef struct ArenaBlock {
+    struct ArenaBlock* prev; // Bloco anterior (mais antigo)
+    size_t size;             // Bytes utilizáveis em data
+    size_t used;             // Bytes já entregues
+    unsigned char data[];
+} ArenaBlock;
+
+typedef struct {
+    ArenaBlock* head;   // Bloco atual
+    size_t used;        // Bytes entregues no quadro atual
+    size_t high_water;  // Maior 'used' já visto
+    size_t capacity;    // Soma do tamanho dos blocos
+} FrameArena;
+
+const size_t ARENA_MIN_BLOCK = 64 * 1024;
+const size_t ARENA_ALIGN = 16;
+
+THREAD_LOCAL FrameArena frame_arena = { NULL, 0, 0, 0 };
+
+static ArenaBlock* arena_new_block(size_t size, ArenaBlock* prev) {
+    ArenaBlock* block = (ArenaBlock*)SDL_malloc(sizeof(ArenaBlock) + size + ARENA_ALIGN);
+    if (!block) return NULL;
+    block->prev = prev;
+    block->size = size + ARENA_ALIGN;
+    block->used = 0;
+    return block;
+}
+
+/**
+ * @brief Reserva 'size' bytes (alinhados a 16) que valem até o próximo reset.
+ * @return Ponteiro para a memória ou NULL se o heap acabar.
+ */
+void* arena_alloc(FrameArena* arena, size_t size) {
+    size = (size + ARENA_ALIGN - 1) & ~(ARENA_ALIGN - 1);
+
+    // O cabeçalho do bloco não é múltiplo de 16 em todo alvo: o deslocamento
+    // é corrigido pelo endereço real, e cada bloco reserva essa folga.
+    ArenaBlock* block = arena->head;
+    size_t skew = block ? (0 - (uintptr_t)(block->data + block->used)) & (ARENA_ALIGN - 1) : 0;
+    if (!block || block->size - block->used < size + skew) {
+        size_t block_size = size > ARENA_MIN_BLOCK ? size : ARENA_MIN_BLOCK;
+        block = arena_new_block(block_size, arena->head);
+        if (!block) return NULL;
+        arena->head = block;
+        arena->capacity += block_size;
+        skew = (0 - (uintptr_t)block->data) & (ARENA_ALIGN - 1);
+    }
+
+    void* ptr = block->data + block->used + skew;
+    block->used += size + skew;
+    arena->used += size + skew;
+    if (arena->used > arena->high_water) arena->high_water = arena->used;
+    return ptr;
+}
+
+/**
+ * @brief Descarta tudo o que foi alocado no quadro (chamado uma vez por quadro).
+ */
+void arena_reset(FrameArena* arena) {
+    if (arena->head && arena->head->prev) {
+        // O quadro transbordou o bloco: junta tudo num bloco só, do tamanho
+        // do pico, para que os próximos quadros não aloquem de novo.
+        while (arena->head) {
+            ArenaBlock* prev = arena->head->prev;
+            SDL_free(arena->head);
+            arena->head = prev;
         }
-        
-        // Verifica se é hora de incrementar y
-        if (e2 <= dx) {
-            if (y0 == y1) break; // Evita ultrapassar o limite em retas horizontais
-            err += dx;
-            y0 += sy;
+        size_t size = arena->high_water > ARENA_MIN_BLOCK ? arena->high_water : ARENA_MIN_BLOCK;
+        arena->head = arena_new_block(size, NULL);
+        arena->capacity = arena->head ? size : 0;
+    }
+    if (arena->head) arena->head->used = 0;
+    arena->used = 0;
+}
+
+void arena_destroy(FrameArena* arena) {
+    while (arena->head) {
+        ArenaBlock* prev = arena->head->prev;
+        SDL_free(arena->head);
+        arena->head = prev;
+    }
+    arena->used = 0;
+    arena->capacity = 0;
+}
+
+// --- Escrita de pixels de 32 bits (spans e limpeza) ---
+
+/*
+ * Todo pixel sólido do framebuffer passa por fill_span32: spans dos
+ * rasterizadores e a limpeza do quadro. As variantes SSE2/AVX2 alinham o
+ * destino e gravam 4/8 pixels por vez; fill_span32_init() escolhe a mais
+ * larga que a CPU suporta. Limpezas grandes usam gravações não temporais
+ * (streaming), que não trazem para o cache um quadro que não vai ser lido
+ * tão cedo.
+ */
+typedef void (*FillSpan32Func)(Uint32* dst, int count, Uint32 color);
+
+// A partir deste tamanho a limpeza usa gravações não temporais. Abaixo disso
+// o quadro costuma caber no cache e ser lido logo em seguida (envio para a
+// textura), e o streaming sai mais lento (ver --bench). O autotuner ajusta
+// o limite para a máquina
+size_t fb_stream_bytes = 4 * 1024 * 1024;
+
+static void fill_span32_scalar(Uint32* dst, int count, Uint32 color) {
+    for (int i = 0; i < count; ++i) dst[i] = color;
+}
+
+#if HAVE_X86_SIMD
+static void fill_span32_sse2(Uint32* dst, int count, Uint32 color) {
+    if (count < 8) {
+        fill_span32_scalar(dst, count, color);
+        return;
+    }
+    // Cabeça até o alinhamento de 16 bytes
+    while (count > 0 && ((uintptr_t)dst & 15)) {
+        *dst++ = color;
+        count--;
+    }
+    __m128i c = _mm_set1_epi32((int)color);
+    for (; count >= 8; count -= 8, dst += 8) {
+        _mm_store_si128((__m128i*)dst, c);
+        _mm_store_si128((__m128i*)(dst + 4), c);
+    }
+    for (; count >= 4; count -= 4, dst += 4) {
+        _mm_store_si128((__m128i*)dst, c);
+    }
+    while (count-- > 0) *dst++ = color;
+}
+
+static void fill_span32_stream_sse2(Uint32* dst, int count, Uint32 color) {
+    while (count > 0 && ((uintptr_t)dst & 15)) {
+        *dst++ = color;
+        count--;
+    }
+    __m128i c = _mm_set1_epi32((int)color);
+    for (; count >= 4; count -= 4, dst += 4) {
+        _mm_stream_si128((__m128i*)dst, c);
+    }
+    while (count-- > 0) *dst++ = color;
+    _mm_sfence(); // As gravações não temporais ficam visíveis antes de seguir
+}
+
+TARGET_AVX2 static void fill_span32_avx2(Uint32* dst, int count, Uint32 color) {
+    if (count < 8) {
+        fill_span32_scalar(dst, count, color);
+        return;
+    }
+    while (count > 0 && ((uintptr_t)dst & 31)) {
+        *dst++ = color;
+        count--;
+    }
+    __m256i c = _mm256_set1_epi32((int)color);
+    for (; count >= 16; count -= 16, dst += 16) {
+        _mm256_store_si256((__m256i*)dst, c);
+        _mm256_store_si256((__m256i*)(dst + 8), c);
+    }
+    for (; count >= 8; count -= 8, dst += 8) {
+        _mm256_store_si256((__m256i*)dst, c);
+    }
+    while (count-- > 0) *dst++ = color;
+}
+
+TARGET_AVX2 static void fill_span32_stream_avx2(Uint32* dst, int count, Uint32 color) {
+    while (count > 0 && ((uintptr_t)dst & 31)) {
+        *dst++ = color;
+        count--;
+    }
+    __m256i c = _mm256_set1_epi32((int)color);
+    for (; count >= 8; count -= 8, dst += 8) {
+        _mm256_stream_si256((__m256i*)dst, c);
+    }
+    while (count-- > 0) *dst++ = color;
+    _mm_sfence();
+}
+#endif
+
+// Variantes escolhidas por fill_span32_init() conforme a CPU
+FillSpan32Func fill_span32 = fill_span32_scalar;
+FillSpan32Func fill_span32_stream = fill_span32_scalar;
+
+/**
+ * @brief Escolhe as variantes mais largas que a CPU suporta.
+ * @return Nome da variante escolhida.
+ */
+const char* fill_span32_init(void) {
+#if HAVE_X86_SIMD
+    if (SDL_HasAVX2()) {
+        fill_span32 = fill_span32_avx2;
+        fill_span32_stream = fill_span32_stream_avx2;
+        return "avx2";
+    }
+    fill_span32 = fill_span32_sse2;
+    fill_span32_stream = fill_span32_stream_sse2;
+    return "sse2";
+#else
+    fill_span32 = fill_span32_scalar;
+    fill_span32_stream = fill_span32_scalar;
+    return "escalar";
+#endif
+}
+
+// --- Framebuffer de software ---
+
+/*
+ * Pixels ARGB8888 em memória do programa. Serve para o que seria lento
+ * demais pixel a pixel pelo SDL_Renderer (por exemplo, cores com alpha
+ * variável): escreve-se aqui e o quadro inteiro vai para a tela numa
+ * textura de streaming.
+ */
+typedef struct {
+    Uint32* pixels;       // Alinhado para SIMD (SDL_SIMDAlloc)
+    int width;
+    int height;
+    int pitch;            // Em pixels, múltiplo de 16 (linhas alinhadas em 64 bytes)
+    Uint32 color;         // Cor dos pixels sólidos (raster_point/raster_span)
+    SDL_Texture* texture; // Textura de streaming (NULL sem renderer)
+} Framebuffer;
+
+/**
+ * @brief Cria o framebuffer e, se houver renderer, a textura de apresentação.
+ * @return true se deu certo.
+ */
+bool framebuffer_init(Framebuffer* fb, SDL_Renderer* renderer, int width, int height) {
+    SDL_zerop(fb);
+    fb->width = width;
+    fb->height = height;
+    fb->pitch = (width + 15) & ~15;
+    fb->color = 0xFFFFFFFF;
+    fb->pixels = (Uint32*)SDL_SIMDAlloc((size_t)fb->pitch * height * sizeof(Uint32));
+    if (!fb->pixels) return false;
+    SDL_memset(fb->pixels, 0, (size_t)fb->pitch * height * sizeof(Uint32));
+    if (renderer) {
+        fb->texture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STREAMING, width, height);
+        if (!fb->texture) {
+            printf("Textura do framebuffer nao pode ser criada! Erro: %s\n", SDL_GetError());
+            SDL_SIMDFree(fb->pixels);
+            fb->pixels = NULL;
+            return false;
         }
     }
+    return true;
 }
 
-// Constantes para os 'outcodes' (códigos de região)
-const int INSIDE = 0; // 0000
-const int LEFT   = 1; // 0001
-const int RIGHT  = 2; // 0010
-const int BOTTOM = 4; // 0100
-const int TOP    = 8; // 1000
+void framebuffer_destroy(Framebuffer* fb) {
+    if (fb->texture) SDL_DestroyTexture(fb->texture);
+    SDL_SIMDFree(fb->pixels);
+    SDL_zerop(fb);
+}
+
+static inline Uint32 framebuffer_map(SDL_Color c) {
+    return (Uint32)c.a << 24 | (Uint32)c.r << 16 | (Uint32)c.g << 8 | c.b;
+}
+
+// Limpa o quadro inteiro (o preenchimento entre linhas também, numa só passada)
+void framebuffer_clear(Framebuffer* fb, Uint32 argb) {
+    size_t count = (size_t)fb->pitch * fb->height;
+    if (count * sizeof(Uint32) >= fb_stream_bytes) {
+        fill_span32_stream(fb->pixels, (int)count, argb);
+    } else {
+        fill_span32(fb->pixels, (int)count, argb);
+    }
+}
+
+// Envia o framebuffer para a textura e a copia para a tela inteira
+void framebuffer_present(SDL_Renderer* renderer, Framebuffer* fb) {
+    SDL_UpdateTexture(fb->texture, NULL, fb->pixels, fb->pitch * (int)sizeof(Uint32));
+    SDL_RenderCopy(renderer, fb->texture, NULL, NULL);
+}
+
+static inline void framebuffer_put(Framebuffer* fb, int x, int y) {
+    if ((unsigned)x < (unsigned)fb->width && (unsigned)y < (unsigned)fb->height) {
+        fb->pixels[(size_t)y * fb->pitch + x] = fb->color;
+    }
+}
+
+static inline void framebuffer_span(Framebuffer* fb, int y, int x0, int x1) {
+    if ((unsigned)y >= (unsigned)fb->height) return;
+    if (x0 < 0) x0 = 0;
+    if (x1 >= fb->width) x1 = fb->width - 1;
+    if (x0 > x1) return;
+    fill_span32(fb->pixels + (size_t)y * fb->pitch + x0, x1 - x0 + 1, fb->color);
+}
+
+// --- Destinos de pixel por formato (ARGB8888, RGB565, 8 bits, 1 bit) ---
+
+/*
+ * Os displays embarcados recebem RGB565 ou 8 bits com paleta; desenhar
+ * em 32 bits e converter depois dobra o tráfego de memória. Um
+ * PixelTarget guarda os pixels já no formato de saída e a cor já
+ * convertida. Cada formato tem sua escrita de um pixel e de um span já
+ * recortado (pixel_store_* e pixel_fill_*); DEFINE_PIXEL_WRITERS cola
+ * essas escritas pelo nome nos laços de ponto, span e reta, então cada
+ * formato ganha seu laço próprio, sem nenhum desvio por formato, mesmo
+ * sem otimização (-O0). A escolha do formato acontece uma vez por
+ * primitiva, pela tabela de funções do destino.
+ */
+typedef enum {
+    PIXEL_ARGB8888,
+    PIXEL_RGB565,
+    PIXEL_INDEX8,  // 8 bits com paleta
+    PIXEL_MASK1,   // 1 bit por pixel, bit mais significativo à esquerda
+    PIXEL_FORMAT_COUNT
+} PixelFormatKind;
+
+typedef struct PixelTarget PixelTarget;
+
+typedef struct {
+    void (*point)(PixelTarget* t, int x, int y);
+    void (*span)(PixelTarget* t, int y, int x0, int x1);
+    int (*line)(PixelTarget* t, int x0, int y0, int x1, int y1); // Retorna os pixels escritos
+    void (*clear)(PixelTarget* t);
+} PixelWriters;
+
+struct PixelTarget {
+    Uint8* pixels;               // Alinhado para SIMD (SDL_SIMDAlloc)
+    int width;
+    int height;
+    int pitch;                   // Em bytes, múltiplo de 64
+    PixelFormatKind format;
+    Uint32 color;                // Cor já no formato do destino
+    const SDL_Color* palette;    // Só PIXEL_INDEX8
+    int palette_size;
+    const PixelWriters* writers;
+};
+
+static const char* const PIXEL_FORMAT_NAMES[PIXEL_FORMAT_COUNT] = { "ARGB8888", "RGB565", "INDEX8", "MASK1" };
+
+// Paleta 3-3-2 usada pelos destinos de 8 bits da demonstração
+SDL_Color palette_332[256];
+
+void palette_332_init(void) {
+    for (int i = 0; i < 256; i++) {
+        palette_332[i].r = (Uint8)(((i >> 5) & 7) * 255 / 7);
+        palette_332[i].g = (Uint8)(((i >> 2) & 7) * 255 / 7);
+        palette_332[i].b = (Uint8)((i & 3) * 255 / 3);
+        palette_332[i].a = 255;
+    }
+}
+
+// Escrita de um pixel já recortado, uma por formato
+SDL_FORCE_INLINE void pixel_store_argb8888(PixelTarget* t, Uint8* row, int x) {
+    ((Uint32*)row)[x] = t->color;
+}
+
+SDL_FORCE_INLINE void pixel_store_rgb565(PixelTarget* t, Uint8* row, int x) {
+    ((Uint16*)row)[x] = (Uint16)t->color;
+}
+
+SDL_FORCE_INLINE void pixel_store_index8(PixelTarget* t, Uint8* row, int x) {
+    row[x] = (Uint8)t->color;
+}
+
+SDL_FORCE_INLINE void pixel_store_mask1(PixelTarget* t, Uint8* row, int x) {
+    Uint8 bit = (Uint8)(0x80 >> (x & 7));
+    if (t->color) row[x >> 3] |= bit;
+    else row[x >> 3] &= (Uint8)~bit;
+}
+
+// Span [x0, x1] já recortado numa linha, um por formato
+SDL_FORCE_INLINE void pixel_fill_argb8888(PixelTarget* t, Uint8* row, int x0, int x1) {
+    fill_span32((Uint32*)row + x0, x1 - x0 + 1, t->color);
+}
+
+SDL_FORCE_INLINE void pixel_fill_rgb565(PixelTarget* t, Uint8* row, int x0, int x1) {
+    // Alinha em 4 bytes e escreve dois pixels por palavra com fill_span32
+    Uint16* dst = (Uint16*)row + x0;
+    Uint16 c = (Uint16)t->color;
+    int count = x1 - x0 + 1;
+    if (((uintptr_t)dst & 2) && count > 0) {
+        *dst++ = c;
+        count--;
+    }
+    fill_span32((Uint32*)dst, count >> 1, (Uint32)c * 0x00010001u);
+    if (count & 1) dst[count - 1] = c;
+}
+
+SDL_FORCE_INLINE void pixel_fill_index8(PixelTarget* t, Uint8* row, int x0, int x1) {
+    SDL_memset(row + x0, (int)(t->color & 0xFF), (size_t)(x1 - x0 + 1));
+}
+
+SDL_FORCE_INLINE void pixel_fill_mask1(PixelTarget* t, Uint8* row, int x0, int x1) {
+    // Bytes parciais nas pontas, bytes inteiros no meio
+    int b0 = x0 >> 3, b1 = x1 >> 3;
+    Uint8 first = (Uint8)(0xFF >> (x0 & 7));
+    Uint8 last = (Uint8)(0xFF << (7 - (x1 & 7)));
+    Uint8 fill = t->color ? 0xFF : 0x00;
+    if (b0 == b1) {
+        Uint8 m = first & last;
+        row[b0] = (Uint8)((row[b0] & ~m) | (fill & m));
+        return;
+    }
+    row[b0] = (Uint8)((row[b0] & ~first) | (fill & first));
+    if (b1 > b0 + 1) SDL_memset(row + b0 + 1, fill, (size_t)(b1 - b0 - 1));
+    row[b1] = (Uint8)((row[b1] & ~last) | (fill & last));
+}
+
+// Recorta o span à largura do destino; false se não sobra nada
+SDL_FORCE_INLINE bool pixel_clip_span(const PixelTarget* t, int y, int* x0, int* x1) {
+    if ((unsigned)y >= (unsigned)t->height) return false;
+    if (*x0 < 0) *x0 = 0;
+    if (*x1 >= t->width) *x1 = t->width - 1;
+    return *x0 <= *x1;
+}
+
+// Estado do ponto médio de pixel_line_*: mesmo algoritmo de draw_line_midpoint
+typedef struct {
+    int x, y, x1, y1;
+    int dx, dy, sx, sy, err;
+} PixelLine;
+
+SDL_FORCE_INLINE void pixel_line_begin(PixelLine* l, int x0, int y0, int x1, int y1) {
+    l->x = x0;
+    l->y = y0;
+    l->x1 = x1;
+    l->y1 = y1;
+    l->dx = abs(x1 - x0);
+    l->sx = x0 < x1 ? 1 : -1;
+    l->dy = -abs(y1 - y0);
+    l->sy = y0 < y1 ? 1 : -1;
+    l->err = l->dx + l->dy;
+}
+
+// Avança para o próximo pixel; false quando a reta acabou
+SDL_FORCE_INLINE bool pixel_line_next(PixelLine* l) {
+    if (l->x == l->x1 && l->y == l->y1) return false;
+    int e2 = 2 * l->err;
+    if (e2 >= l->dy) {
+        if (l->x == l->x1) return false;
+        l->err += l->dy;
+        l->x += l->sx;
+    }
+    if (e2 <= l->dx) {
+        if (l->y == l->y1) return false;
+        l->err += l->dx;
+        l->y += l->sy;
+    }
+    return true;
+}
+
+#define DEFINE_PIXEL_WRITERS(suffix) \
+    static void pixel_point_##suffix(PixelTarget* t, int x, int y) { \
+        if ((unsigned)x < (unsigned)t->width && (unsigned)y < (unsigned)t->height) { \
+            pixel_store_##suffix(t, t->pixels + (size_t)y * t->pitch, x); \
+        } \
+    } \
+    static void pixel_span_##suffix(PixelTarget* t, int y, int x0, int x1) { \
+        if (pixel_clip_span(t, y, &x0, &x1)) pixel_fill_##suffix(t, t->pixels + (size_t)y * t->pitch, x0, x1); \
+    } \
+    static int pixel_line_##suffix(PixelTarget* t, int x0, int y0, int x1, int y1) { \
+        PixelLine l; \
+        int written = 0; \
+        pixel_line_begin(&l, x0, y0, x1, y1); \
+        do { \
+            if ((unsigned)l.x < (unsigned)t->width && (unsigned)l.y < (unsigned)t->height) { \
+                pixel_store_##suffix(t, t->pixels + (size_t)l.y * t->pitch, l.x); \
+            } \
+            written++; \
+        } while (pixel_line_next(&l)); \
+        return written; \
+    }
 
-// Janela de recorte (exemplo: 100, 100 a 500, 400)
-const int X_MIN = 100;
-const int X_MAX = 500;
-const int Y_MIN = 100;
-const int Y_MAX = 400;
+DEFINE_PIXEL_WRITERS(argb8888)
+DEFINE_PIXEL_WRITERS(rgb565)
+DEFINE_PIXEL_WRITERS(index8)
+DEFINE_PIXEL_WRITERS(mask1)
+
+// Limpa o destino inteiro com t->color (o preenchimento entre linhas também)
+static void pixel_clear_argb8888(PixelTarget* t) {
+    size_t bytes = (size_t)t->pitch * t->height;
+    if (bytes >= fb_stream_bytes) fill_span32_stream((Uint32*)t->pixels, (int)(bytes / 4), t->color);
+    else fill_span32((Uint32*)t->pixels, (int)(bytes / 4), t->color);
+}
+
+static void pixel_clear_rgb565(PixelTarget* t) {
+    // Duas cores de 16 bits por palavra de 32: reaproveita os laços de fill_span32
+    Uint32 pair = (t->color & 0xFFFF) * 0x00010001u;
+    fill_span32((Uint32*)t->pixels, (int)((size_t)t->pitch * t->height / 4), pair);
+}
+
+static void pixel_clear_index8(PixelTarget* t) {
+    SDL_memset(t->pixels, (int)(t->color & 0xFF), (size_t)t->pitch * t->height);
+}
+
+static void pixel_clear_mask1(PixelTarget* t) {
+    SDL_memset(t->pixels, t->color ? 0xFF : 0x00, (size_t)t->pitch * t->height);
+}
+
+static const PixelWriters PIXEL_WRITERS[PIXEL_FORMAT_COUNT] = {
+    { pixel_point_argb8888, pixel_span_argb8888, pixel_line_argb8888, pixel_clear_argb8888 },
+    { pixel_point_rgb565, pixel_span_rgb565, pixel_line_rgb565, pixel_clear_rgb565 },
+    { pixel_point_index8, pixel_span_index8, pixel_line_index8, pixel_clear_index8 },
+    { pixel_point_mask1, pixel_span_mask1, pixel_line_mask1, pixel_clear_mask1 },
+};
 
 /**
- * @brief Calcula o 'outcode' de 4 bits para um ponto (x, y) 
- * relativo à janela de recorte.
+ * @brief Cria um destino de pixels no formato pedido.
+ * * @param palette Paleta para PIXEL_INDEX8 (ignorada nos outros formatos).
+ * @return true se deu certo.
  */
-int compute_outcode(double x, double y) {
-    int code = INSIDE;
+bool pixel_target_init(PixelTarget* t, PixelFormatKind format, int width, int height, const SDL_Color* palette, int palette_size) {
+    SDL_zerop(t);
+    int row_bytes;
+    switch (format) {
+        case PIXEL_ARGB8888: row_bytes = width * 4; break;
+        case PIXEL_RGB565: row_bytes = width * 2; break;
+        case PIXEL_INDEX8: row_bytes = width; break;
+        case PIXEL_MASK1: row_bytes = (width + 7) / 8; break;
+        default: return false;
+    }
+    if (format == PIXEL_INDEX8 && (!palette || palette_size <= 0)) {
+        printf("Destino de 8 bits precisa de paleta!\n");
+        return false;
+    }
+    t->width = width;
+    t->height = height;
+    t->pitch = (row_bytes + 63) & ~63;
+    t->format = format;
+    t->palette = palette;
+    t->palette_size = palette_size;
+    t->writers = &PIXEL_WRITERS[format];
+    t->pixels = (Uint8*)SDL_SIMDAlloc((size_t)t->pitch * height);
+    if (!t->pixels) return false;
+    SDL_memset(t->pixels, 0, (size_t)t->pitch * height);
+    return true;
+}
 
-    if (x < X_MIN)
-        code |= LEFT;
-    else if (x > X_MAX)
-        code |= RIGHT;
+void pixel_target_destroy(PixelTarget* t) {
+    SDL_SIMDFree(t->pixels);
+    SDL_zerop(t);
+}
 
-    if (y < Y_MIN)
-        code |= BOTTOM;
-    else if (y > Y_MAX)
-        code |= TOP;
+/**
+ * @brief Converte uma cor para o formato do destino (uma vez por cor, não por pixel).
+ */
+Uint32 pixel_target_map(const PixelTarget* t, SDL_Color c) {
+    switch (t->format) {
+        case PIXEL_ARGB8888:
+            return framebuffer_map(c);
+        case PIXEL_RGB565:
+            return (Uint32)(c.r >> 3) << 11 | (Uint32)(c.g >> 2) << 5 | (Uint32)(c.b >> 3);
+        case PIXEL_INDEX8: {
+            // Entrada mais próxima da paleta (distância euclidiana em RGB)
+            int best = 0, best_dist = SDL_MAX_SINT32;
+            for (int i = 0; i < t->palette_size; i++) {
+                int dr = c.r - t->palette[i].r, dg = c.g - t->palette[i].g, db = c.b - t->palette[i].b;
+                int dist = dr * dr + dg * dg + db * db;
+                if (dist < best_dist) {
+                    best_dist = dist;
+                    best = i;
+                }
+            }
+            return (Uint32)best;
+        }
+        case PIXEL_MASK1:
+            return (c.r | c.g | c.b) ? 1u : 0u;
+        default:
+            return 0;
+    }
+}
 
-    return code;
+static inline void pixel_target_set_color(PixelTarget* t, SDL_Color c) {
+    t->color = pixel_target_map(t, c);
+}
+
+/**
+ * @brief Converte o destino para ARGB8888 (só para mostrar na tela).
+ * * @param dst Primeiro pixel de destino; dst_pitch em pixels.
+ */
+void pixel_target_to_argb(const PixelTarget* t, Uint32* dst, int dst_pitch) {
+    for (int y = 0; y < t->height; y++) {
+        const Uint8* row = t->pixels + (size_t)y * t->pitch;
+        Uint32* out = dst + (size_t)y * dst_pitch;
+        switch (t->format) {
+            case PIXEL_ARGB8888:
+                SDL_memcpy(out, row, (size_t)t->width * 4);
+                break;
+            case PIXEL_RGB565:
+                for (int x = 0; x < t->width; x++) {
+                    Uint32 p = ((const Uint16*)row)[x];
+                    Uint32 r = (p >> 11) & 31, g = (p >> 5) & 63, b = p & 31;
+                    out[x] = 0xFF000000u | (r << 3 | r >> 2) << 16 | (g << 2 | g >> 4) << 8 | (b << 3 | b >> 2);
+                }
+                break;
+            case PIXEL_INDEX8:
+                for (int x = 0; x < t->width; x++) out[x] = framebuffer_map(t->palette[row[x]]);
+                break;
+            case PIXEL_MASK1:
+                for (int x = 0; x < t->width; x++) {
+                    out[x] = (row[x >> 3] & (0x80 >> (x & 7))) ? 0xFFFFFFFFu : 0xFF000000u;
+                }
+                break;
+            default: break;
+        }
+    }
+}
+
+// --- Contadores de hardware por estágio (--perf) ---
+
+/*
+ * O tempo de parede não diz se um preenchimento perde para os desvios mal
+ * previstos do teste de arestas ou para as faltas de cache. Com --perf,
+ * cada ponto de entrada dos rasterizadores abre um trecho que lê ciclos,
+ * instruções, desvios mal previstos e faltas de cache (perf_event_open,
+ * só no Linux, num grupo lido com um único read) e soma no seu estágio.
+ * Só o trecho mais externo conta: um estágio chamado de dentro de outro
+ * fica no de fora. Sem perf_event (outro sistema, contêiner, permissão
+ * negada) sobram os tempos. Só a thread principal é medida: os contadores
+ * são da thread que os abriu. Cada trecho custa duas chamadas ao sistema,
+ * então os números de estágios com muitas chamadas pequenas (retas)
+ * incluem esse custo.
+ */
+typedef enum {
+    PERF_STAGE_LINE,          // draw_line_midpoint
+    PERF_STAGE_LINE_WU,       // draw_line_wu
+    PERF_STAGE_FILL_SCANLINE, // fill_polygon_contours
+    PERF_STAGE_FILL_CONVEX,   // fill_convex_polygon
+    PERF_STAGE_FILL_TOPLEFT,  // fill_polygon_topleft
+    PERF_STAGE_FILL_EDGEFLAG, // fill_polygon_edgeflag
+    PERF_STAGE_FILL_AA,       // fill_polygon_aa
+    PERF_STAGE_FILL_SCENE,    // fill_polygons_scene
+    PERF_STAGE_COUNT
+} PerfStage;
+
+static const char* const PERF_STAGE_NAMES[PERF_STAGE_COUNT] = {
+    "reta", "reta wu", "scanline", "convexo", "top-left", "edge flag", "aa", "cena"
+};
+
+typedef enum {
+    PERF_CYCLES,
+    PERF_INSTRUCTIONS,
+    PERF_BRANCH_MISSES,
+    PERF_CACHE_MISSES,
+    PERF_COUNTER_COUNT
+} PerfCounter;
+
+static const char* const PERF_COUNTER_NAMES[PERF_COUNTER_COUNT] = { "ciclos", "instrucoes", "desvios errados", "faltas de cache" };
+
+typedef struct {
+    Uint64 calls;
+    Uint64 ticks; // SDL_GetPerformanceCounter
+    Uint64 counters[PERF_COUNTER_COUNT];
+} PerfStageStats;
+
+typedef struct {
+    PerfStageStats stage[PERF_STAGE_COUNT];
+} PerfStats;
+
+typedef struct {
+    Uint64 ticks;
+    Uint64 counters[PERF_COUNTER_COUNT];
+} PerfSample;
+
+bool perf_enabled = false;                    // --perf: trechos ligados
+bool perf_counters_available[PERF_COUNTER_COUNT]; // Contadores que o kernel aceitou
+PerfStats perf_frame;                         // Quadro em andamento
+PerfStats perf_last_frame;                    // Último quadro fechado (overlay)
+PerfStats perf_run;                           // Soma da execução
+THREAD_LOCAL bool perf_thread = false;        // Só a thread que abriu os contadores mede
+THREAD_LOCAL int perf_depth = 0;              // Trechos abertos (só o mais externo conta)
+
+#if HAVE_PERF_EVENTS
+static int perf_group_fd = -1;
+static int perf_fds[PERF_COUNTER_COUNT] = { -1, -1, -1, -1 };
+static int perf_group_index[PERF_COUNTER_COUNT]; // Posição no resultado do read do grupo
+static int perf_group_size = 0;
+
+static int perf_open_counter(Uint64 config, int group_fd) {
+    struct perf_event_attr attr;
+    SDL_zero(attr);
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.size = sizeof(attr);
+    attr.config = config;
+    attr.read_format = PERF_FORMAT_GROUP;
+    attr.exclude_kernel = 1; // Basta perf_event_paranoid <= 2
+    attr.exclude_hv = 1;
+    return (int)syscall(SYS_perf_event_open, &attr, 0, -1, group_fd, 0);
+}
+#endif
+
+/**
+ * @brief Liga os trechos na thread atual e abre os contadores que o
+ * sistema permitir. Sem nenhum, os estágios continuam só com tempos.
+ */
+void perf_init(void) {
+    perf_enabled = true;
+    perf_thread = true;
+    SDL_zero(perf_frame);
+    SDL_zero(perf_last_frame);
+    SDL_zero(perf_run);
+#if HAVE_PERF_EVENTS
+    static const Uint64 configs[PERF_COUNTER_COUNT] = {
+        PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS, PERF_COUNT_HW_BRANCH_MISSES, PERF_COUNT_HW_CACHE_MISSES
+    };
+    int first_error = 0;
+    for (int c = 0; c < PERF_COUNTER_COUNT; ++c) {
+        int fd = perf_open_counter(configs[c], perf_group_fd);
+        if (fd < 0) {
+            if (!first_error) first_error = errno;
+            continue;
+        }
+        if (perf_group_fd < 0) perf_group_fd = fd;
+        perf_fds[c] = fd;
+        perf_group_index[c] = perf_group_size++;
+        perf_counters_available[c] = true;
+    }
+    if (perf_group_size == 0) {
+        printf("perf_event indisponivel (%s): --perf mede so tempos.\n", strerror(first_error));
+        return;
+    }
+    printf("perf_event:");
+    for (int c = 0; c < PERF_COUNTER_COUNT; ++c) {
+        printf(" %s%s", PERF_COUNTER_NAMES[c], perf_counters_available[c] ? "" : " (indisponivel)");
+    }
+    printf("\n");
+#else
+    printf("perf_event so existe no Linux: --perf mede so tempos.\n");
+#endif
+}
+
+void perf_shutdown(void) {
+#if HAVE_PERF_EVENTS
+    for (int c = 0; c < PERF_COUNTER_COUNT; ++c) {
+        if (perf_fds[c] >= 0 && perf_fds[c] != perf_group_fd) close(perf_fds[c]);
+        perf_fds[c] = -1;
+        perf_counters_available[c] = false;
+    }
+    if (perf_group_fd >= 0) close(perf_group_fd);
+    perf_group_fd = -1;
+    perf_group_size = 0;
+#endif
+    perf_enabled = false;
+    perf_thread = false;
+}
+
+static void perf_read(PerfSample* s) {
+    s->ticks = SDL_GetPerformanceCounter();
+#if HAVE_PERF_EVENTS
+    if (perf_group_size > 0) {
+        Uint64 buf[1 + PERF_COUNTER_COUNT]; // nr, valores na ordem de abertura
+        if (read(perf_group_fd, buf, sizeof(buf)) >= (ssize_t)((1 + perf_group_size) * sizeof(Uint64))) {
+            for (int c = 0; c < PERF_COUNTER_COUNT; ++c) {
+                s->counters[c] = perf_counters_available[c] ? buf[1 + perf_group_index[c]] : 0;
+            }
+            return;
+        }
+    }
+#endif
+    SDL_zeroa(s->counters);
+}
+
+// Abre um trecho; devolve false se este não conta (desligado, outra thread ou aninhado)
+static inline bool perf_begin(PerfSample* start) {
+    if (!perf_thread || perf_depth++ > 0) return false;
+    perf_read(start);
+    return true;
+}
+
+static inline void perf_end(PerfStage stage, const PerfSample* start, bool counted) {
+    if (!perf_thread) return;
+    perf_depth--;
+    if (!counted) return;
+    PerfSample end;
+    perf_read(&end);
+    PerfStageStats* st = &perf_frame.stage[stage];
+    st->calls++;
+    st->ticks += end.ticks - start->ticks;
+    for (int c = 0; c < PERF_COUNTER_COUNT; ++c) st->counters[c] += end.counters[c] - start->counters[c];
+}
+
+static void perf_stats_add(PerfStats* dst, const PerfStats* src) {
+    for (int s = 0; s < PERF_STAGE_COUNT; ++s) {
+        dst->stage[s].calls += src->stage[s].calls;
+        dst->stage[s].ticks += src->stage[s].ticks;
+        for (int c = 0; c < PERF_COUNTER_COUNT; ++c) dst->stage[s].counters[c] += src->stage[s].counters[c];
+    }
+}
+
+/**
+ * @brief Fecha o quadro: ele vira o último quadro e entra na soma da execução.
+ */
+void perf_frame_end(void) {
+    if (!perf_enabled) return;
+    perf_stats_add(&perf_run, &perf_frame);
+    perf_last_frame = perf_frame;
+    SDL_zero(perf_frame);
+}
+
+/**
+ * @brief Resumo de um estágio numa linha (IPC e taxas por instrução quando
+ * os contadores existem).
+ */
+void perf_format_stage(char* out, size_t size, const PerfStats* stats, PerfStage stage) {
+    const PerfStageStats* st = &stats->stage[stage];
+    double ms = (double)st->ticks * 1000.0 / (double)SDL_GetPerformanceFrequency();
+    int n = snprintf(out, size, "%-9s %6llu x %8.3f ms", PERF_STAGE_NAMES[stage], (unsigned long long)st->calls, ms);
+    if (n < 0 || (size_t)n >= size) return;
+    const Uint64* k = st->counters;
+    if (perf_counters_available[PERF_CYCLES] && perf_counters_available[PERF_INSTRUCTIONS] && k[PERF_CYCLES] > 0) {
+        n += snprintf(out + n, size - n, "  ipc %.2f", (double)k[PERF_INSTRUCTIONS] / (double)k[PERF_CYCLES]);
+    }
+    if (n < 0 || (size_t)n >= size) return;
+    if (perf_counters_available[PERF_INSTRUCTIONS] && k[PERF_INSTRUCTIONS] > 0) {
+        double ki = (double)k[PERF_INSTRUCTIONS] / 1000.0;
+        if (perf_counters_available[PERF_BRANCH_MISSES]) {
+            n += snprintf(out + n, size - n, "  desv %.2f/ki", (double)k[PERF_BRANCH_MISSES] / ki);
+        }
+        if (n < 0 || (size_t)n >= size) return;
+        if (perf_counters_available[PERF_CACHE_MISSES]) {
+            snprintf(out + n, size - n, "  cache %.2f/ki", (double)k[PERF_CACHE_MISSES] / ki);
+        }
+    }
+}
+
+/**
+ * @brief Tabela por estágio da execução inteira, com os contadores brutos.
+ * * @param frames Quadros somados, para as médias por quadro.
+ */
+void perf_print_run(int frames) {
+    if (!perf_enabled) return;
+    printf("Contadores por estagio (%d quadros):\n", frames);
+    for (int s = 0; s < PERF_STAGE_COUNT; ++s) {
+        const PerfStageStats* st = &perf_run.stage[s];
+        if (st->calls == 0) continue;
+        char line[160];
+        perf_format_stage(line, sizeof(line), &perf_run, (PerfStage)s);
+        printf("  %s\n", line);
+        printf("  %9s ", "");
+        printf(" %.3f ms/quadro", frames > 0 ? (double)st->ticks * 1000.0 / (double)SDL_GetPerformanceFrequency() / frames : 0.0);
+        for (int c = 0; c < PERF_COUNTER_COUNT; ++c) {
+            if (perf_counters_available[c]) printf(", %llu %s", (unsigned long long)st->counters[c], PERF_COUNTER_NAMES[c]);
+        }
+        printf("\n");
+    }
+}
+
+// --- Saída dos rasterizadores ---
+
+/*
+ * Todo pixel que os rasterizadores produzem passa por raster_point() ou
+ * raster_span(). Normalmente eles desenham no renderer; com uma gravação
+ * ativa (raster_recording), os pontos e spans são guardados para serem
+ * repetidos depois sem rasterizar de novo (ver RetainedShape). Com
+ * raster_framebuffer definido, vão para ele na cor fb->color; com
+ * raster_target, vão para o PixelTarget pelas escritas do seu formato.
+ * Com raster_overdraw, nenhuma cor é escrita: só se conta cada escrita.
+ */
+typedef struct {
+    SDL_Rect* spans;      // Spans como retângulos de 1 pixel de altura
+    int num_spans;
+    int span_capacity;
+    SDL_Point* points;
+    int num_points;
+    int point_capacity;
+    bool clip;            // Só grava o que cai dentro de [x_min, x_max] x [y_min, y_max]
+    int x_min, y_min, x_max, y_max;
+    bool failed;          // Faltou memória em algum momento
+    Uint64 num_pixels;    // Pixels cobertos pelos spans e pontos gravados
+} RasterRecording;
+
+THREAD_LOCAL RasterRecording* raster_recording = NULL;
+THREAD_LOCAL Framebuffer* raster_framebuffer = NULL;
+THREAD_LOCAL PixelTarget* raster_target = NULL;
+
+// Pixels efetivamente escritos no renderer (para medir sobreposição)
+THREAD_LOCAL Uint64 raster_pixels_written = 0;
+
+/*
+ * Mapa de sobreposição (tecla O): com raster_overdraw definido, os
+ * rasterizadores somam 1 num contador de 8 bits por pixel em vez de
+ * escrever cor. Os contadores saturam em 255; o total de escritas é exato.
+ */
+typedef struct {
+    Uint8* counts;  // width x height, linha a linha
+    int width;
+    int height;
+    Uint64 writes;  // Escritas dentro da tela no quadro
+} OverdrawBuffer;
+
+THREAD_LOCAL OverdrawBuffer* raster_overdraw = NULL;
+
+static inline void overdraw_point(OverdrawBuffer* od, int x, int y) {
+    if ((unsigned)x >= (unsigned)od->width || (unsigned)y >= (unsigned)od->height) return;
+    Uint8* c = od->counts + (size_t)y * od->width + x;
+    *c += *c < 255;
+    od->writes++;
+}
+
+static inline void overdraw_span(OverdrawBuffer* od, int y, int x0, int x1) {
+    if ((unsigned)y >= (unsigned)od->height) return;
+    if (x0 < 0) x0 = 0;
+    if (x1 >= od->width) x1 = od->width - 1;
+    if (x0 > x1) return;
+    Uint8* row = od->counts + (size_t)y * od->width;
+    int x = x0;
+#if HAVE_X86_SIMD
+    // Soma saturada de 16 contadores por vez
+    const __m128i one = _mm_set1_epi8(1);
+    for (; x + 15 <= x1; x += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i*)(row + x));
+        _mm_storeu_si128((__m128i*)(row + x), _mm_adds_epu8(v, one));
+    }
+#endif
+    for (; x <= x1; ++x) row[x] += row[x] < 255;
+    od->writes += (Uint64)(x1 - x0 + 1);
+}
+
+static void recording_add_span(RasterRecording* rec, int y, int x0, int x1) {
+    if (rec->clip) {
+        if (y < rec->y_min || y > rec->y_max) return;
+        if (x0 < rec->x_min) x0 = rec->x_min;
+        if (x1 > rec->x_max) x1 = rec->x_max;
+        if (x0 > x1) return;
+    }
+    if (rec->num_spans == rec->span_capacity) {
+        int capacity = rec->span_capacity ? rec->span_capacity * 2 : 64;
+        SDL_Rect* spans = (SDL_Rect*)SDL_realloc(rec->spans, capacity * sizeof(SDL_Rect));
+        if (!spans) {
+            rec->failed = true;
+            return;
+        }
+        rec->spans = spans;
+        rec->span_capacity = capacity;
+    }
+    SDL_Rect span = { x0, y, x1 - x0 + 1, 1 };
+    rec->spans[rec->num_spans++] = span;
+    rec->num_pixels += (Uint64)span.w;
+}
+
+static void recording_add_point(RasterRecording* rec, int x, int y) {
+    if (rec->clip && (x < rec->x_min || x > rec->x_max || y < rec->y_min || y > rec->y_max)) return;
+    if (rec->num_points == rec->point_capacity) {
+        int capacity = rec->point_capacity ? rec->point_capacity * 2 : 64;
+        SDL_Point* points = (SDL_Point*)SDL_realloc(rec->points, capacity * sizeof(SDL_Point));
+        if (!points) {
+            rec->failed = true;
+            return;
+        }
+        rec->points = points;
+        rec->point_capacity = capacity;
+    }
+    SDL_Point p = { x, y };
+    rec->points[rec->num_points++] = p;
+    rec->num_pixels++;
+}
+
+static inline void raster_point(SDL_Renderer* renderer, int x, int y) {
+    if (raster_recording) {
+        recording_add_point(raster_recording, x, y);
+        return;
+    }
+    raster_pixels_written++;
+    if (raster_overdraw) {
+        overdraw_point(raster_overdraw, x, y);
+        return;
+    }
+    if (raster_framebuffer) {
+        framebuffer_put(raster_framebuffer, x, y);
+        return;
+    }
+    if (raster_target) {
+        raster_target->writers->point(raster_target, x, y);
+        return;
+    }
+    SDL_RenderDrawPoint(renderer, x, y);
+}
+
+// Span horizontal [x0, x1] (inclusive) na linha y; espera x0 <= x1
+static inline void raster_span(SDL_Renderer* renderer, int y, int x0, int x1) {
+    if (raster_recording) {
+        recording_add_span(raster_recording, y, x0, x1);
+        return;
+    }
+    raster_pixels_written += (Uint64)(x1 - x0 + 1);
+    if (raster_overdraw) {
+        overdraw_span(raster_overdraw, y, x0, x1);
+        return;
+    }
+    if (raster_framebuffer) {
+        framebuffer_span(raster_framebuffer, y, x0, x1);
+        return;
+    }
+    if (raster_target) {
+        raster_target->writers->span(raster_target, y, x0, x1);
+        return;
+    }
+    SDL_RenderDrawLine(renderer, x0, y, x1, y);
+}
+
+// Área [x0, x1) x [y0, y1) em que raster_point/raster_span escrevem agora,
+// para recortar antes de rasterizar; uma gravação sem recorte não tem limite
+static void raster_output_bounds(SDL_Renderer* renderer, int* x0, int* y0, int* x1, int* y1) {
+    *x0 = 0;
+    *y0 = 0;
+    if (raster_recording) {
+        bool clip = raster_recording->clip;
+        *x0 = clip ? raster_recording->x_min : SDL_MIN_SINT32 / 2;
+        *y0 = clip ? raster_recording->y_min : SDL_MIN_SINT32 / 2;
+        *x1 = clip ? raster_recording->x_max + 1 : SDL_MAX_SINT32 / 2;
+        *y1 = clip ? raster_recording->y_max + 1 : SDL_MAX_SINT32 / 2;
+    } else if (raster_overdraw) {
+        *x1 = raster_overdraw->width;
+        *y1 = raster_overdraw->height;
+    } else if (raster_framebuffer) {
+        *x1 = raster_framebuffer->width;
+        *y1 = raster_framebuffer->height;
+    } else if (raster_target) {
+        *x1 = raster_target->width;
+        *y1 = raster_target->height;
+    } else if (!renderer || SDL_GetRendererOutputSize(renderer, x1, y1) != 0) {
+        *x1 = SCREEN_WIDTH;
+        *y1 = SCREEN_HEIGHT;
+    }
+}
+
+/**
+ * @brief Desenha uma linha usando o algoritmo do Ponto Médio (Bresenham otimizado).
+ * * @param renderer O renderizador SDL.
+ * @param x0 Coordenada x inicial.
+ * @param y0 Coordenada y inicial.
+ * @param x1 Coordenada x final.
+ * @param y1 Coordenada y final.
+ */
+static void draw_line_midpoint_impl(SDL_Renderer* renderer, int x0, int y0, int x1, int y1) {
+    if (raster_target && !raster_recording && !raster_overdraw) {
+        // Laço especializado no formato do destino, sem passar por raster_point()
+        raster_pixels_written += (Uint64)raster_target->writers->line(raster_target, x0, y0, x1, y1);
+        return;
+    }
+
+    int dx = abs(x1 - x0);
+    int sx = x0 < x1 ? 1 : -1; // Direção do incremento em x
+    int dy = -abs(y1 - y0);
+    int sy = y0 < y1 ? 1 : -1; // Direção do incremento em y
+    int err = dx + dy; // Variável de decisão (erro)
+    int e2; // Erro multiplicado por 2
+
+    while (1) {
+        raster_point(renderer, x0, y0); // Desenha o pixel atual
+
+        // Verifica se alcançou o ponto final
+        if (x0 == x1 && y0 == y1) {
+            break;
+        }
+
+        e2 = 2 * err;
+
+        // Verifica se é hora de incrementar x
+        if (e2 >= dy) {
+            if (x0 == x1) break; // Evita ultrapassar o limite em retas verticais
+            err += dy;
+            x0 += sx;
+        }
+        
+        // Verifica se é hora de incrementar y
+        if (e2 <= dx) {
+            if (y0 == y1) break; // Evita ultrapassar o limite em retas horizontais
+            err += dx;
+            y0 += sy;
+        }
+    }
+}
+
+// Ponto de entrada medido por --perf
+void draw_line_midpoint(SDL_Renderer* renderer, int x0, int y0, int x1, int y1) {
+    PerfSample start;
+    bool counted = perf_begin(&start);
+    draw_line_midpoint_impl(renderer, x0, y0, x1, y1);
+    perf_end(PERF_STAGE_LINE, &start, counted);
+}
+
+// --- Retas anti-aliased (Xiaolin Wu) no framebuffer ---
+
+typedef enum {
+    LINE_ALIASED,     // Ponto médio, pixels sólidos
+    LINE_ANTIALIASED  // Wu, dois pixels por passo com cobertura complementar
+} LineStyle;
+
+// Pixels a misturar acumulados antes de cada mistura em lote
+enum { WU_BATCH = 256 };
+
+typedef struct {
+    Uint32 offset[WU_BATCH]; // Índice do pixel no framebuffer
+    Uint8 alpha[WU_BATCH];   // Cobertura x alpha da cor
+    int count;
+} WuBatch;
+
+/*
+ * dst = (src * a + dst * (255 - a)) / 255 por canal, arredondado: com x já
+ * somado de 128, (x + (x >> 8)) >> 8 é a divisão exata e cabe em 16 bits.
+ * A versão SSE2 faz a mesma conta, então o resultado não depende do caminho.
+ */
+static inline Uint32 blend_pixel(Uint32 dst, Uint32 src, Uint32 a) {
+    Uint32 out = 0;
+    for (int shift = 0; shift < 32; shift += 8) {
+        Uint32 x = ((src >> shift) & 0xFF) * a + ((dst >> shift) & 0xFF) * (255 - a) + 128;
+        out |= ((x + (x >> 8)) >> 8) << shift;
+    }
+    return out;
+}
+
+static void wu_flush_scalar(Framebuffer* fb, WuBatch* b, Uint32 src) {
+    for (int i = 0; i < b->count; ++i) {
+        Uint32* p = fb->pixels + b->offset[i];
+        *p = blend_pixel(*p, src, b->alpha[i]);
+    }
+    b->count = 0;
+}
+
+#if HAVE_X86_SIMD
+// Mistura 4 pixels por vez; o lote não pode repetir pixels
+static void wu_flush_sse2(Framebuffer* fb, WuBatch* b, Uint32 src) {
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i c255 = _mm_set1_epi16(255);
+    const __m128i c128 = _mm_set1_epi16(128);
+    const __m128i src16 = _mm_unpacklo_epi8(_mm_set1_epi32((int)src), zero);
+    Uint32* pixels = fb->pixels;
+    int i = 0;
+
+    for (; i + 4 <= b->count; i += 4) {
+        const Uint32* o = b->offset + i;
+        __m128i dst = _mm_set_epi32((int)pixels[o[3]], (int)pixels[o[2]], (int)pixels[o[1]], (int)pixels[o[0]]);
+        // alpha de cada pixel repetido nos 4 canais, em 16 bits
+        __m128i a = _mm_set_epi16(b->alpha[i + 1], b->alpha[i + 1], b->alpha[i + 1], b->alpha[i + 1],
+                                  b->alpha[i], b->alpha[i], b->alpha[i], b->alpha[i]);
+        __m128i a_hi = _mm_set_epi16(b->alpha[i + 3], b->alpha[i + 3], b->alpha[i + 3], b->alpha[i + 3],
+                                     b->alpha[i + 2], b->alpha[i + 2], b->alpha[i + 2], b->alpha[i + 2]);
+
+        __m128i lo = _mm_unpacklo_epi8(dst, zero);
+        __m128i hi = _mm_unpackhi_epi8(dst, zero);
+        lo = _mm_add_epi16(_mm_add_epi16(_mm_mullo_epi16(src16, a), _mm_mullo_epi16(lo, _mm_sub_epi16(c255, a))), c128);
+        hi = _mm_add_epi16(_mm_add_epi16(_mm_mullo_epi16(src16, a_hi), _mm_mullo_epi16(hi, _mm_sub_epi16(c255, a_hi))), c128);
+        lo = _mm_srli_epi16(_mm_add_epi16(lo, _mm_srli_epi16(lo, 8)), 8);
+        hi = _mm_srli_epi16(_mm_add_epi16(hi, _mm_srli_epi16(hi, 8)), 8);
+        __m128i out = _mm_packus_epi16(lo, hi);
+
+        pixels[o[0]] = (Uint32)_mm_cvtsi128_si32(out);
+        pixels[o[1]] = (Uint32)_mm_cvtsi128_si32(_mm_shuffle_epi32(out, _MM_SHUFFLE(1, 1, 1, 1)));
+        pixels[o[2]] = (Uint32)_mm_cvtsi128_si32(_mm_shuffle_epi32(out, _MM_SHUFFLE(2, 2, 2, 2)));
+        pixels[o[3]] = (Uint32)_mm_cvtsi128_si32(_mm_shuffle_epi32(out, _MM_SHUFFLE(3, 3, 3, 3)));
+    }
+    for (; i < b->count; ++i) {
+        Uint32* p = pixels + b->offset[i];
+        *p = blend_pixel(*p, src, b->alpha[i]);
+    }
+    b->count = 0;
+}
+#endif
+
+static inline void wu_flush(Framebuffer* fb, WuBatch* b, Uint32 src) {
+#if HAVE_X86_SIMD
+    wu_flush_sse2(fb, b, src);
+#else
+    wu_flush_scalar(fb, b, src);
+#endif
+}
+
+// Enfileira um pixel com cobertura 'coverage' (0..1); 'steep' troca x e y
+static inline void wu_plot(Framebuffer* fb, WuBatch* b, Uint32 src, Uint8 color_a,
+                           bool steep, int x, int y, float coverage) {
+    if (steep) {
+        int t = x; x = y; y = t;
+    }
+    if ((unsigned)x >= (unsigned)fb->width || (unsigned)y >= (unsigned)fb->height) return;
+    Uint8 a = (Uint8)(coverage * color_a + 0.5f);
+    if (a == 0) return;
+    if (raster_overdraw) {
+        overdraw_point(raster_overdraw, x, y);
+        return;
+    }
+    if (b->count == WU_BATCH) wu_flush(fb, b, src);
+    b->offset[b->count] = (Uint32)y * (Uint32)fb->pitch + (Uint32)x;
+    b->alpha[b->count] = a;
+    b->count++;
+}
+
+/**
+ * @brief Desenha uma linha anti-aliased (algoritmo de Xiaolin Wu) no framebuffer.
+ * Os pixels e suas coberturas são acumulados em lote e misturados 4 por vez
+ * com SSE2. As pontas são misturadas à parte porque, em retas curtas, podem
+ * cair no mesmo pixel (o lote não aceita repetições).
+ * * @param fb O framebuffer de destino.
+ * @param x0 Coordenada x inicial (subpixel).
+ * @param y0 Coordenada y inicial (subpixel).
+ * @param x1 Coordenada x final (subpixel).
+ * @param y1 Coordenada y final (subpixel).
+ * @param color Cor da linha (o alpha multiplica a cobertura).
+ */
+static void draw_line_wu_impl(Framebuffer* fb, float x0, float y0, float x1, float y1, SDL_Color color) {
+    bool steep = fabsf(y1 - y0) > fabsf(x1 - x0);
+    float t;
+    if (steep) {
+        t = x0; x0 = y0; y0 = t;
+        t = x1; x1 = y1; y1 = t;
+    }
+    if (x0 > x1) {
+        t = x0; x0 = x1; x1 = t;
+        t = y0; y0 = y1; y1 = t;
+    }
+    float dx = x1 - x0;
+    float gradient = dx == 0.0f ? 1.0f : (y1 - y0) / dx;
+    Uint32 src = framebuffer_map(color) | 0xFF000000;
+    WuBatch batch; // Na pilha: ~1,3 KB, reusado por todos os pixels da reta
+    batch.count = 0;
+
+    // Primeira ponta
+    float xend = floorf(x0 + 0.5f);
+    float yend = y0 + gradient * (xend - x0);
+    float xgap = 1.0f - (x0 + 0.5f - floorf(x0 + 0.5f));
+    int xpxl1 = (int)xend;
+    int ypxl1 = (int)floorf(yend);
+    float f = yend - floorf(yend);
+    wu_plot(fb, &batch, src, color.a, steep, xpxl1, ypxl1, (1.0f - f) * xgap);
+    wu_plot(fb, &batch, src, color.a, steep, xpxl1, ypxl1 + 1, f * xgap);
+    wu_flush_scalar(fb, &batch, src);
+    float intery = yend + gradient;
+
+    // Segunda ponta
+    xend = floorf(x1 + 0.5f);
+    yend = y1 + gradient * (xend - x1);
+    xgap = x1 + 0.5f - floorf(x1 + 0.5f);
+    int xpxl2 = (int)xend;
+    int ypxl2 = (int)floorf(yend);
+    f = yend - floorf(yend);
+    wu_plot(fb, &batch, src, color.a, steep, xpxl2, ypxl2, (1.0f - f) * xgap);
+    wu_plot(fb, &batch, src, color.a, steep, xpxl2, ypxl2 + 1, f * xgap);
+    wu_flush_scalar(fb, &batch, src);
+
+    // Meio: cada coluna recebe dois pixels, distintos de todos os outros
+    for (int x = xpxl1 + 1; x < xpxl2; ++x) {
+        int y = (int)floorf(intery);
+        f = intery - (float)y;
+        wu_plot(fb, &batch, src, color.a, steep, x, y, 1.0f - f);
+        wu_plot(fb, &batch, src, color.a, steep, x, y + 1, f);
+        intery += gradient;
+    }
+    wu_flush(fb, &batch, src);
+    raster_pixels_written += (Uint64)(xpxl2 - xpxl1 + 1) * 2;
+}
+
+// Ponto de entrada medido por --perf
+void draw_line_wu(Framebuffer* fb, float x0, float y0, float x1, float y1, SDL_Color color) {
+    PerfSample start;
+    bool counted = perf_begin(&start);
+    draw_line_wu_impl(fb, x0, y0, x1, y1, color);
+    perf_end(PERF_STAGE_LINE_WU, &start, counted);
+}
+
+/**
+ * @brief Desenha uma linha no framebuffer no estilo pedido.
+ * LINE_ALIASED usa o ponto médio (pixels sólidos via raster_framebuffer);
+ * LINE_ANTIALIASED usa draw_line_wu.
+ */
+void framebuffer_draw_line(Framebuffer* fb, float x0, float y0, float x1, float y1, SDL_Color color, LineStyle style) {
+    if (style == LINE_ANTIALIASED) {
+        draw_line_wu(fb, x0, y0, x1, y1, color);
+        return;
+    }
+    Framebuffer* prev = raster_framebuffer;
+    raster_framebuffer = fb;
+    fb->color = framebuffer_map(color);
+    draw_line_midpoint(NULL, (int)lrintf(x0), (int)lrintf(y0), (int)lrintf(x1), (int)lrintf(y1));
+    raster_framebuffer = prev;
+}
+
+// Constantes para os 'outcodes' (códigos de região)
+const int INSIDE = 0; // 0000
+const int LEFT   = 1; // 0001
+const int RIGHT  = 2; // 0010
+const int BOTTOM = 4; // 0100
+const int TOP    = 8; // 1000
+
+// Janela de recorte (exemplo: 100, 100 a 500, 400). Pode ser ajustada em
+// tempo de execução por set_clip_window(); caches que dependem dela guardam
+// clip_window_version para saber quando ficaram velhos.
+int X_MIN = 100;
+int X_MAX = 500;
+int Y_MIN = 100;
+int Y_MAX = 400;
+Uint32 clip_window_version = 0;
+
+/**
+ * @brief Troca a janela de recorte (ignora janelas vazias).
+ */
+void set_clip_window(int x_min, int y_min, int x_max, int y_max) {
+    if (x_min >= x_max || y_min >= y_max) return;
+    if (x_min == X_MIN && y_min == Y_MIN && x_max == X_MAX && y_max == Y_MAX) return;
+    X_MIN = x_min;
+    Y_MIN = y_min;
+    X_MAX = x_max;
+    Y_MAX = y_max;
+    clip_window_version++;
+}
+
+/**
+ * @brief Calcula o 'outcode' de 4 bits para um ponto (x, y) 
+ * relativo à janela de recorte.
+ */
+int compute_outcode(double x, double y) {
+    int code = INSIDE;
+
+    if (x < X_MIN)
+        code |= LEFT;
+    else if (x > X_MAX)
+        code |= RIGHT;
+
+    if (y < Y_MIN)
+        code |= BOTTOM;
+    else if (y > Y_MAX)
+        code |= TOP;
+
+    return code;
+}
+
+/**
+ * @brief Recorta a linha (x0, y0) - (x1, y1) usando o algoritmo
+ * Cohen-Sutherland, sem desenhar.
+ * * @param px0 Coordenada x inicial (substituída pela recortada).
+ * @param py0 Coordenada y inicial (substituída pela recortada).
+ * @param px1 Coordenada x final (substituída pela recortada).
+ * @param py1 Coordenada y final (substituída pela recortada).
+ * @return true se algum trecho da linha está dentro da janela.
+ */
+bool clip_line(double* px0, double* py0, double* px1, double* py1) {
+    double x0 = *px0, y0 = *py0, x1 = *px1, y1 = *py1;
+
+    // Calcula os outcodes dos pontos inicial e final
+    int outcode0 = compute_outcode(x0, y0);
+    int outcode1 = compute_outcode(x1, y1);
+    bool accept = false;
+
+    while (1) {
+        if (!(outcode0 | outcode1)) {
+            // Aceite trivial: Ambos os pontos estão dentro da janela
+            accept = true;
+            break;
+        } else if (outcode0 & outcode1) {
+            // Rejeição trivial: Ambos os pontos estão fora na mesma região
+            break;
+        } else {
+            // Recorte necessário
+            double x, y;
+            
+            // Pega o ponto que está fora
+            int outcodeOut = outcode0 ? outcode0 : outcode1;
+
+            // Encontra a interseção
+            if (outcodeOut & TOP) {           // Ponto está acima
+                if (y1 != y0) {
+                    x = x0 + (x1 - x0) * (Y_MAX - y0) / (y1 - y0);
+                } else {
+                    // Degenerate: horizontal line. Keep x as the outside point's x.
+                    x = x0;
+                }
+                y = Y_MAX;
+            } else if (outcodeOut & BOTTOM) { // Ponto está abaixo
+                if (y1 != y0) {
+                    x = x0 + (x1 - x0) * (Y_MIN - y0) / (y1 - y0);
+                } else {
+                    x = x0;
+                }
+                y = Y_MIN;
+            } else if (outcodeOut & RIGHT) {  // Ponto está à direita
+                if (x1 != x0) {
+                    y = y0 + (y1 - y0) * (X_MAX - x0) / (x1 - x0);
+                } else {
+                    y = y0;
+                }
+                x = X_MAX;
+            } else if (outcodeOut & LEFT) {   // Ponto está à esquerda
+                if (x1 != x0) {
+                    y = y0 + (y1 - y0) * (X_MIN - x0) / (x1 - x0);
+                } else {
+                    y = y0;
+                }
+                x = X_MIN;
+            }
+
+            // Atualiza o ponto que estava fora para o ponto de interseção
+            if (outcodeOut == outcode0) {
+                x0 = x;
+                y0 = y;
+                outcode0 = compute_outcode(x0, y0);
+            } else {
+                x1 = x;
+                y1 = y;
+                outcode1 = compute_outcode(x1, y1);
+            }
+        }
+    }
+
+    *px0 = x0;
+    *py0 = y0;
+    *px1 = x1;
+    *py1 = y1;
+    return accept;
+}
+
+/**
+ * @brief Recorta e desenha uma linha (x0, y0) - (x1, y1) usando o 
+ * algoritmo Cohen-Sutherland.
+ * * @param renderer O renderizador SDL.
+ * @param x0 Coordenada x inicial.
+ * @param y0 Coordenada y inicial.
+ * @param x1 Coordenada x final.
+ * @param y1 Coordenada y final.
+ */
+void clip_and_draw_line(SDL_Renderer* renderer, double x0, double y0, double x1, double y1) {
+    if (clip_line(&x0, &y0, &x1, &y1)) {
+        // Desenha a linha recortada (convertendo para int)
+        draw_line_midpoint(renderer, (int)round(x0), (int)round(y0), (int)round(x1), (int)round(y1));
+    }
+}
+
+/**
+ * @brief Desenha o contorno de um polígono.
+ * * @param renderer O renderizador SDL.
+ * @param vertices Um array de SDL_Point (vértices).
+ * @param num_vertices O número de vértices no array.
+ */
+void draw_polygon(SDL_Renderer* renderer, SDL_Point vertices[], int num_vertices) {
+    if (num_vertices < 3) {
+        return; // Não é um polígono
+    }
+
+    for (int i = 0; i < num_vertices; ++i) {
+        // Pega o ponto atual e o próximo ponto (com 'wrap-around')
+        SDL_Point p1 = vertices[i];
+        SDL_Point p2 = vertices[(i + 1) % num_vertices]; // O % garante a volta ao início
+
+        draw_line_midpoint(renderer, p1.x, p1.y, p2.x, p2.y);
+    }
+}
+
+// Função de comparação para qsort (necessária para ordenar as interseções)
+int compare_doubles(const void* a, const void* b) {
+    double da = *(const double*)a;
+    double db = *(const double*)b;
+    return (da > db) - (da < db);
+}
+
+// Função de comparação para qsort de ids inteiros
+int compare_ints(const void* a, const void* b) {
+    int ia = *(const int*)a;
+    int ib = *(const int*)b;
+    return (ia > ib) - (ia < ib);
+}
+
+// Regra que decide o que é "dentro" quando as arestas se cruzam
+typedef enum {
+    FILL_EVEN_ODD,  // Par-ímpar (a mesma de fill_polygon_scanline)
+    FILL_NONZERO    // Enrolamento diferente de zero
+} FillRule;
+
+// Interseção de uma aresta com a scanline; dir = +1 se a aresta desce, -1 se sobe
+typedef struct {
+    double x;
+    int dir;
+} ScanIntersection;
+
+static int compare_scan_intersections(const void* a, const void* b) {
+    double xa = ((const ScanIntersection*)a)->x;
+    double xb = ((const ScanIntersection*)b)->x;
+    return (xa > xb) - (xa < xb);
+}
+
+/**
+ * @brief Limites Y de todos os contornos juntos.
+ * @return O total de vértices dos contornos válidos (0 se nenhum).
+ */
+static int contours_y_range(SDL_Point* const contours[], const int counts[], int num_contours, int* y_min, int* y_max) {
+    int total = 0;
+    *y_min = SDL_MAX_SINT32;
+    *y_max = SDL_MIN_SINT32;
+    for (int c = 0; c < num_contours; ++c) {
+        if (counts[c] < 3) continue;
+        total += counts[c];
+        for (int i = 0; i < counts[c]; ++i) {
+            if (contours[c][i].y < *y_min) *y_min = contours[c][i].y;
+            if (contours[c][i].y > *y_max) *y_max = contours[c][i].y;
+        }
+    }
+    return total;
+}
+
+/**
+ * @brief Uma scanline de fill_polygon_contours, com as arestas de todos os
+ * contornos. Separada para o preenchimento poder parar e continuar entre
+ * linhas (ver RasterJob).
+ * * @param intersections Espaço para uma interseção por vértice.
+ */
+static void contours_scanline(SDL_Renderer* renderer, SDL_Point* const contours[], const int counts[], int num_contours,
+                              FillRule rule, int y, ScanIntersection* intersections) {
+    int num_intersections = 0;
+    for (int c = 0; c < num_contours; ++c) {
+        if (counts[c] < 3) continue;
+        for (int i = 0; i < counts[c]; ++i) {
+            SDL_Point p1 = contours[c][i];
+            SDL_Point p2 = contours[c][(i + 1) % counts[c]];
+            if (((p1.y <= y && p2.y > y) || (p1.y > y && p2.y <= y))) {
+                double x_intersect = (double)(y - p1.y) * (p2.x - p1.x) / (double)(p2.y - p1.y) + p1.x;
+                intersections[num_intersections].x = x_intersect;
+                intersections[num_intersections].dir = p2.y > p1.y ? 1 : -1;
+                num_intersections++;
+            }
+        }
+    }
+
+    // 3. Ordena em X
+    qsort(intersections, num_intersections, sizeof(ScanIntersection), compare_scan_intersections);
+
+    // 4. Spans de dentro: pares consecutivos (par-ímpar) ou trechos de
+    // enrolamento diferente de zero
+    if (rule == FILL_EVEN_ODD) {
+        for (int i = 0; i + 1 < num_intersections; i += 2) {
+            raster_span(renderer, y, (int)round(intersections[i].x), (int)round(intersections[i + 1].x));
+        }
+    } else {
+        int winding = 0;
+        double x_start = 0.0;
+        for (int i = 0; i < num_intersections; ++i) {
+            int before = winding;
+            winding += intersections[i].dir;
+            if (before == 0 && winding != 0) {
+                x_start = intersections[i].x;
+            } else if (before != 0 && winding == 0) {
+                raster_span(renderer, y, (int)round(x_start), (int)round(intersections[i].x));
+            }
+        }
+    }
+}
+
+/**
+ * @brief Preenche uma forma de vários contornos (por exemplo, um anel externo
+ * e furos) numa única passada de scanline sobre todos eles. Cada interseção
+ * guarda o sentido da aresta, então a mesma passada serve às duas regras:
+ * par-ímpar (furos em qualquer sentido) ou enrolamento não nulo (furos no
+ * sentido contrário ao do contorno externo).
+ * * @param renderer O renderizador SDL.
+ * @param contours Um array de contornos (cada um, um array de SDL_Point).
+ * @param counts O número de vértices de cada contorno.
+ * @param num_contours O número de contornos.
+ * @param rule Regra de preenchimento.
+ */
+static void fill_polygon_contours_impl(SDL_Renderer* renderer, SDL_Point* const contours[], const int counts[], int num_contours, FillRule rule) {
+    // 1. Limites Y de todos os contornos juntos
+    int y_min, y_max;
+    int total = contours_y_range(contours, counts, num_contours, &y_min, &y_max);
+    if (total == 0) return;
+
+    // Interseções de uma scanline (memória temporária do quadro)
+    ScanIntersection* intersections = (ScanIntersection*)arena_alloc(&frame_arena, total * sizeof(ScanIntersection));
+    if (!intersections) {
+        printf("Falha ao alocar memoria para scanline.\n");
+        return;
+    }
+
+    // 2. Uma passada de y_min até y_max
+    for (int y = y_min; y <= y_max; ++y) {
+        contours_scanline(renderer, contours, counts, num_contours, rule, y, intersections);
+    }
+}
+
+// Ponto de entrada medido por --perf
+void fill_polygon_contours(SDL_Renderer* renderer, SDL_Point* const contours[], const int counts[], int num_contours, FillRule rule) {
+    PerfSample start;
+    bool counted = perf_begin(&start);
+    fill_polygon_contours_impl(renderer, contours, counts, num_contours, rule);
+    perf_end(PERF_STAGE_FILL_SCANLINE, &start, counted);
+}
+
+/**
+ * @brief Preenche um polígono usando o algoritmo Scanline.
+ * * @param renderer O renderizador SDL.
+ * @param vertices Um array de SDL_Point (vértices).
+ * @param num_vertices O número de vértices no array.
+ */
+void fill_polygon_scanline(SDL_Renderer* renderer, SDL_Point vertices[], int num_vertices) {
+    fill_polygon_contours(renderer, &vertices, &num_vertices, 1, FILL_EVEN_ODD);
+}
+
+/**
+ * @brief Verifica se um polígono é convexo (e monótono em y).
+ * Feito uma única vez por polígono, na definição da forma, para decidir se
+ * ele pode usar fill_convex_polygon em vez do scanline geral.
+ * * @param vertices Um array de SDL_Point (vértices).
+ * @param num_vertices O número de vértices no array.
+ * @return true se todas as curvas viram para o mesmo lado e a borda sobe e
+ * desce uma única vez (no máximo duas interseções por scanline).
+ */
+bool is_polygon_convex(SDL_Point vertices[], int num_vertices) {
+    if (num_vertices < 3) return false;
+
+    int sign = 0;           // Sinal do produto vetorial já visto
+    int dir_changes = 0;    // Quantas vezes a direção em y inverte
+    int first_dir = 0, last_dir = 0;
+
+    for (int i = 0; i < num_vertices; ++i) {
+        SDL_Point p0 = vertices[i];
+        SDL_Point p1 = vertices[(i + 1) % num_vertices];
+        SDL_Point p2 = vertices[(i + 2) % num_vertices];
+
+        long long cross = (long long)(p1.x - p0.x) * (p2.y - p1.y)
+                        - (long long)(p1.y - p0.y) * (p2.x - p1.x);
+        int s = (cross > 0) - (cross < 0);
+        if (s != 0) {
+            if (sign != 0 && s != sign) return false; // Vira para os dois lados
+            sign = s;
+        }
+
+        int dir = (p1.y > p0.y) - (p1.y < p0.y); // Arestas horizontais não contam
+        if (dir != 0) {
+            if (first_dir == 0) first_dir = dir;
+            else if (dir != last_dir) dir_changes++;
+            last_dir = dir;
+        }
+    }
+    if (last_dir != first_dir) dir_changes++; // Fecha o ciclo
+
+    // Um polígono estrelado (ex.: pentagrama) tem todas as curvas para o mesmo
+    // lado, mas sobe e desce mais de uma vez.
+    return dir_changes <= 2;
+}
+
+// Divisão com arredondamento para baixo (o '/' do C trunca em direção ao zero)
+static long long floor_div(long long a, long long b) {
+    long long q = a / b;
+    if ((a % b != 0) && ((a < 0) != (b < 0))) q--;
+    return q;
+}
+
+/*
+ * Passo incremental (DDA) exato de uma aresta. A cada linha fornece o mesmo
+ * valor que round() daria para a interpolação em double usada em
+ * fill_polygon_scanline, mas sem divisão nem ponto flutuante por linha.
+ * O x é mantido como n / (2*dy); q e rem guardam floor((n + dy) / (2*dy)).
+ */
+typedef struct {
+    long long n;      // Numerador do x atual (x = n / den)
+    long long q;      // floor(x + 0.5)
+    long long rem;    // Resto de (n + dy) por den, em [0, den)
+    long long q_step; // Parte inteira de 2*dx / den
+    long long r_step; // Resto de 2*dx / den
+    long long n_step; // 2*dx
+    long long den;    // 2*dy
+    int y_end;        // Primeira linha que a aresta não cobre mais
+} EdgeDDA;
+
+/**
+ * @brief Prepara o DDA da aresta (top -> bottom) começando na linha y.
+ * A aresta cobre as linhas [top.y, bottom.y), como no scanline geral.
+ */
+static void edge_dda_init(EdgeDDA* e, SDL_Point top, SDL_Point bottom, int y) {
+    long long dx = bottom.x - top.x;
+    long long dy = bottom.y - top.y; // > 0
+
+    e->den = 2 * dy;
+    e->n_step = 2 * dx;
+    e->q_step = floor_div(e->n_step, e->den);
+    e->r_step = e->n_step - e->q_step * e->den;
+    e->n = 2 * (long long)top.x * dy + (long long)(y - top.y) * e->n_step;
+    e->q = floor_div(e->n + dy, e->den);
+    e->rem = e->n + dy - e->q * e->den;
+    e->y_end = bottom.y;
+}
+
+// x arredondado como round(): meio exato em x negativo vai para longe do zero
+static inline int edge_dda_x(const EdgeDDA* e) {
+    return (int)(e->q - (e->n < 0 && e->rem == 0));
+}
+
+static inline void edge_dda_step(EdgeDDA* e) {
+    e->n += e->n_step;
+    e->q += e->q_step;
+    e->rem += e->r_step;
+    if (e->rem >= e->den) {
+        e->rem -= e->den;
+        e->q++;
+    }
+}
+
+// Cursor que desce por uma das cadeias (esquerda ou direita) do polígono
+typedef struct {
+    int idx;   // Vértice onde a aresta atual começa
+    int dir;   // +1 ou -1: sentido em que a cadeia percorre o array
+    EdgeDDA edge;
+} ChainCursor;
+
+/**
+ * @brief Avança o cursor até a aresta que cobre a linha y (pula horizontais).
+ */
+static void chain_advance(ChainCursor* c, SDL_Point vertices[], int num_vertices, int y) {
+    for (int guard = 0; c->edge.y_end <= y && guard < num_vertices; ++guard) {
+        SDL_Point a = vertices[c->idx];
+        int next = (c->idx + c->dir + num_vertices) % num_vertices;
+        SDL_Point b = vertices[next];
+        c->idx = next;
+        if (b.y > y && a.y <= y) {
+            edge_dda_init(&c->edge, a, b, y);
+        }
+    }
+}
+
+/**
+ * @brief Preenche um polígono convexo percorrendo as cadeias esquerda e direita.
+ * Cada linha tem exatamente duas interseções, então não há busca de arestas
+ * por linha, nem qsort, nem alocação. Gera os mesmos pixels que
+ * fill_polygon_scanline; só deve ser chamada se is_polygon_convex() for true.
+ * * @param renderer O renderizador SDL.
+ * @param vertices Um array de SDL_Point (vértices).
+ * @param num_vertices O número de vértices no array.
+ */
+static void fill_convex_polygon_impl(SDL_Renderer* renderer, SDL_Point vertices[], int num_vertices) {
+    if (num_vertices < 3) return;
+
+    // 1. Vértices do topo e da base
+    int top = 0, bottom = 0;
+    for (int i = 1; i < num_vertices; ++i) {
+        if (vertices[i].y < vertices[top].y) top = i;
+        if (vertices[i].y > vertices[bottom].y) bottom = i;
+    }
+    int y_min = vertices[top].y;
+    int y_max = vertices[bottom].y;
+    if (y_min == y_max) return; // Polígono achatado: nenhuma aresta cruza
+
+    // 2. Uma cadeia desce pelo array em cada sentido a partir do topo
+    ChainCursor a = { top, +1, { 0 } };
+    ChainCursor b = { top, -1, { 0 } };
+    a.edge.y_end = y_min;
+    b.edge.y_end = y_min;
+
+    // 3. Linha a linha, só avança os dois DDAs
+    for (int y = y_min; y < y_max; ++y) {
+        chain_advance(&a, vertices, num_vertices, y);
+        chain_advance(&b, vertices, num_vertices, y);
+
+        int x_start = edge_dda_x(&a.edge);
+        int x_end = edge_dda_x(&b.edge);
+        if (x_start > x_end) {
+            int tmp = x_start; x_start = x_end; x_end = tmp;
+        }
+        raster_span(renderer, y, x_start, x_end);
+
+        edge_dda_step(&a.edge);
+        edge_dda_step(&b.edge);
+    }
+}
+
+// Ponto de entrada medido por --perf
+void fill_convex_polygon(SDL_Renderer* renderer, SDL_Point vertices[], int num_vertices) {
+    PerfSample start;
+    bool counted = perf_begin(&start);
+    fill_convex_polygon_impl(renderer, vertices, num_vertices);
+    perf_end(PERF_STAGE_FILL_CONVEX, &start, counted);
+}
+
+// --- Preenchimento com amostragem no centro do pixel (regra top-left) ---
+
+/**
+ * @brief Preenche um polígono amostrando o centro de cada pixel, com a regra
+ * top-left estrita. O pixel (x, y) é pintado se (x + 0.5, y + 0.5) está dentro;
+ * um centro exatamente sobre uma aresta conta só para o polígono à direita
+ * dela (arestas esquerdas incluem, direitas excluem). Como os vértices são
+ * inteiros, nenhum centro cai sobre uma aresta horizontal. Os limites de cada
+ * span saem de contas inteiras exatas, então dois polígonos que dividem uma
+ * aresta calculam o mesmo x para ela: numa malha sem buracos cada pixel é
+ * escrito exatamente uma vez.
+ * * @param renderer O renderizador SDL.
+ * @param vertices Um array de SDL_Point (vértices).
+ * @param num_vertices O número de vértices no array.
+ */
+static void fill_polygon_topleft_impl(SDL_Renderer* renderer, SDL_Point vertices[], int num_vertices) {
+    if (num_vertices < 3) return;
+
+    int y_min = vertices[0].y;
+    int y_max = vertices[0].y;
+    for (int i = 1; i < num_vertices; ++i) {
+        if (vertices[i].y < y_min) y_min = vertices[i].y;
+        if (vertices[i].y > y_max) y_max = vertices[i].y;
+    }
+
+    // Primeiro pixel à direita de cada cruzamento (memória temporária do quadro)
+    int* crossings = (int*)arena_alloc(&frame_arena, num_vertices * sizeof(int));
+    if (!crossings) {
+        printf("Falha ao alocar memoria para scanline.\n");
+        return;
+    }
+
+    // Linhas cujo centro y + 0.5 fica em [y_min, y_max)
+    for (int y = y_min; y < y_max; ++y) {
+        int num_crossings = 0;
+        for (int i = 0; i < num_vertices; ++i) {
+            SDL_Point top = vertices[i];
+            SDL_Point bottom = vertices[(i + 1) % num_vertices];
+            if (top.y == bottom.y) continue;
+            if (top.y > bottom.y) {
+                SDL_Point t = top; top = bottom; bottom = t;
+            }
+            if (y < top.y || y >= bottom.y) continue;
+
+            // x da aresta em y + 0.5 é top.x + num / den; o primeiro centro
+            // de pixel >= x é top.x + ceil((num - den / 2) / den)
+            long long num = (long long)(2 * (y - top.y) + 1) * (bottom.x - top.x);
+            long long den = 2LL * (bottom.y - top.y);
+            crossings[num_crossings++] = top.x + (int)-floor_div(-(num * 2 - den), den * 2);
+        }
+
+        qsort(crossings, num_crossings, sizeof(int), compare_ints);
+
+        // Pixels [a, b) entre pares de cruzamentos
+        for (int i = 0; i + 1 < num_crossings; i += 2) {
+            if (crossings[i + 1] > crossings[i]) {
+                raster_span(renderer, y, crossings[i], crossings[i + 1] - 1);
+            }
+        }
+    }
+}
+
+// Ponto de entrada medido por --perf
+void fill_polygon_topleft(SDL_Renderer* renderer, SDL_Point vertices[], int num_vertices) {
+    PerfSample start;
+    bool counted = perf_begin(&start);
+    fill_polygon_topleft_impl(renderer, vertices, num_vertices);
+    perf_end(PERF_STAGE_FILL_TOPLEFT, &start, counted);
+}
+
+// --- Preenchimento por edge flag ---
+
+// Polígonos mais largos que isso usam o scanline geral
+const int EDGEFLAG_MAX_WIDTH = 16384;
+// Tamanho aproximado do buffer de flags de uma faixa de linhas
+const int EDGEFLAG_BAND_BYTES = 256 * 1024;
+
+static inline int ctz32(Uint32 v) {
+#if defined(__GNUC__)
+    return __builtin_ctz(v);
+#else
+    int n = 0;
+    while (!(v & 1)) { v >>= 1; n++; }
+    return n;
+#endif
+}
+
+/*
+ * Linha de varredura por máscara de bits: bit x ligado = pixel x dentro.
+ * Emite um span para cada sequência de bits ligados.
+ */
+static void emit_mask_spans(SDL_Renderer* renderer, const Uint32* mask, int words, int x0, int y) {
+    int run_start = -1;
+    for (int w = 0; w < words; ++w) {
+        Uint32 m = mask[w];
+        int base = w * 32;
+        int pos = 0;
+        while (pos < 32) {
+            Uint32 rest = (run_start < 0 ? m : ~m) >> pos;
+            if (rest == 0) break; // A palavra termina no mesmo estado
+            pos += ctz32(rest);
+            if (run_start < 0) {
+                run_start = base + pos;
+            } else {
+                raster_span(renderer, y, x0 + run_start, x0 + base + pos - 1);
+                run_start = -1;
+            }
+        }
+    }
+    if (run_start >= 0) {
+        raster_span(renderer, y, x0 + run_start, x0 + words * 32 - 1);
+    }
+}
+
+/*
+ * Varredura de uma linha para a regra par-ímpar. Cada byte de 'flags' tem o
+ * bit 0 = paridade das arestas que cruzam aquele pixel e o bit 1 = alguma
+ * aresta cruza ali. O pixel é pintado se a paridade acumulada *antes* dele é
+ * ímpar ou se alguma aresta cai nele, o que reproduz os spans fechados
+ * [round(a), round(b)] de fill_polygon_scanline.
+ */
+#if !HAVE_X86_SIMD
+static void sweep_even_odd_scalar(const Uint8* flags, int stride, Uint32* mask) {
+    Uint8 parity = 0;
+    for (int w = 0; w < stride / 32; ++w) {
+        Uint32 bits = 0;
+        for (int i = 0; i < 32; ++i) {
+            Uint8 f = flags[w * 32 + i];
+            bits |= (Uint32)(parity | (f >> 1)) << i;
+            parity ^= f & 1;
+        }
+        mask[w] = bits;
+    }
+}
+#else
+// Mesma varredura, 16 pixels por vez: XOR-prefixo em log2(16) passos
+static void sweep_even_odd_sse2(const Uint8* flags, int stride, Uint32* mask) {
+    const __m128i one = _mm_set1_epi8(1);
+    const __m128i zero = _mm_setzero_si128();
+    __m128i carry = zero; // Paridade acumulada até o bloco anterior, em todos os bytes
+
+    for (int x = 0; x < stride; x += 16) {
+        __m128i f = _mm_loadu_si128((const __m128i*)(flags + x));
+        __m128i parity = _mm_and_si128(f, one);
+
+        __m128i prefix = parity;
+        prefix = _mm_xor_si128(prefix, _mm_slli_si128(prefix, 1));
+        prefix = _mm_xor_si128(prefix, _mm_slli_si128(prefix, 2));
+        prefix = _mm_xor_si128(prefix, _mm_slli_si128(prefix, 4));
+        prefix = _mm_xor_si128(prefix, _mm_slli_si128(prefix, 8));
+        prefix = _mm_xor_si128(prefix, carry);
+
+        __m128i before = _mm_xor_si128(prefix, parity);           // Paridade antes do pixel
+        __m128i hit = _mm_and_si128(_mm_srli_epi16(f, 1), one);   // Bit 1 de cada byte
+        __m128i inside = _mm_or_si128(before, hit);
+        Uint32 bits = ~(Uint32)_mm_movemask_epi8(_mm_cmpeq_epi8(inside, zero)) & 0xFFFF;
+
+        if (x & 16) mask[x / 32] |= bits << 16;
+        else mask[x / 32] = bits;
+
+        carry = _mm_set1_epi8((char)(_mm_extract_epi16(prefix, 7) >> 8));
+    }
+}
+#endif
+
+// Varredura para a regra do enrolamento: soma as direções das arestas
+static void sweep_nonzero_scalar(const Uint8* flags, const Sint16* wind, int stride, Uint32* mask) {
+    int winding = 0;
+    for (int w = 0; w < stride / 32; ++w) {
+        Uint32 bits = 0;
+        for (int i = 0; i < 32; ++i) {
+            int x = w * 32 + i;
+            bits |= (Uint32)((winding != 0) | (flags[x] >> 1)) << i;
+            winding += wind[x];
+        }
+        mask[w] = bits;
+    }
+}
+
+/**
+ * @brief Preenche um polígono pelo método edge flag.
+ * Primeiro cada aresta marca, linha a linha, o pixel onde cruza a scanline
+ * (mesmo x arredondado do scanline geral); depois uma varredura por XOR
+ * prefixo (ou soma, na regra do enrolamento) acha o interior. Não há
+ * ordenação, então polígonos com muitas arestas por linha (estrelas,
+ * contornos de texto) ficam bem mais baratos. O trabalho é feito em faixas
+ * de linhas para o buffer de flags caber no cache.
+ * * @param renderer O renderizador SDL.
+ * @param vertices Um array de SDL_Point (vértices).
+ * @param num_vertices O número de vértices no array.
+ * @param rule FILL_EVEN_ODD (mesmos pixels de fill_polygon_scanline) ou FILL_NONZERO.
+ */
+static void fill_polygon_edgeflag_impl(SDL_Renderer* renderer, SDL_Point vertices[], int num_vertices, FillRule rule) {
+    if (num_vertices < 3) return;
+
+    // 1. Caixa envolvente
+    int x_min = vertices[0].x, x_max = x_min;
+    int y_min = vertices[0].y, y_max = y_min;
+    for (int i = 1; i < num_vertices; ++i) {
+        if (vertices[i].x < x_min) x_min = vertices[i].x;
+        if (vertices[i].x > x_max) x_max = vertices[i].x;
+        if (vertices[i].y < y_min) y_min = vertices[i].y;
+        if (vertices[i].y > y_max) y_max = vertices[i].y;
+    }
+    if (y_min == y_max) return;
+    if ((long long)x_max - x_min + 1 > EDGEFLAG_MAX_WIDTH) {
+        // Largo demais para o buffer de flags: scanline com a mesma regra
+        fill_polygon_contours(renderer, &vertices, &num_vertices, 1, rule);
+        return;
+    }
+
+    int width = x_max - x_min + 1;
+    int stride = (width + 31) & ~31; // Múltiplo de 32: uma palavra de máscara por 32 pixels
+    int band_rows = EDGEFLAG_BAND_BYTES / stride;
+    if (band_rows < 1) band_rows = 1;
+    if (band_rows > y_max - y_min) band_rows = y_max - y_min;
+
+    // 2. Memória temporária do quadro: flags, enrolamento, máscara e arestas
+    Uint8* flags = (Uint8*)arena_alloc(&frame_arena, (size_t)band_rows * stride);
+    Sint16* wind = rule == FILL_NONZERO ? (Sint16*)arena_alloc(&frame_arena, (size_t)band_rows * stride * sizeof(Sint16)) : NULL;
+    Uint32* mask = (Uint32*)arena_alloc(&frame_arena, stride / 8);
+    EdgeDDA* edges = (EdgeDDA*)arena_alloc(&frame_arena, num_vertices * sizeof(EdgeDDA));
+    int* edge_top = (int*)arena_alloc(&frame_arena, num_vertices * sizeof(int));
+    int* edge_dir = (int*)arena_alloc(&frame_arena, num_vertices * sizeof(int));
+    if (!flags || !mask || !edges || !edge_top || !edge_dir || (rule == FILL_NONZERO && !wind)) {
+        printf("Falha ao alocar memoria para edge flag.\n");
+        return;
+    }
+
+    // 3. Um DDA por aresta não horizontal, do topo para baixo
+    int num_edges = 0;
+    for (int i = 0; i < num_vertices; ++i) {
+        SDL_Point p1 = vertices[i];
+        SDL_Point p2 = vertices[(i + 1) % num_vertices];
+        if (p1.y == p2.y) continue;
+        int dir = p2.y > p1.y ? 1 : -1;
+        SDL_Point top = dir > 0 ? p1 : p2;
+        SDL_Point bottom = dir > 0 ? p2 : p1;
+        edge_dda_init(&edges[num_edges], top, bottom, top.y);
+        edge_top[num_edges] = top.y;
+        edge_dir[num_edges] = dir;
+        num_edges++;
+    }
+
+    // 4. Faixa a faixa: marca as arestas e varre as linhas
+    for (int band_y = y_min; band_y < y_max; band_y += band_rows) {
+        int band_end = band_y + band_rows < y_max ? band_y + band_rows : y_max;
+        int rows = band_end - band_y;
+        SDL_memset(flags, 0, (size_t)rows * stride);
+        if (wind) SDL_memset(wind, 0, (size_t)rows * stride * sizeof(Sint16));
+
+        for (int e = 0; e < num_edges; ++e) {
+            EdgeDDA* edge = &edges[e];
+            int y = edge_top[e] > band_y ? edge_top[e] : band_y;
+            int y_stop = edge->y_end < band_end ? edge->y_end : band_end;
+            for (; y < y_stop; ++y) {
+                int idx = (y - band_y) * stride + (edge_dda_x(edge) - x_min);
+                flags[idx] = (Uint8)((flags[idx] ^ 1) | 2);
+                if (wind) wind[idx] += (Sint16)edge_dir[e];
+                edge_dda_step(edge);
+            }
+        }
+
+        for (int r = 0; r < rows; ++r) {
+            const Uint8* row = flags + (size_t)r * stride;
+            if (rule == FILL_NONZERO) {
+                sweep_nonzero_scalar(row, wind + (size_t)r * stride, stride, mask);
+            } else {
+#if HAVE_X86_SIMD
+                sweep_even_odd_sse2(row, stride, mask);
+#else
+                sweep_even_odd_scalar(row, stride, mask);
+#endif
+            }
+            emit_mask_spans(renderer, mask, stride / 32, x_min, band_y + r);
+        }
+    }
+}
+
+// Ponto de entrada medido por --perf
+void fill_polygon_edgeflag(SDL_Renderer* renderer, SDL_Point vertices[], int num_vertices, FillRule rule) {
+    PerfSample start;
+    bool counted = perf_begin(&start);
+    fill_polygon_edgeflag_impl(renderer, vertices, num_vertices, rule);
+    perf_end(PERF_STAGE_FILL_EDGEFLAG, &start, counted);
+}
+
+// Assinatura de FillFunc para a regra par-ímpar
+void fill_polygon_edgeflag_even_odd(SDL_Renderer* renderer, SDL_Point vertices[], int num_vertices) {
+    fill_polygon_edgeflag(renderer, vertices, num_vertices, FILL_EVEN_ODD);
+}
+
+// --- Preenchimento par-ímpar escolhido por classe de tamanho ---
+
+typedef void (*FillFunc)(SDL_Renderer*, SDL_Point[], int);
+
+// Classes pelo número de vértices; o autotuner escolhe a implementação de cada uma
+typedef enum {
+    FILL_CLASS_SMALL,  // Até 8 vértices
+    FILL_CLASS_MEDIUM, // Até 64
+    FILL_CLASS_LARGE,
+    FILL_CLASS_COUNT
+} FillSizeClass;
+
+static inline FillSizeClass fill_size_class(int num_vertices) {
+    if (num_vertices <= 8) return FILL_CLASS_SMALL;
+    if (num_vertices <= 64) return FILL_CLASS_MEDIUM;
+    return FILL_CLASS_LARGE;
+}
+
+// Todas as candidatas dão os mesmos pixels que fill_polygon_scanline
+FillFunc fill_polygon_by_class[FILL_CLASS_COUNT] = { fill_polygon_scanline, fill_polygon_scanline, fill_polygon_scanline };
+
+void fill_polygon_tuned(SDL_Renderer* renderer, SDL_Point vertices[], int num_vertices) {
+    fill_polygon_by_class[fill_size_class(num_vertices)](renderer, vertices, num_vertices);
+}
+
+// --- Preenchimento anti-aliased por acumulação de cobertura ---
+
+// Tamanho aproximado do buffer de acumulação de uma faixa de linhas
+const int AA_BAND_BYTES = 256 * 1024;
+
+/*
+ * Deposita a contribuição de uma aresta (em coordenadas locais ao buffer) nas
+ * linhas [band_y0, band_y1). Cada célula recebe a diferença de área coberta
+ * entre ela e a vizinha da esquerda; a soma prefixo da linha vira a cobertura
+ * (área com sinal) de cada pixel. O buffer pode ser só um recorte da forma:
+ * o que cai à esquerda da coluna 0 soma nela (a soma prefixo continua
+ * certa) e o que passa de 'stride' só afetaria pixels de fora.
+ */
+static inline void aa_deposit(float* row, int stride, int x, float v) {
+    if (x < 0) x = 0;
+    if (x < stride) row[x] += v;
+}
+
+static void aa_accumulate_edge(float* acc, int stride, int band_y0, int band_y1,
+                               float x0, float y0, float x1, float y1) {
+    if (y0 == y1) return;
+    float dir = 1.0f;
+    if (y0 > y1) {
+        float t;
+        t = x0; x0 = x1; x1 = t;
+        t = y0; y0 = y1; y1 = t;
+        dir = -1.0f;
+    }
+    float dxdy = (x1 - x0) / (y1 - y0);
+
+    int y_start = (int)floorf(y0);
+    int y_stop = (int)ceilf(y1);
+    if (y_start < band_y0) y_start = band_y0;
+    if (y_stop > band_y1) y_stop = band_y1;
+    float x = x0 + (((float)y_start > y0 ? (float)y_start : y0) - y0) * dxdy;
+
+    for (int y = y_start; y < y_stop; ++y) {
+        float* row = acc + (size_t)(y - band_y0) * stride;
+        float dy = ((float)(y + 1) < y1 ? (float)(y + 1) : y1) - ((float)y > y0 ? (float)y : y0);
+        float x_next = x + dxdy * dy;
+        float d = dy * dir;
+        float xa = x < x_next ? x : x_next;
+        float xb = x < x_next ? x_next : x;
+        float xa_floor = floorf(xa);
+        int xa_i = (int)xa_floor;
+        int xb_i = (int)ceilf(xb);
+
+        if (xb_i <= 0) {
+            // Toda à esquerda do recorte: a linha inteira recebe d
+            row[0] += d;
+        } else if (xa_i >= stride) {
+            // Toda à direita: não cobre nada visível
+        } else if (xb_i <= xa_i + 1) {
+            // A aresta fica dentro de um pixel nesta linha
+            float xm = 0.5f * (x + x_next) - xa_floor;
+            aa_deposit(row, stride, xa_i, d - d * xm);
+            aa_deposit(row, stride, xa_i + 1, d * xm);
+        } else {
+            // Atravessa vários pixels: área de um trapézio por pixel
+            float s = 1.0f / (xb - xa);
+            float xa_f = xa - xa_floor;
+            float a0 = 0.5f * s * (1.0f - xa_f) * (1.0f - xa_f);
+            float xb_f = xb - (float)xb_i + 1.0f;
+            float am = 0.5f * s * xb_f * xb_f;
+            aa_deposit(row, stride, xa_i, d * a0);
+            if (xb_i == xa_i + 2) {
+                aa_deposit(row, stride, xa_i + 1, d * (1.0f - a0 - am));
+            } else {
+                float a1 = s * (1.5f - xa_f);
+                aa_deposit(row, stride, xa_i + 1, d * (a1 - a0));
+                // Miolo: as colunas antes do recorte somam de uma vez na 0
+                int xi = xa_i + 2, xi_end = SDL_min(xb_i - 1, stride);
+                if (xi < 0) {
+                    row[0] += d * s * (float)(SDL_min(xi_end, 0) - xi);
+                    xi = 0;
+                }
+                for (; xi < xi_end; ++xi) {
+                    row[xi] += d * s;
+                }
+                float a2 = a1 + (float)(xb_i - xa_i - 3) * s;
+                aa_deposit(row, stride, xb_i - 1, d * (1.0f - a2 - am));
+            }
+            aa_deposit(row, stride, xb_i, d * am);
+        }
+        x = x_next;
+    }
+}
+
+// Soma prefixo de uma linha e conversão para alpha 0..255 (|cobertura| saturada)
+#if !HAVE_X86_SIMD
+static void aa_row_to_alpha_scalar(const float* acc, int width, Uint8* alpha) {
+    float sum = 0.0f;
+    for (int x = 0; x < width; ++x) {
+        sum += acc[x];
+        float a = fabsf(sum);
+        if (a > 1.0f) a = 1.0f;
+        alpha[x] = (Uint8)(a * 255.0f + 0.5f);
+    }
+}
+#else
+// A mesma conversão, 4 pixels por vez (width múltiplo de 4)
+static void aa_row_to_alpha_sse2(const float* acc, int width, Uint8* alpha) {
+    const __m128 sign = _mm_set1_ps(-0.0f);
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128 scale = _mm_set1_ps(255.0f);
+    const __m128 half = _mm_set1_ps(0.5f);
+    __m128 carry = _mm_setzero_ps();
+
+    for (int x = 0; x < width; x += 4) {
+        __m128 v = _mm_loadu_ps(acc + x);
+        v = _mm_add_ps(v, _mm_castsi128_ps(_mm_slli_si128(_mm_castps_si128(v), 4)));
+        v = _mm_add_ps(v, _mm_castsi128_ps(_mm_slli_si128(_mm_castps_si128(v), 8)));
+        v = _mm_add_ps(v, carry);
+        carry = _mm_shuffle_ps(v, v, _MM_SHUFFLE(3, 3, 3, 3));
+
+        __m128 a = _mm_min_ps(_mm_andnot_ps(sign, v), one);
+        __m128i i32 = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(a, scale), half));
+        __m128i i16 = _mm_packs_epi32(i32, i32);
+        __m128i i8 = _mm_packus_epi16(i16, i16);
+        *(Uint32*)(alpha + x) = (Uint32)_mm_cvtsi128_si32(i8);
+    }
+}
+#endif
+
+/*
+ * Desenha os pixels de cobertura parcial agrupados por alpha: uma cor e uma
+ * chamada SDL_RenderDrawPoints por nível, em vez de uma por pixel.
+ */
+static void aa_emit_partial(SDL_Renderer* renderer, const Uint8* alpha, int stride, int rows,
+                            int width, int ox, int oy, SDL_Color color) {
+    int count[256] = { 0 };
+    for (int r = 0; r < rows; ++r) {
+        for (int x = 0; x < width; ++x) count[alpha[(size_t)r * stride + x]]++;
+    }
+    int total = 0, offset[256];
+    for (int a = 1; a < 255; ++a) {
+        offset[a] = total;
+        total += count[a];
+    }
+    if (total == 0) return;
+
+    SDL_Point* points = (SDL_Point*)arena_alloc(&frame_arena, total * sizeof(SDL_Point));
+    if (!points) return;
+    int fill[256];
+    SDL_memcpy(fill, offset, sizeof(fill));
+    for (int r = 0; r < rows; ++r) {
+        for (int x = 0; x < width; ++x) {
+            Uint8 a = alpha[(size_t)r * stride + x];
+            if (a == 0 || a == 255) continue;
+            points[fill[a]].x = ox + x;
+            points[fill[a]].y = oy + r;
+            fill[a]++;
+        }
+    }
+
+    if (raster_overdraw) {
+        for (int i = 0; i < total; ++i) overdraw_point(raster_overdraw, points[i].x, points[i].y);
+        raster_pixels_written += (Uint64)total;
+        return;
+    }
+    for (int a = 1; a < 255; ++a) {
+        if (count[a] == 0) continue;
+        SDL_SetRenderDrawColor(renderer, color.r, color.g, color.b, (Uint8)(a * color.a / 255));
+        SDL_RenderDrawPoints(renderer, points + offset[a], count[a]);
+    }
+    raster_pixels_written += (Uint64)total;
+}
+
+/*
+ * Emite linhas de alpha já calculadas: trechos com alpha 255 viram spans
+ * opacos na cor cheia e o resto vai para aa_emit_partial, misturado.
+ */
+static void aa_emit_rows(SDL_Renderer* renderer, const Uint8* alpha, int stride, int rows,
+                         int width, int ox, int oy, SDL_Color color) {
+    SDL_SetRenderDrawBlendMode(renderer, SDL_BLENDMODE_NONE);
+    SDL_SetRenderDrawColor(renderer, color.r, color.g, color.b, color.a);
+    for (int r = 0; r < rows; ++r) {
+        const Uint8* alpha_row = alpha + (size_t)r * stride;
+        int run_start = -1;
+        for (int x = 0; x <= width; ++x) {
+            bool full = x < width && alpha_row[x] == 255;
+            if (full && run_start < 0) {
+                run_start = x;
+            } else if (!full && run_start >= 0) {
+                raster_span(renderer, oy + r, ox + run_start, ox + x - 1);
+                run_start = -1;
+            }
+        }
+    }
+    SDL_SetRenderDrawBlendMode(renderer, SDL_BLENDMODE_BLEND);
+    aa_emit_partial(renderer, alpha, stride, rows, width, ox, oy, color);
+}
+
+/**
+ * @brief Preenche um polígono com anti-aliasing (cobertura exata por pixel).
+ * As arestas depositam deltas de área num buffer float só das linhas da caixa
+ * envolvente; uma soma prefixo (SSE2) por linha dá o alpha. Pixels cobertos
+ * por inteiro saem como spans normais; os de borda são misturados com alpha.
+ * A caixa é recortada à área de saída e, se ainda for larga demais para
+ * o buffer, processada em faixas de colunas. A cobertura é |área com
+ * sinal| saturada, o que equivale à regra do enrolamento não nulo. Pixels parciais não entram em gravações
+ * (raster_recording), que não guardam alpha.
+ * * @param renderer O renderizador SDL.
+ * @param vertices Vértices com precisão subpixel.
+ * @param num_vertices O número de vértices no array.
+ * @param color Cor do polígono.
+ */
+static void fill_polygon_aa_impl(SDL_Renderer* renderer, SDL_FPoint vertices[], int num_vertices, SDL_Color color) {
+    if (num_vertices < 3) return;
+
+    // 1. Caixa envolvente, com um pixel de folga de cada lado, recortada à saída
+    float fx_min = vertices[0].x, fx_max = fx_min, fy_min = vertices[0].y, fy_max = fy_min;
+    for (int i = 1; i < num_vertices; ++i) {
+        if (vertices[i].x < fx_min) fx_min = vertices[i].x;
+        if (vertices[i].x > fx_max) fx_max = vertices[i].x;
+        if (vertices[i].y < fy_min) fy_min = vertices[i].y;
+        if (vertices[i].y > fy_max) fy_max = vertices[i].y;
+    }
+    int out_x0, out_y0, out_x1, out_y1;
+    raster_output_bounds(renderer, &out_x0, &out_y0, &out_x1, &out_y1);
+    int x_begin = SDL_max((int)floorf(fx_min) - 1, out_x0);
+    int x_end = SDL_min((int)ceilf(fx_max) + 1, out_x1);
+    int oy = SDL_max((int)floorf(fy_min), out_y0);
+    int height = SDL_min((int)ceilf(fy_max), out_y1) - oy;
+    if (height <= 0 || x_end <= x_begin) return;
+
+    int tile_width = SDL_min(x_end - x_begin, EDGEFLAG_MAX_WIDTH);
+    int stride = (tile_width + 3) & ~3;
+    int band_rows = AA_BAND_BYTES / (stride * (int)sizeof(float));
+    if (band_rows < 1) band_rows = 1;
+    if (band_rows > height) band_rows = height;
+
+    float* acc = (float*)arena_alloc(&frame_arena, (size_t)band_rows * stride * sizeof(float));
+    Uint8* alpha = (Uint8*)arena_alloc(&frame_arena, (size_t)band_rows * stride);
+    if (!acc || !alpha) {
+        printf("Falha ao alocar memoria para o anti-aliasing.\n");
+        return;
+    }
+
+    SDL_BlendMode prev_blend;
+    SDL_GetRenderDrawBlendMode(renderer, &prev_blend);
+
+    // 2. Faixa a faixa (de colunas e de linhas): acumula as arestas, soma prefixo e emite
+    for (int ox = x_begin; ox < x_end; ox += tile_width) {
+        int width = SDL_min(tile_width, x_end - ox);
+        for (int band_y = 0; band_y < height; band_y += band_rows) {
+            int rows = band_y + band_rows < height ? band_rows : height - band_y;
+            SDL_memset(acc, 0, (size_t)rows * stride * sizeof(float));
+
+            for (int i = 0; i < num_vertices; ++i) {
+                SDL_FPoint p1 = vertices[i];
+                SDL_FPoint p2 = vertices[(i + 1) % num_vertices];
+                aa_accumulate_edge(acc, stride, band_y, band_y + rows,
+                                   p1.x - ox, p1.y - oy, p2.x - ox, p2.y - oy);
+            }
+            for (int r = 0; r < rows; ++r) {
+#if HAVE_X86_SIMD
+                aa_row_to_alpha_sse2(acc + (size_t)r * stride, stride, alpha + (size_t)r * stride);
+#else
+                aa_row_to_alpha_scalar(acc + (size_t)r * stride, stride, alpha + (size_t)r * stride);
+#endif
+            }
+            aa_emit_rows(renderer, alpha, stride, rows, width, ox, oy + band_y, color);
+        }
+    }
+
+    SDL_SetRenderDrawBlendMode(renderer, prev_blend);
+}
+
+// Ponto de entrada medido por --perf
+void fill_polygon_aa(SDL_Renderer* renderer, SDL_FPoint vertices[], int num_vertices, SDL_Color color) {
+    PerfSample start;
+    bool counted = perf_begin(&start);
+    fill_polygon_aa_impl(renderer, vertices, num_vertices, color);
+    perf_end(PERF_STAGE_FILL_AA, &start, counted);
+}
+
+// --- Renderizador de cena por scanline (tabela global de arestas) ---
+
+// Polígono com cor própria; a posição no array é a ordem de desenho
+typedef struct {
+    SDL_Point* vertices;
+    int num_vertices;
+    SDL_Color color;
+} ColoredPolygon;
+
+// Aresta na tabela global: de qual polígono é e onde começa
+typedef struct {
+    EdgeDDA dda;
+    int y_top;
+    int poly;
+} SceneEdge;
+
+// Cruzamento de uma aresta ativa com a scanline atual
+typedef struct {
+    int x;
+    int poly;
+} SceneCrossing;
+
+// Início (+1) ou fim (-1) de um intervalo de um polígono na scanline
+typedef struct {
+    int x;
+    int poly;
+    int delta;
+} SceneEvent;
+
+static int compare_scene_edges(const void* a, const void* b) {
+    int ya = ((const SceneEdge*)a)->y_top;
+    int yb = ((const SceneEdge*)b)->y_top;
+    return (ya > yb) - (ya < yb);
+}
+
+static int compare_scene_crossings(const void* a, const void* b) {
+    const SceneCrossing* ca = (const SceneCrossing*)a;
+    const SceneCrossing* cb = (const SceneCrossing*)b;
+    if (ca->poly != cb->poly) return (ca->poly > cb->poly) - (ca->poly < cb->poly);
+    return (ca->x > cb->x) - (ca->x < cb->x);
+}
+
+static int compare_scene_events(const void* a, const void* b) {
+    int xa = ((const SceneEvent*)a)->x;
+    int xb = ((const SceneEvent*)b)->x;
+    return (xa > xb) - (xa < xb);
+}
+
+// Troca a cor do renderer só quando ela muda e desenha o span
+static void scene_emit_span(SDL_Renderer* renderer, int y, int x0, int x1, Uint32 color,
+                            Uint32* current_color, bool* have_color) {
+    if (!*have_color || *current_color != color) {
+        SDL_SetRenderDrawColor(renderer, (Uint8)(color >> 24), (Uint8)(color >> 16), (Uint8)(color >> 8), (Uint8)color);
+        *current_color = color;
+        *have_color = true;
+    }
+    raster_span(renderer, y, x0, x1);
+}
+
+/**
+ * @brief Preenche vários polígonos (sobrepostos) numa única passada.
+ * Todas as arestas vão para uma tabela global ordenada por y; cada scanline
+ * é percorrida uma vez, os intervalos de cada polígono são montados como em
+ * fill_polygon_scanline (par-ímpar) e, onde eles se sobrepõem, o pixel fica
+ * com o polígono desenhado por último. O resultado é o mesmo de chamar o
+ * preenchimento para cada polígono em ordem, mas cada pixel é escrito uma
+ * única vez. Trechos vizinhos de polígonos com a mesma cor saem num só span.
+ * * @param renderer O renderizador SDL.
+ * @param polys Polígonos em ordem de desenho (o último fica por cima).
+ * @param num_polys Quantos polígonos.
+ */
+static void fill_polygons_scene_impl(SDL_Renderer* renderer, ColoredPolygon polys[], int num_polys) {
+    if (num_polys <= 0) return;
+
+    // 1. Tabela global de arestas (GET), ordenada pelo y do topo
+    int max_edges = 0;
+    for (int p = 0; p < num_polys; ++p) max_edges += polys[p].num_vertices;
+    SceneEdge* edges = (SceneEdge*)arena_alloc(&frame_arena, max_edges * sizeof(SceneEdge));
+    int* active = (int*)arena_alloc(&frame_arena, max_edges * sizeof(int));
+    SceneCrossing* crossings = (SceneCrossing*)arena_alloc(&frame_arena, max_edges * sizeof(SceneCrossing));
+    SceneEvent* events = (SceneEvent*)arena_alloc(&frame_arena, max_edges * sizeof(SceneEvent));
+    int* depth = (int*)arena_alloc(&frame_arena, num_polys * sizeof(int));     // Intervalos abertos por polígono
+    int* open_polys = (int*)arena_alloc(&frame_arena, max_edges * sizeof(int)); // Polígonos com depth > 0
+    if (!edges || !active || !crossings || !events || !depth || !open_polys) {
+        printf("Falha ao alocar memoria para a cena.\n");
+        return;
+    }
+
+    int num_edges = 0;
+    int y_min = SDL_MAX_SINT32, y_max = SDL_MIN_SINT32;
+    for (int p = 0; p < num_polys; ++p) {
+        if (polys[p].num_vertices < 3) continue;
+        for (int i = 0; i < polys[p].num_vertices; ++i) {
+            SDL_Point p1 = polys[p].vertices[i];
+            SDL_Point p2 = polys[p].vertices[(i + 1) % polys[p].num_vertices];
+            if (p1.y == p2.y) continue;
+            SDL_Point top = p1.y < p2.y ? p1 : p2;
+            SDL_Point bottom = p1.y < p2.y ? p2 : p1;
+            edge_dda_init(&edges[num_edges].dda, top, bottom, top.y);
+            edges[num_edges].y_top = top.y;
+            edges[num_edges].poly = p;
+            num_edges++;
+            if (top.y < y_min) y_min = top.y;
+            if (bottom.y > y_max) y_max = bottom.y;
+        }
+        depth[p] = 0;
+    }
+    if (num_edges == 0) return;
+    SDL_qsort(edges, num_edges, sizeof(SceneEdge), compare_scene_edges);
+
+    // 2. Uma única passada de y_min até y_max
+    int next_edge = 0, num_active = 0;
+    Uint32 current_color = 0; // Cor atualmente no renderer (RGBA empacotado)
+    bool have_color = false;
+    for (int y = y_min; y < y_max; ++y) {
+        // Arestas que começam nesta linha entram na lista ativa (AET)
+        while (next_edge < num_edges && edges[next_edge].y_top == y) {
+            active[num_active++] = next_edge++;
+        }
+
+        // Cruzamentos das arestas ativas; as que terminaram saem da AET
+        int num_crossings = 0, kept = 0;
+        for (int i = 0; i < num_active; ++i) {
+            SceneEdge* e = &edges[active[i]];
+            if (e->dda.y_end <= y) continue;
+            crossings[num_crossings].x = edge_dda_x(&e->dda);
+            crossings[num_crossings].poly = e->poly;
+            num_crossings++;
+            edge_dda_step(&e->dda);
+            active[kept++] = active[i];
+        }
+        num_active = kept;
+        if (num_crossings == 0) continue;
+
+        // 3. Intervalos fechados [a, b] de cada polígono (pares de cruzamentos)
+        SDL_qsort(crossings, num_crossings, sizeof(SceneCrossing), compare_scene_crossings);
+        int num_events = 0;
+        for (int i = 0; i + 1 < num_crossings; ) {
+            if (crossings[i].poly != crossings[i + 1].poly) { i++; continue; }
+            SceneEvent start = { crossings[i].x, crossings[i].poly, +1 };
+            SceneEvent end = { crossings[i + 1].x + 1, crossings[i].poly, -1 };
+            events[num_events++] = start;
+            events[num_events++] = end;
+            i += 2;
+        }
+        SDL_qsort(events, num_events, sizeof(SceneEvent), compare_scene_events);
+
+        // 4. Varre os eventos: o dono de cada trecho é o maior índice aberto.
+        // O span fica pendente enquanto o próximo trecho continuar a mesma cor.
+        int num_open = 0;
+        int pending_x0 = 0, pending_x1 = -1;
+        Uint32 pending_color = 0;
+        for (int i = 0; i < num_events; ) {
+            int x = events[i].x;
+            for (; i < num_events && events[i].x == x; ++i) {
+                int p = events[i].poly;
+                if (events[i].delta > 0) {
+                    if (depth[p]++ == 0) open_polys[num_open++] = p;
+                } else if (--depth[p] == 0) {
+                    for (int k = 0; k < num_open; ++k) {
+                        if (open_polys[k] == p) { open_polys[k] = open_polys[--num_open]; break; }
+                    }
+                }
+            }
+            if (num_open == 0 || i == num_events) continue;
+
+            int owner = open_polys[0];
+            for (int k = 1; k < num_open; ++k) {
+                if (open_polys[k] > owner) owner = open_polys[k];
+            }
+            SDL_Color c = polys[owner].color;
+            Uint32 color = (Uint32)c.r << 24 | (Uint32)c.g << 16 | (Uint32)c.b << 8 | c.a;
+            if (pending_x1 >= pending_x0 && pending_x1 + 1 == x && pending_color == color) {
+                pending_x1 = events[i].x - 1;
+                continue;
+            }
+            if (pending_x1 >= pending_x0) {
+                scene_emit_span(renderer, y, pending_x0, pending_x1, pending_color, &current_color, &have_color);
+            }
+            pending_x0 = x;
+            pending_x1 = events[i].x - 1;
+            pending_color = color;
+        }
+        if (pending_x1 >= pending_x0) {
+            scene_emit_span(renderer, y, pending_x0, pending_x1, pending_color, &current_color, &have_color);
+        }
+    }
+}
+
+// Ponto de entrada medido por --perf
+void fill_polygons_scene(SDL_Renderer* renderer, ColoredPolygon polys[], int num_polys) {
+    PerfSample start;
+    bool counted = perf_begin(&start);
+    fill_polygons_scene_impl(renderer, polys, num_polys);
+    perf_end(PERF_STAGE_FILL_SCENE, &start, counted);
+}
+
+/**
+ * @brief Mesmo resultado de fill_polygons_scene, pelo caminho ingênuo:
+ * um preenchimento por polígono, em ordem (com sobreposição).
+ */
+void fill_polygons_painter(SDL_Renderer* renderer, ColoredPolygon polys[], int num_polys) {
+    for (int p = 0; p < num_polys; ++p) {
+        SDL_Color c = polys[p].color;
+        SDL_SetRenderDrawColor(renderer, c.r, c.g, c.b, c.a);
+        fill_polygon_tuned(renderer, polys[p].vertices, polys[p].num_vertices);
+    }
+}
+
+// --- Contornos grossos (stroker) ---
+
+typedef enum {
+    JOIN_MITER, // Bico, até o limite de miter (depois vira bevel)
+    JOIN_ROUND, // Arco de raio width/2
+    JOIN_BEVEL  // Corta o canto com uma reta
+} LineJoin;
+
+typedef enum {
+    CAP_BUTT,   // Termina rente ao ponto final
+    CAP_SQUARE, // Estende width/2 além do ponto final
+    CAP_ROUND   // Meio círculo
+} LineCap;
+
+typedef struct {
+    float width;
+    LineJoin join;
+    LineCap cap;
+    float miter_limit; // Razão máxima entre o bico e a meia largura
+} StrokeStyle;
+
+/*
+ * O stroker não desenha nada sozinho: ele transforma a polilinha em peças
+ * convexas (um retângulo por segmento, uma cunha por junção e as pontas)
+ * e entrega todas de uma vez a fill_polygons_scene, que desenha a união com
+ * cada pixel escrito uma única vez. Assim o custo cresce com a área do
+ * traço, não com largura x comprimento como no caso de várias retas de 1
+ * pixel deslocadas.
+ */
+typedef struct {
+    ColoredPolygon* pieces;
+    int num_pieces;
+    SDL_Point* vertices;   // Vértices de todas as peças, em sequência
+    int num_vertices;
+    int arc_steps;         // Passos de um meio círculo de raio width/2
+    float half_width;
+    SDL_Color color;
+} Stroker;
+
+static void stroker_begin_piece(Stroker* s) {
+    ColoredPolygon* p = &s->pieces[s->num_pieces++];
+    p->vertices = s->vertices + s->num_vertices;
+    p->num_vertices = 0;
+    p->color = s->color;
+}
+
+static inline void stroker_add(Stroker* s, float x, float y) {
+    SDL_Point v = { (int)lrintf(x), (int)lrintf(y) };
+    s->vertices[s->num_vertices++] = v;
+    s->pieces[s->num_pieces - 1].num_vertices++;
+}
+
+// Arco em torno de c de a0 até a0 + sweep (radianos), pontas incluídas
+static void stroker_add_arc(Stroker* s, SDL_FPoint c, float a0, float sweep) {
+    int steps = (int)ceilf(fabsf(sweep) / (float)M_PI * s->arc_steps);
+    if (steps < 1) steps = 1;
+    for (int k = 0; k <= steps; ++k) {
+        float a = a0 + sweep * k / steps;
+        stroker_add(s, c.x + s->half_width * cosf(a), c.y + s->half_width * sinf(a));
+    }
+}
+
+// Junção no ponto p entre os segmentos de direções d0 (chegando) e d1 (saindo)
+static void stroker_join(Stroker* s, const StrokeStyle* style, SDL_FPoint p, SDL_FPoint d0, SDL_FPoint d1) {
+    float cross = d0.x * d1.y - d0.y * d1.x;
+    float dot = d0.x * d1.x + d0.y * d1.y;
+    if (fabsf(cross) < 1e-6f && dot > 0.0f) return; // Segmentos alinhados
+
+    // Lado de fora da curva: normais (-d.y, d.x) com o sinal contrário à virada
+    float side = cross > 0.0f ? -1.0f : 1.0f;
+    float hw = s->half_width;
+    SDL_FPoint n0 = { -d0.y * side, d0.x * side };
+    SDL_FPoint n1 = { -d1.y * side, d1.x * side };
+
+    stroker_begin_piece(s);
+    stroker_add(s, p.x, p.y);
+    if (style->join == JOIN_ROUND) {
+        float a0 = atan2f(n0.y, n0.x);
+        stroker_add_arc(s, p, a0, atan2f(n0.x * n1.y - n0.y * n1.x, n0.x * n1.x + n0.y * n1.y));
+        return;
+    }
+    stroker_add(s, p.x + n0.x * hw, p.y + n0.y * hw);
+    float n_dot = n0.x * n1.x + n0.y * n1.y;
+    // Comprimento do bico / meia largura = 1 / cos(ângulo / 2) = sqrt(2 / (1 + n0.n1))
+    if (style->join == JOIN_MITER && n_dot > -0.999f && 2.0f / (1.0f + n_dot) <= style->miter_limit * style->miter_limit) {
+        float k = hw / (1.0f + n_dot);
+        stroker_add(s, p.x + (n0.x + n1.x) * k, p.y + (n0.y + n1.y) * k);
+    }
+    stroker_add(s, p.x + n1.x * hw, p.y + n1.y * hw);
+}
+
+/**
+ * @brief Desenha uma polilinha (ou o contorno de um polígono) com largura,
+ * junções e pontas. A geometria do traço é montada como peças convexas e
+ * rasterizada uma vez por fill_polygons_scene, em spans sem sobreposição.
+ * * @param renderer O renderizador SDL.
+ * @param points Pontos da polilinha.
+ * @param num_points O número de pontos.
+ * @param closed true para fechar (contorno de polígono, sem pontas).
+ * @param style Largura, junção, ponta e limite de miter.
+ * @param color Cor do traço.
+ */
+void stroke_polyline(SDL_Renderer* renderer, const SDL_FPoint points[], int num_points, bool closed,
+                     const StrokeStyle* style, SDL_Color color) {
+    if (num_points < 2 || style->width <= 0.0f) return;
+
+    // 1. Pontos sem repetições consecutivas (segmentos de comprimento zero)
+    SDL_FPoint* pts = (SDL_FPoint*)arena_alloc(&frame_arena, num_points * sizeof(SDL_FPoint));
+    if (!pts) {
+        printf("Falha ao alocar memoria para o contorno.\n");
+        return;
+    }
+    int n = 0;
+    for (int i = 0; i < num_points; ++i) {
+        if (n > 0 && points[i].x == pts[n - 1].x && points[i].y == pts[n - 1].y) continue;
+        pts[n++] = points[i];
+    }
+    if (closed && n > 2 && pts[0].x == pts[n - 1].x && pts[0].y == pts[n - 1].y) n--;
+    if (n < 2) return;
+    if (n < 3) closed = false;
+
+    Stroker s;
+    s.half_width = style->width * 0.5f;
+    s.color = color;
+    // Passos do arco para a corda não se afastar mais de 1/4 de pixel do círculo
+    s.arc_steps = 2;
+    if (s.half_width > 0.25f) {
+        s.arc_steps = (int)ceilf((float)M_PI / (2.0f * acosf(1.0f - 0.25f / s.half_width)));
+        if (s.arc_steps < 2) s.arc_steps = 2;
+    }
+
+    // 2. Espaço para todas as peças: segmentos, junções e duas pontas
+    int num_segments = closed ? n : n - 1;
+    int num_joins = closed ? n : n - 2;
+    int max_pieces = num_segments + num_joins + 2;
+    int max_vertices = 6 * num_segments + (s.arc_steps + 3) * (num_joins + 2);
+    s.pieces = (ColoredPolygon*)arena_alloc(&frame_arena, max_pieces * sizeof(ColoredPolygon));
+    s.vertices = (SDL_Point*)arena_alloc(&frame_arena, max_vertices * sizeof(SDL_Point));
+    SDL_FPoint* dirs = (SDL_FPoint*)arena_alloc(&frame_arena, num_segments * sizeof(SDL_FPoint));
+    if (!s.pieces || !s.vertices || !dirs) {
+        printf("Falha ao alocar memoria para o contorno.\n");
+        return;
+    }
+    s.num_pieces = 0;
+    s.num_vertices = 0;
+
+    for (int i = 0; i < num_segments; ++i) {
+        SDL_FPoint a = pts[i], b = pts[(i + 1) % n];
+        float len = sqrtf((b.x - a.x) * (b.x - a.x) + (b.y - a.y) * (b.y - a.y));
+        dirs[i].x = (b.x - a.x) / len;
+        dirs[i].y = (b.y - a.y) / len;
+    }
+
+    // 3. Um retângulo por segmento (a ponta quadrada só estica os das extremidades).
+    // Os pontos da polilinha entram como vértices nos lados curtos para que,
+    // depois de arredondados, os lados coincidam com os das junções e pontas.
+    float hw = s.half_width;
+    for (int i = 0; i < num_segments; ++i) {
+        SDL_FPoint a = pts[i], b = pts[(i + 1) % n], d = dirs[i];
+        if (!closed && style->cap == CAP_SQUARE) {
+            if (i == 0) { a.x -= d.x * hw; a.y -= d.y * hw; }
+            if (i == num_segments - 1) { b.x += d.x * hw; b.y += d.y * hw; }
+        }
+        float nx = -d.y * hw, ny = d.x * hw;
+        stroker_begin_piece(&s);
+        stroker_add(&s, a.x + nx, a.y + ny);
+        stroker_add(&s, b.x + nx, b.y + ny);
+        stroker_add(&s, b.x, b.y);
+        stroker_add(&s, b.x - nx, b.y - ny);
+        stroker_add(&s, a.x - nx, a.y - ny);
+        stroker_add(&s, a.x, a.y);
+    }
+
+    // 4. Junções nos vértices internos (em todos, se for fechada)
+    for (int i = closed ? 0 : 1; i < (closed ? n : n - 1); ++i) {
+        int prev = (i - 1 + num_segments) % num_segments;
+        stroker_join(&s, style, pts[i], dirs[prev], dirs[i]);
+    }
+
+    // 5. Pontas redondas: meio círculo virado para fora (com o centro no diâmetro)
+    if (!closed && style->cap == CAP_ROUND) {
+        SDL_FPoint d = dirs[0];
+        stroker_begin_piece(&s);
+        stroker_add_arc(&s, pts[0], atan2f(d.x, -d.y), (float)M_PI);
+        stroker_add(&s, pts[0].x, pts[0].y);
+        d = dirs[num_segments - 1];
+        stroker_begin_piece(&s);
+        stroker_add_arc(&s, pts[n - 1], atan2f(-d.x, d.y), (float)M_PI);
+        stroker_add(&s, pts[n - 1].x, pts[n - 1].y);
+    }
+
+    fill_polygons_scene(renderer, s.pieces, s.num_pieces);
+}
+
+// --- Formas e índice espacial ---
+
+// Um polígono da cena e os dados derivados dele que não mudam a cada quadro
+typedef struct {
+    SDL_Point* vertices;
+    int num_vertices;
+    SDL_Rect bbox;  // Caixa envolvente (w/h incluem o último pixel)
+    bool convex;    // Resultado de is_polygon_convex()
+} Shape;
+
+/**
+ * @brief Recalcula a caixa envolvente e a convexidade de uma forma.
+ */
+void shape_update(Shape* shape) {
+    int x_min = shape->vertices[0].x, x_max = x_min;
+    int y_min = shape->vertices[0].y, y_max = y_min;
+    for (int i = 1; i < shape->num_vertices; ++i) {
+        SDL_Point p = shape->vertices[i];
+        if (p.x < x_min) x_min = p.x;
+        if (p.x > x_max) x_max = p.x;
+        if (p.y < y_min) y_min = p.y;
+        if (p.y > y_max) y_max = p.y;
+    }
+    shape->bbox.x = x_min;
+    shape->bbox.y = y_min;
+    shape->bbox.w = x_max - x_min + 1;
+    shape->bbox.h = y_max - y_min + 1;
+    shape->convex = is_polygon_convex(shape->vertices, shape->num_vertices);
+}
+
+/**
+ * @brief Teste par-ímpar de ponto dentro do polígono (para seleção com o mouse).
+ * Usa a mesma regra de arestas do scanline: cada aresta vale para y em
+ * [min, max).
+ */
+bool point_in_polygon(SDL_Point vertices[], int num_vertices, int x, int y) {
+    bool inside = false;
+    for (int i = 0; i < num_vertices; ++i) {
+        SDL_Point p1 = vertices[i];
+        SDL_Point p2 = vertices[(i + 1) % num_vertices];
+        if ((p1.y <= y && p2.y > y) || (p1.y > y && p2.y <= y)) {
+            double x_intersect = (double)(y - p1.y) * (p2.x - p1.x) / (double)(p2.y - p1.y) + p1.x;
+            if (x_intersect <= x) inside = !inside;
+        }
+    }
+    return inside;
+}
+
+/*
+ * Grade uniforme sobre as caixas envolventes das formas. Cada célula guarda
+ * os ids das formas que a tocam; uma forma grande aparece em várias células.
+ * Coordenadas fora do mundo caem nas células da borda. Inserir, remover ou
+ * mover uma forma só mexe nas células dela, sem reconstruir a grade.
+ */
+typedef struct {
+    int* ids;
+    int count;
+    int capacity;
+} GridCell;
+
+typedef struct {
+    SDL_Rect bbox;  // Caixa com que a forma foi inserida
+    Uint32 stamp;   // Última consulta que já devolveu esta forma
+    bool used;
+} GridItem;
+
+typedef struct {
+    SDL_Rect world;
+    int cell_size;
+    int cols, rows;
+    GridCell* cells;
+    GridItem* items;    // Indexado pelo id da forma
+    int item_capacity;
+    int num_items;      // Formas inseridas no momento
+    Uint32 stamp;
+} SpatialGrid;
+
+bool grid_init(SpatialGrid* grid, SDL_Rect world, int cell_size) {
+    SDL_zerop(grid);
+    grid->world = world;
+    grid->cell_size = cell_size;
+    grid->cols = (world.w + cell_size - 1) / cell_size;
+    grid->rows = (world.h + cell_size - 1) / cell_size;
+    grid->cells = (GridCell*)SDL_calloc((size_t)grid->cols * grid->rows, sizeof(GridCell));
+    return grid->cells != NULL;
+}
+
+void grid_destroy(SpatialGrid* grid) {
+    if (grid->cells) {
+        for (int i = 0; i < grid->cols * grid->rows; ++i) {
+            SDL_free(grid->cells[i].ids);
+        }
+    }
+    SDL_free(grid->cells);
+    SDL_free(grid->items);
+    SDL_zerop(grid);
+}
+
+// Intervalo de células [c0, c1] x [r0, r1] coberto por um retângulo
+static void grid_cell_range(const SpatialGrid* grid, SDL_Rect r, int* c0, int* r0, int* c1, int* r1) {
+    *c0 = (r.x - grid->world.x) / grid->cell_size;
+    *r0 = (r.y - grid->world.y) / grid->cell_size;
+    *c1 = (r.x + r.w - 1 - grid->world.x) / grid->cell_size;
+    *r1 = (r.y + r.h - 1 - grid->world.y) / grid->cell_size;
+    *c0 = SDL_clamp(*c0, 0, grid->cols - 1);
+    *c1 = SDL_clamp(*c1, 0, grid->cols - 1);
+    *r0 = SDL_clamp(*r0, 0, grid->rows - 1);
+    *r1 = SDL_clamp(*r1, 0, grid->rows - 1);
+}
+
+/**
+ * @brief Insere a forma 'id' com a caixa 'bbox'.
+ * @return false se faltar memória.
+ */
+bool grid_insert(SpatialGrid* grid, int id, SDL_Rect bbox) {
+    if (id >= grid->item_capacity) {
+        int capacity = grid->item_capacity ? grid->item_capacity : 64;
+        while (capacity <= id) capacity *= 2;
+        GridItem* items = (GridItem*)SDL_realloc(grid->items, capacity * sizeof(GridItem));
+        if (!items) return false;
+        SDL_memset(items + grid->item_capacity, 0, (capacity - grid->item_capacity) * sizeof(GridItem));
+        grid->items = items;
+        grid->item_capacity = capacity;
+    }
+
+    int c0, r0, c1, r1;
+    grid_cell_range(grid, bbox, &c0, &r0, &c1, &r1);
+    for (int r = r0; r <= r1; ++r) {
+        for (int c = c0; c <= c1; ++c) {
+            GridCell* cell = &grid->cells[r * grid->cols + c];
+            if (cell->count == cell->capacity) {
+                int capacity = cell->capacity ? cell->capacity * 2 : 8;
+                int* ids = (int*)SDL_realloc(cell->ids, capacity * sizeof(int));
+                if (!ids) return false;
+                cell->ids = ids;
+                cell->capacity = capacity;
+            }
+            cell->ids[cell->count++] = id;
+        }
+    }
+
+    grid->items[id].bbox = bbox;
+    grid->items[id].used = true;
+    grid->num_items++;
+    return true;
+}
+
+/**
+ * @brief Retira a forma 'id' das células que ela ocupa.
+ */
+void grid_remove(SpatialGrid* grid, int id) {
+    if (id < 0 || id >= grid->item_capacity || !grid->items[id].used) return;
+
+    int c0, r0, c1, r1;
+    grid_cell_range(grid, grid->items[id].bbox, &c0, &r0, &c1, &r1);
+    for (int r = r0; r <= r1; ++r) {
+        for (int c = c0; c <= c1; ++c) {
+            GridCell* cell = &grid->cells[r * grid->cols + c];
+            for (int i = 0; i < cell->count; ++i) {
+                if (cell->ids[i] == id) {
+                    cell->ids[i] = cell->ids[--cell->count]; // A ordem não importa
+                    break;
+                }
+            }
+        }
+    }
+    grid->items[id].used = false;
+    grid->num_items--;
+}
+
+/**
+ * @brief Atualiza a caixa de uma forma que se moveu ou mudou de tamanho.
+ */
+bool grid_update(SpatialGrid* grid, int id, SDL_Rect bbox) {
+    grid_remove(grid, id);
+    return grid_insert(grid, id, bbox);
+}
+
+/**
+ * @brief Formas cuja caixa intersecta 'rect' (recorte pela área visível).
+ * O vetor de saída vem da arena do quadro e só vale até o próximo reset.
+ * @return Quantas formas foram encontradas (em ordem crescente de id).
+ */
+int grid_query_rect(SpatialGrid* grid, SDL_Rect rect, int** out) {
+    *out = NULL;
+    if (grid->num_items == 0 || rect.w <= 0 || rect.h <= 0) return 0;
+
+    int* found = (int*)arena_alloc(&frame_arena, grid->num_items * sizeof(int));
+    if (!found) return 0;
+    *out = found;
+
+    // O carimbo evita devolver duas vezes a forma que ocupa várias células
+    if (++grid->stamp == 0) {
+        for (int i = 0; i < grid->item_capacity; ++i) grid->items[i].stamp = 0;
+        grid->stamp = 1;
+    }
+
+    int count = 0;
+    int c0, r0, c1, r1;
+    grid_cell_range(grid, rect, &c0, &r0, &c1, &r1);
+    for (int r = r0; r <= r1; ++r) {
+        for (int c = c0; c <= c1; ++c) {
+            const GridCell* cell = &grid->cells[r * grid->cols + c];
+            for (int i = 0; i < cell->count; ++i) {
+                GridItem* item = &grid->items[cell->ids[i]];
+                if (item->stamp == grid->stamp) continue;
+                item->stamp = grid->stamp;
+                if (SDL_HasIntersection(&item->bbox, &rect)) {
+                    found[count++] = cell->ids[i];
+                }
+            }
+        }
+    }
+
+    // Mantém a ordem de desenho (ids menores primeiro)
+    SDL_qsort(found, count, sizeof(int), compare_ints);
+    return count;
+}
+
+/**
+ * @brief Formas cuja caixa contém o ponto (x, y): candidatas para o clique.
+ * Só consulta uma célula. O vetor de saída vem da arena do quadro.
+ */
+int grid_query_point(SpatialGrid* grid, int x, int y, int** out) {
+    SDL_Rect probe = { x, y, 1, 1 };
+    return grid_query_rect(grid, probe, out);
+}
+
+// --- Formas retidas ---
+
+typedef enum {
+    RETAINED_OUTLINE,   // Contorno do polígono (draw_polygon)
+    RETAINED_FILL,      // Polígono preenchido
+    RETAINED_LINE       // Linha recortada pela janela de recorte (Cohen-Sutherland)
+} RetainedKind;
+
+/*
+ * Forma em modo retido: guarda a geometria e o resultado da rasterização
+ * (pontos e spans). Enquanto a geometria e a janela de recorte não mudam,
+ * desenhar é só repetir o cache com SDL_RenderFillRects/SDL_RenderDrawPoints.
+ * A cor não entra no cache (é aplicada ao repetir), então trocá-la não obriga
+ * a rasterizar de novo.
+ */
+typedef struct {
+    RetainedKind kind;
+    Shape shape;            // OUTLINE/FILL: vértices, bbox e convexidade
+    double line[4];         // LINE: x0, y0, x1, y1 originais
+    SDL_Color color;
+    bool use_clip;          // OUTLINE/FILL: recorta os pixels pela janela de recorte
+
+    // Cache
+    bool valid;
+    Uint32 clip_version;    // clip_window_version quando o cache foi feito
+    double clipped[4];      // LINE: extremos depois do recorte
+    bool clipped_visible;   // LINE: false se a linha foi rejeitada
+    RasterRecording raster; // Pontos e spans emitidos
+} RetainedShape;
+
+void retained_init_polygon(RetainedShape* rs, RetainedKind kind, SDL_Point vertices[], int num_vertices, SDL_Color color) {
+    SDL_zerop(rs);
+    rs->kind = kind;
+    rs->shape.vertices = vertices;
+    rs->shape.num_vertices = num_vertices;
+    rs->color = color;
+    shape_update(&rs->shape);
+}
+
+void retained_init_line(RetainedShape* rs, double x0, double y0, double x1, double y1, SDL_Color color) {
+    SDL_zerop(rs);
+    rs->kind = RETAINED_LINE;
+    rs->line[0] = x0;
+    rs->line[1] = y0;
+    rs->line[2] = x1;
+    rs->line[3] = y1;
+    rs->color = color;
+    rs->use_clip = true;
+}
+
+/**
+ * @brief Avisa que os vértices (ou a linha) mudaram: o cache será refeito.
+ */
+void retained_geometry_changed(RetainedShape* rs) {
+    if (rs->kind != RETAINED_LINE) shape_update(&rs->shape);
+    rs->valid = false;
+}
+
+void retained_destroy(RetainedShape* rs) {
+    SDL_free(rs->raster.spans);
+    SDL_free(rs->raster.points);
+    SDL_zerop(rs);
+}
+
+// O cache depende da janela de recorte se a forma for recortada
+static bool retained_is_valid(const RetainedShape* rs) {
+    return rs->valid && !rs->raster.failed && (!rs->use_clip || rs->clip_version == clip_window_version);
+}
+
+/**
+ * @brief Rasteriza a forma de novo, gravando o resultado no cache.
+ */
+static void retained_rebuild(RetainedShape* rs, SDL_Renderer* renderer) {
+    RasterRecording* rec = &rs->raster;
+    rec->num_spans = 0;
+    rec->num_points = 0;
+    rec->num_pixels = 0;
+    rec->failed = false;
+    rec->clip = rs->use_clip && rs->kind != RETAINED_LINE; // A linha já sai recortada
+    rec->x_min = X_MIN;
+    rec->y_min = Y_MIN;
+    rec->x_max = X_MAX;
+    rec->y_max = Y_MAX;
+
+    RasterRecording* prev = raster_recording;
+    raster_recording = rec;
+    switch (rs->kind) {
+        case RETAINED_OUTLINE:
+            draw_polygon(renderer, rs->shape.vertices, rs->shape.num_vertices);
+            break;
+        case RETAINED_FILL:
+            if (rs->shape.convex) {
+                fill_convex_polygon(renderer, rs->shape.vertices, rs->shape.num_vertices);
+            } else {
+                fill_polygon_scanline(renderer, rs->shape.vertices, rs->shape.num_vertices);
+            }
+            break;
+        case RETAINED_LINE:
+            SDL_memcpy(rs->clipped, rs->line, sizeof(rs->clipped));
+            rs->clipped_visible = clip_line(&rs->clipped[0], &rs->clipped[1], &rs->clipped[2], &rs->clipped[3]);
+            if (rs->clipped_visible) {
+                draw_line_midpoint(renderer, (int)round(rs->clipped[0]), (int)round(rs->clipped[1]),
+                                   (int)round(rs->clipped[2]), (int)round(rs->clipped[3]));
+            }
+            break;
+    }
+    raster_recording = prev;
+
+    rs->clip_version = clip_window_version;
+    rs->valid = true;
+}
+
+/**
+ * @brief Desenha a forma, rasterizando só se o cache estiver velho.
+ * @return true se precisou rasterizar de novo.
+ */
+bool retained_draw(SDL_Renderer* renderer, RetainedShape* rs) {
+    bool rebuilt = false;
+    if (!retained_is_valid(rs)) {
+        AllocTag prev_tag = alloc_set_tag(rs->kind == RETAINED_LINE ? ALLOC_TAG_CLIP : ALLOC_TAG_FILL);
+        retained_rebuild(rs, renderer);
+        alloc_set_tag(prev_tag);
+        rebuilt = true;
+    }
+
+    raster_pixels_written += rs->raster.num_pixels;
+    if (raster_overdraw) {
+        // O cache conta como se a forma fosse rasterizada de novo
+        for (int s = 0; s < rs->raster.num_spans; ++s) {
+            const SDL_Rect* r = &rs->raster.spans[s];
+            overdraw_span(raster_overdraw, r->y, r->x, r->x + r->w - 1);
+        }
+        for (int p = 0; p < rs->raster.num_points; ++p) {
+            overdraw_point(raster_overdraw, rs->raster.points[p].x, rs->raster.points[p].y);
+        }
+        return rebuilt;
+    }
+    SDL_SetRenderDrawColor(renderer, rs->color.r, rs->color.g, rs->color.b, rs->color.a);
+    if (rs->raster.num_spans > 0) {
+        SDL_RenderFillRects(renderer, rs->raster.spans, rs->raster.num_spans);
+    }
+    if (rs->raster.num_points > 0) {
+        SDL_RenderDrawPoints(renderer, rs->raster.points, rs->raster.num_points);
+    }
+    return rebuilt;
+}
+
+// --- Cena grande (modo 6) ---
+
+// Uma cena de muitas formas pequenas, em coordenadas de mundo
+typedef struct {
+    Shape* shapes;
+    int num_shapes;
+    SDL_Point* points;  // Vértices de todas as formas
+    SpatialGrid grid;
+} Scene;
+
+const int SCENE_NUM_SHAPES = 20000;
+const int SCENE_WORLD_SIZE = 8192;
+const int SCENE_CELL_SIZE = 128;
+const int SCENE_MAX_VERTICES = 6;
+
+/**
+ * @brief Gera uma cena com polígonos convexos aleatórios e monta a grade.
+ */
+bool scene_generate(Scene* scene, int num_shapes) {
+    AllocTag prev_tag = alloc_set_tag(ALLOC_TAG_SCENE);
+    SDL_zerop(scene);
+    SDL_Rect world = { 0, 0, SCENE_WORLD_SIZE, SCENE_WORLD_SIZE };
+    scene->shapes = (Shape*)SDL_malloc(num_shapes * sizeof(Shape));
+    scene->points = (SDL_Point*)SDL_malloc((size_t)num_shapes * SCENE_MAX_VERTICES * sizeof(SDL_Point));
+    bool ok = scene->shapes && scene->points && grid_init(&scene->grid, world, SCENE_CELL_SIZE);
+
+    srand(1234); // Sempre a mesma cena
+    for (int i = 0; ok && i < num_shapes; ++i) {
+        Shape* shape = &scene->shapes[i];
+        shape->vertices = scene->points + (size_t)i * SCENE_MAX_VERTICES;
+        shape->num_vertices = 3 + rand() % (SCENE_MAX_VERTICES - 2);
+
+        // Vértices num círculo (ângulos crescentes): sempre convexo
+        int cx = rand() % SCENE_WORLD_SIZE;
+        int cy = rand() % SCENE_WORLD_SIZE;
+        int radius = 8 + rand() % 40;
+        for (int v = 0; v < shape->num_vertices; ++v) {
+            double a = 2.0 * M_PI * (v + (rand() % 100) / 200.0) / shape->num_vertices;
+            shape->vertices[v].x = cx + (int)round(radius * cos(a));
+            shape->vertices[v].y = cy + (int)round(radius * sin(a));
+        }
+        shape_update(shape);
+        ok = grid_insert(&scene->grid, i, shape->bbox);
+        scene->num_shapes++;
+    }
+    alloc_set_tag(prev_tag);
+    return ok;
+}
+
+void scene_destroy(Scene* scene) {
+    grid_destroy(&scene->grid);
+    SDL_free(scene->shapes);
+    SDL_free(scene->points);
+    SDL_zerop(scene);
+}
+
+/**
+ * @brief Id da forma mais acima (desenhada por último) sob o ponto, ou -1.
+ */
+int scene_pick(Scene* scene, int x, int y) {
+    int* candidates;
+    int count = grid_query_point(&scene->grid, x, y, &candidates);
+    for (int i = count - 1; i >= 0; --i) {
+        Shape* shape = &scene->shapes[candidates[i]];
+        if (point_in_polygon(shape->vertices, shape->num_vertices, x, y)) {
+            return candidates[i];
+        }
+    }
+    return -1;
+}
+
+/**
+ * @brief Move a forma 'id' por (dx, dy) e atualiza só as células dela.
+ */
+void scene_move_shape(Scene* scene, int id, int dx, int dy) {
+    Shape* shape = &scene->shapes[id];
+    for (int v = 0; v < shape->num_vertices; ++v) {
+        shape->vertices[v].x += dx;
+        shape->vertices[v].y += dy;
+    }
+    shape_update(shape);
+    grid_update(&scene->grid, id, shape->bbox);
+}
+
+/**
+ * @brief Desenha só as formas visíveis na 'view' (coordenadas de mundo).
+ * * @param renderer O renderizador SDL.
+ * @param scene A cena.
+ * @param view Área do mundo que aparece na janela.
+ * @param selected Forma selecionada (desenhada em branco), ou -1.
+ * @return Quantas formas passaram pelo recorte de visão.
+ */
+int draw_scene(SDL_Renderer* renderer, Scene* scene, SDL_Rect view, int selected) {
+    int* visible;
+    int count = grid_query_rect(&scene->grid, view, &visible);
+    SDL_Point* screen = (SDL_Point*)arena_alloc(&frame_arena, SCENE_MAX_VERTICES * sizeof(SDL_Point));
+    if (!screen) return 0;
+
+    for (int i = 0; i < count; ++i) {
+        Shape* shape = &scene->shapes[visible[i]];
+        for (int v = 0; v < shape->num_vertices; ++v) {
+            screen[v].x = shape->vertices[v].x - view.x;
+            screen[v].y = shape->vertices[v].y - view.y;
+        }
+
+        if (visible[i] == selected) {
+            SDL_SetRenderDrawColor(renderer, 255, 255, 255, 255);
+        } else {
+            SDL_SetRenderDrawColor(renderer, 40 + visible[i] % 200, 120, 255 - visible[i] % 200, 255);
+        }
+        if (shape->convex) {
+            fill_convex_polygon(renderer, screen, shape->num_vertices);
+        } else {
+            fill_polygon_tuned(renderer, screen, shape->num_vertices);
+        }
+    }
+    return count;
+}
+
+// --- Transformações afins em lote ---
+
+// Matriz 2x3: x' = a*x + b*y + tx, y' = c*x + d*y + ty
+typedef struct {
+    float a, b, tx;
+    float c, d, ty;
+} Affine2D;
+
+Affine2D affine_identity(void) {
+    Affine2D m = { 1, 0, 0, 0, 1, 0 };
+    return m;
+}
+
+Affine2D affine_translate(float tx, float ty) {
+    Affine2D m = { 1, 0, tx, 0, 1, ty };
+    return m;
+}
+
+Affine2D affine_rotate(float radians) {
+    float c = cosf(radians), s = sinf(radians);
+    Affine2D m = { c, -s, 0, s, c, 0 };
+    return m;
+}
+
+Affine2D affine_scale(float sx, float sy) {
+    Affine2D m = { sx, 0, 0, 0, sy, 0 };
+    return m;
+}
+
+/**
+ * @brief Composição m1 * m2 (aplica m2 primeiro, depois m1).
+ */
+Affine2D affine_multiply(Affine2D m1, Affine2D m2) {
+    Affine2D r;
+    r.a  = m1.a * m2.a + m1.b * m2.c;
+    r.b  = m1.a * m2.b + m1.b * m2.d;
+    r.tx = m1.a * m2.tx + m1.b * m2.ty + m1.tx;
+    r.c  = m1.c * m2.a + m1.d * m2.c;
+    r.d  = m1.c * m2.b + m1.d * m2.d;
+    r.ty = m1.c * m2.tx + m1.d * m2.ty + m1.ty;
+    return r;
+}
+
+/*
+ * Vértices em estrutura de arrays (todos os x, depois todos os y), o formato
+ * que os registradores SIMD consomem direto. Montado uma vez por forma; as
+ * instâncias só leem daqui.
+ */
+typedef struct {
+    float* x;
+    float* y;
+    int count;
+} VertexSoA;
+
+bool soa_from_points(VertexSoA* soa, SDL_Point points[], int count) {
+    soa->x = (float*)SDL_SIMDAlloc(count * sizeof(float));
+    soa->y = (float*)SDL_SIMDAlloc(count * sizeof(float));
+    soa->count = count;
+    if (!soa->x || !soa->y) return false;
+    for (int i = 0; i < count; ++i) {
+        soa->x[i] = (float)points[i].x;
+        soa->y[i] = (float)points[i].y;
+    }
+    return true;
+}
+
+void soa_destroy(VertexSoA* soa) {
+    SDL_SIMDFree(soa->x);
+    SDL_SIMDFree(soa->y);
+    SDL_zerop(soa);
+}
+
+/*
+ * Transforma e já arredonda para SDL_Point no mesmo passo. O arredondamento
+ * é o padrão da FPU (meio para o par), igual em lrintf e em cvtps2dq, então
+ * todas as variantes dão o mesmo resultado.
+ */
+typedef void (*TransformFunc)(const Affine2D* m, const float* xs, const float* ys, int count, SDL_Point* out);
+
+static void transform_points_scalar(const Affine2D* m, const float* xs, const float* ys, int count, SDL_Point* out) {
+    for (int i = 0; i < count; ++i) {
+        float x = xs[i], y = ys[i];
+        out[i].x = (int)lrintf(m->a * x + m->b * y + m->tx);
+        out[i].y = (int)lrintf(m->c * x + m->d * y + m->ty);
+    }
+}
+
+#if HAVE_X86_SIMD
+static void transform_points_sse2(const Affine2D* m, const float* xs, const float* ys, int count, SDL_Point* out) {
+    __m128 a = _mm_set1_ps(m->a), b = _mm_set1_ps(m->b), tx = _mm_set1_ps(m->tx);
+    __m128 c = _mm_set1_ps(m->c), d = _mm_set1_ps(m->d), ty = _mm_set1_ps(m->ty);
+    int i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m128 x = _mm_loadu_ps(xs + i);
+        __m128 y = _mm_loadu_ps(ys + i);
+        __m128i ix = _mm_cvtps_epi32(_mm_add_ps(_mm_add_ps(_mm_mul_ps(a, x), _mm_mul_ps(b, y)), tx));
+        __m128i iy = _mm_cvtps_epi32(_mm_add_ps(_mm_add_ps(_mm_mul_ps(c, x), _mm_mul_ps(d, y)), ty));
+        // Intercala x e y no layout de SDL_Point
+        _mm_storeu_si128((__m128i*)(out + i), _mm_unpacklo_epi32(ix, iy));
+        _mm_storeu_si128((__m128i*)(out + i + 2), _mm_unpackhi_epi32(ix, iy));
+    }
+    transform_points_scalar(m, xs + i, ys + i, count - i, out + i);
+}
+
+TARGET_AVX
+static void transform_points_avx(const Affine2D* m, const float* xs, const float* ys, int count, SDL_Point* out) {
+    __m256 a = _mm256_set1_ps(m->a), b = _mm256_set1_ps(m->b), tx = _mm256_set1_ps(m->tx);
+    __m256 c = _mm256_set1_ps(m->c), d = _mm256_set1_ps(m->d), ty = _mm256_set1_ps(m->ty);
+    int i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m256 x = _mm256_loadu_ps(xs + i);
+        __m256 y = _mm256_loadu_ps(ys + i);
+        __m256 ix = _mm256_castsi256_ps(_mm256_cvtps_epi32(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(a, x), _mm256_mul_ps(b, y)), tx)));
+        __m256 iy = _mm256_castsi256_ps(_mm256_cvtps_epi32(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(c, x), _mm256_mul_ps(d, y)), ty)));
+        // AVX1 não tem unpack inteiro de 256 bits: intercala como float
+        // (são só bits) e depois reordena as metades de 128 bits.
+        __m256 lo = _mm256_unpacklo_ps(ix, iy); // x0 y0 x1 y1 | x4 y4 x5 y5
+        __m256 hi = _mm256_unpackhi_ps(ix, iy); // x2 y2 x3 y3 | x6 y6 x7 y7
+        _mm256_storeu_ps((float*)(out + i), _mm256_permute2f128_ps(lo, hi, 0x20));
+        _mm256_storeu_ps((float*)(out + i + 4), _mm256_permute2f128_ps(lo, hi, 0x31));
+    }
+    transform_points_sse2(m, xs + i, ys + i, count - i, out + i);
+}
+#endif
+
+// Variante escolhida por transform_init() conforme a CPU
+TransformFunc transform_points = transform_points_scalar;
+
+/**
+ * @brief Escolhe a variante mais larga que a CPU suporta.
+ * @return Nome da variante escolhida.
+ */
+const char* transform_init(void) {
+#if HAVE_X86_SIMD
+    if (SDL_HasAVX()) {
+        transform_points = transform_points_avx;
+        return "avx";
+    }
+    transform_points = transform_points_sse2;
+    return "sse2";
+#else
+    transform_points = transform_points_scalar;
+    return "escalar";
+#endif
+}
+
+/**
+ * @brief Desenha o mesmo polígono sob várias transformações (instâncias).
+ * Cada instância é transformada uma vez para um buffer da arena, reaproveitado
+ * entre instâncias; os vértices de origem nunca são copiados.
+ * * @param renderer O renderizador SDL.
+ * @param src Vértices de origem (SoA).
+ * @param instances Uma matriz por instância.
+ * @param num_instances Quantas instâncias.
+ * @param convex Convexidade da forma de origem (preservada pela transformação).
+ * @param filled Preenche (true) ou só contorna (false).
+ */
+void draw_polygon_instances(SDL_Renderer* renderer, const VertexSoA* src, const Affine2D instances[], int num_instances, bool convex, bool filled) {
+    SDL_Point* screen = (SDL_Point*)arena_alloc(&frame_arena, src->count * sizeof(SDL_Point));
+    if (!screen) return;
+
+    for (int i = 0; i < num_instances; ++i) {
+        transform_points(&instances[i], src->x, src->y, src->count, screen);
+        if (!filled) {
+            draw_polygon(renderer, screen, src->count);
+        } else if (convex) {
+            // Convexo continua monótono em y depois de transformado e
+            // arredondado (o arredondamento não inverte a ordem dos y)
+            fill_convex_polygon(renderer, screen, src->count);
+        } else {
+            fill_polygon_tuned(renderer, screen, src->count);
+        }
+    }
+}
+
+// --- Definição das formas ---
+SDL_Point triangulo[] = {
+    {320, 50},  // Topo
+    {120, 250}, // Canto inferior esquerdo
+    {520, 250}  // Canto inferior direito
+};
+const int num_vertices_tri = 3;
+
+SDL_Point pentagono[] = {
+    {100, 300}, {200, 300}, {250, 400}, {150, 450}, {50, 400}
+};
+const int num_vertices_pen = 5;
+
+// Forma com furos do modo 12: anel externo no sentido horário (na tela),
+// um furo no sentido contrário e outro no mesmo sentido. Pela regra
+// par-ímpar os dois são furos; pela não nula só o de sentido contrário.
+SDL_Point anel_externo[] = {
+    {170, 110}, {470, 110}, {470, 390}, {170, 390}
+};
+SDL_Point furo_inverso[] = {
+    {210, 160}, {210, 340}, {300, 340}, {300, 160}
+};
+SDL_Point furo_mesmo_sentido[] = {
+    {340, 160}, {430, 250}, {340, 340}
+};
+
+// Polígonos sobrepostos do modo 8
+enum { OVERLAP_NUM_POLYGONS = 60, OVERLAP_MAX_VERTICES = 9 };
+ColoredPolygon overlap_polygons[OVERLAP_NUM_POLYGONS];
+SDL_Point overlap_points[OVERLAP_NUM_POLYGONS * OVERLAP_MAX_VERTICES];
+
+/**
+ * @brief Gera polígonos (alguns côncavos) empilhados no meio da janela.
+ */
+void overlap_scene_init(void) {
+    srand(99); // Sempre a mesma cena
+    for (int p = 0; p < OVERLAP_NUM_POLYGONS; ++p) {
+        ColoredPolygon* poly = &overlap_polygons[p];
+        poly->vertices = overlap_points + p * OVERLAP_MAX_VERTICES;
+        poly->num_vertices = 5 + rand() % (OVERLAP_MAX_VERTICES - 4);
+        int cx = 160 + rand() % 320;
+        int cy = 120 + rand() % 240;
+        for (int v = 0; v < poly->num_vertices; ++v) {
+            double a = 2.0 * M_PI * v / poly->num_vertices;
+            double r = (v % 2 && p % 3 == 0) ? 50.0 : 80.0 + rand() % 80; // Um terço com "dentes"
+            poly->vertices[v].x = cx + (int)round(r * cos(a));
+            poly->vertices[v].y = cy + (int)round(r * sin(a));
+        }
+        poly->color.r = (Uint8)(50 + rand() % 206);
+        poly->color.g = (Uint8)(50 + rand() % 206);
+        poly->color.b = (Uint8)(50 + rand() % 206);
+        poly->color.a = 255;
+    }
+}
+
+// Malha de triângulos do modo 13: grade cobrindo a janela, com os vértices
+// internos deslocados ao acaso (as bordas ficam retas)
+enum { MESH_COLS = 16, MESH_ROWS = 12, MESH_NUM_TRIANGLES = MESH_COLS * MESH_ROWS * 2 };
+SDL_Point mesh_points[(MESH_COLS + 1) * (MESH_ROWS + 1)];
+SDL_Point mesh_triangles[MESH_NUM_TRIANGLES][3];
+
+void mesh_init(void) {
+    srand(7); // Sempre a mesma malha
+    int cell_w = SCREEN_WIDTH / MESH_COLS, cell_h = SCREEN_HEIGHT / MESH_ROWS;
+    for (int r = 0; r <= MESH_ROWS; ++r) {
+        for (int c = 0; c <= MESH_COLS; ++c) {
+            SDL_Point p = { c * SCREEN_WIDTH / MESH_COLS, r * SCREEN_HEIGHT / MESH_ROWS };
+            if (c > 0 && c < MESH_COLS) p.x += rand() % (cell_w / 2) - cell_w / 4;
+            if (r > 0 && r < MESH_ROWS) p.y += rand() % (cell_h / 2) - cell_h / 4;
+            mesh_points[r * (MESH_COLS + 1) + c] = p;
+        }
+    }
+    int t = 0;
+    for (int r = 0; r < MESH_ROWS; ++r) {
+        for (int c = 0; c < MESH_COLS; ++c) {
+            SDL_Point p00 = mesh_points[r * (MESH_COLS + 1) + c];
+            SDL_Point p10 = mesh_points[r * (MESH_COLS + 1) + c + 1];
+            SDL_Point p01 = mesh_points[(r + 1) * (MESH_COLS + 1) + c];
+            SDL_Point p11 = mesh_points[(r + 1) * (MESH_COLS + 1) + c + 1];
+            // A diagonal alterna para não ter todas no mesmo sentido
+            bool flip = (r + c) % 2;
+            mesh_triangles[t][0] = p00;
+            mesh_triangles[t][1] = p10;
+            mesh_triangles[t][2] = flip ? p01 : p11;
+            t++;
+            mesh_triangles[t][0] = flip ? p10 : p00;
+            mesh_triangles[t][1] = p11;
+            mesh_triangles[t][2] = p01;
+            t++;
+        }
+    }
+}
+
+/**
+ * @brief Rasteriza a malha inteira contando (sem desenhar) quantas vezes cada
+ * pixel da janela foi escrito. A contagem usa o caminho do mapa de
+ * sobreposição direto em 'counts', então nada é alocado.
+ * * @param fill O preenchimento a testar.
+ * @param counts Saída: SCREEN_WIDTH x SCREEN_HEIGHT contadores (saturam em 255).
+ * @param doubles Saída: pixels escritos mais de uma vez.
+ * @param holes Saída: pixels da janela que nenhum triângulo escreveu.
+ */
+void mesh_count_writes(void (*fill)(SDL_Renderer*, SDL_Point[], int), Uint8* counts, int* doubles, int* holes) {
+    SDL_memset(counts, 0, (size_t)SCREEN_WIDTH * SCREEN_HEIGHT);
+    OverdrawBuffer od = { counts, SCREEN_WIDTH, SCREEN_HEIGHT, 0 };
+    OverdrawBuffer* prev = raster_overdraw;
+    Uint64 prev_written = raster_pixels_written; // A contagem não é desenho
+    raster_overdraw = &od;
+    for (int t = 0; t < MESH_NUM_TRIANGLES; ++t) {
+        fill(NULL, mesh_triangles[t], 3);
+    }
+    raster_overdraw = prev;
+    raster_pixels_written = prev_written;
+
+    *doubles = 0;
+    *holes = 0;
+    for (int i = 0; i < SCREEN_WIDTH * SCREEN_HEIGHT; ++i) {
+        *doubles += counts[i] > 1;
+        *holes += counts[i] == 0;
+    }
+}
+
+/**
+ * @brief Pinta, na cor atual do renderer, os pixels com contador > 1.
+ * Cada sequência na mesma linha vira um retângulo, enviados em lotes.
+ */
+void mesh_draw_doubles(SDL_Renderer* renderer, const Uint8* counts) {
+    enum { MESH_RECT_BATCH = 512 };
+    SDL_Rect* rects = (SDL_Rect*)arena_alloc(&frame_arena, MESH_RECT_BATCH * sizeof(SDL_Rect));
+    if (!rects) return;
+    int n = 0;
+    for (int y = 0; y < SCREEN_HEIGHT; ++y) {
+        const Uint8* row = counts + (size_t)y * SCREEN_WIDTH;
+        for (int x = 0; x < SCREEN_WIDTH; ++x) {
+            if (row[x] < 2) continue;
+            int x0 = x;
+            while (x + 1 < SCREEN_WIDTH && row[x + 1] > 1) x++;
+            SDL_Rect r = { x0, y, x - x0 + 1, 1 };
+            rects[n++] = r;
+            if (n == MESH_RECT_BATCH) {
+                SDL_RenderFillRects(renderer, rects, n);
+                n = 0;
+            }
+        }
+    }
+    if (n > 0) SDL_RenderFillRects(renderer, rects, n);
+}
+
+// Formas fixas dos modos 0-5, em modo retido
+typedef struct {
+    RetainedShape tri_contorno;
+    RetainedShape tri_preenchido;
+    RetainedShape pen_contorno;
+    RetainedShape linha_recortada;
+    RetainedShape linha_rejeitada;
+} DemoShapes;
+
+void demo_shapes_init(DemoShapes* demo) {
+    SDL_Color verde = { 0, 255, 0, 255 }, vermelho = { 255, 0, 0, 255 };
+    SDL_Color azul = { 0, 0, 255, 255 }, amarelo = { 255, 255, 0, 255 };
+    AllocTag prev_tag = alloc_set_tag(ALLOC_TAG_SCENE);
+    retained_init_polygon(&demo->tri_contorno, RETAINED_OUTLINE, triangulo, num_vertices_tri, verde);
+    retained_init_polygon(&demo->tri_preenchido, RETAINED_FILL, triangulo, num_vertices_tri, verde);
+    retained_init_polygon(&demo->pen_contorno, RETAINED_OUTLINE, pentagono, num_vertices_pen, vermelho);
+    retained_init_line(&demo->linha_recortada, 50.0, 50.0, 600.0, 450.0, azul);
+    retained_init_line(&demo->linha_rejeitada, 10.0, 10.0, 50.0, 400.0, amarelo);
+    alloc_set_tag(prev_tag);
+}
+
+void demo_shapes_destroy(DemoShapes* demo) {
+    retained_destroy(&demo->tri_contorno);
+    retained_destroy(&demo->tri_preenchido);
+    retained_destroy(&demo->pen_contorno);
+    retained_destroy(&demo->linha_recortada);
+    retained_destroy(&demo->linha_rejeitada);
+}
+
+/**
+ * @brief Desenha o conteúdo de um dos modos estáticos (0-5).
+ * @return Quantas formas retidas precisaram ser rasterizadas de novo.
+ */
+int draw_static_mode(SDL_Renderer* renderer, DemoShapes* demo, int mode) {
+    SDL_Rect clip_rect = { X_MIN, Y_MIN, X_MAX - X_MIN, Y_MAX - Y_MIN };
+    int rebuilds = 0;
+
+    switch (mode) {
+        case 0: //  // Desenhar triangulo
+            rebuilds += retained_draw(renderer, &demo->tri_contorno);
+            break;
+        case 1: // Encher Triangulo
+            rebuilds += retained_draw(renderer, &demo->tri_preenchido);
+            break;
+        case 2: // Desenhar polígono (Pentagono)
+            rebuilds += retained_draw(renderer, &demo->pen_contorno);
+            break;
+        case 3: // Caixa para fazer o clip
+            SDL_SetRenderDrawColor(renderer, 100, 100, 100, 255);
+            SDL_RenderDrawRect(renderer, &clip_rect);
+            break;
+        case 4: // Linha com o clip
+            SDL_SetRenderDrawColor(renderer, 100, 100, 100, 255);
+            SDL_RenderDrawRect(renderer, &clip_rect);
+            rebuilds += retained_draw(renderer, &demo->linha_recortada);
+            break;
+        case 5: // Linha feita com o clip fora da caixa
+            SDL_SetRenderDrawColor(renderer, 100, 100, 100, 255);
+            SDL_RenderDrawRect(renderer, &clip_rect);
+            rebuilds += retained_draw(renderer, &demo->linha_rejeitada);
+            break;
+        default:
+            break;
+    }
+    return rebuilds;
+}
+
+// --- Texturas pré-renderizadas dos modos estáticos ---
+
+enum { NUM_STATIC_MODES = 6 };
+
+/*
+ * Cada modo estático é desenhado uma vez numa textura alvo e, nos quadros
+ * seguintes, apresentado com um único SDL_RenderCopy. A textura é refeita se
+ * o tamanho da saída mudar, se o driver perder os alvos
+ * (SDL_RENDER_TARGETS_RESET) ou, nos modos que mostram a janela de
+ * recorte (3-5), se ela mudar.
+ */
+typedef struct {
+    SDL_Texture* textures[NUM_STATIC_MODES];
+    Uint32 clip_version[NUM_STATIC_MODES];
+    int width, height;  // Tamanho da saída para o qual as texturas foram feitas
+    bool enabled;
+} ModeTextures;
+
+void mode_textures_invalidate(ModeTextures* mt) {
+    for (int i = 0; i < NUM_STATIC_MODES; ++i) {
+        if (mt->textures[i]) SDL_DestroyTexture(mt->textures[i]);
+        mt->textures[i] = NULL;
+    }
+}
+
+/**
+ * @brief Apresenta o modo com a textura dele, criando-a se preciso.
+ * * @param renderer O renderizador SDL.
+ * @param mt As texturas dos modos.
+ * @param demo As formas dos modos.
+ * @param mode Modo estático (0-5).
+ * @param rebuilds Soma as formas retidas rasterizadas de novo.
+ * @return false se não há suporte a texturas alvo (o chamador desenha direto).
+ */
+bool mode_textures_draw(SDL_Renderer* renderer, ModeTextures* mt, DemoShapes* demo, int mode, int* rebuilds) {
+    int w, h;
+    if (SDL_GetRendererOutputSize(renderer, &w, &h) < 0) return false;
+    if (w != mt->width || h != mt->height) {
+        mode_textures_invalidate(mt);
+        mt->width = w;
+        mt->height = h;
+    }
+
+    SDL_Texture* texture = mt->textures[mode];
+    bool stale = texture == NULL || (mode >= 3 && mt->clip_version[mode] != clip_window_version);
+    if (!texture) {
+        AllocTag prev_tag = alloc_set_tag(ALLOC_TAG_RENDERER);
+        texture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_TARGET, w, h);
+        alloc_set_tag(prev_tag);
+        if (!texture) return false;
+    }
+
+    if (stale) {
+        if (SDL_SetRenderTarget(renderer, texture) < 0) {
+            // Uma textura nova nunca desenhada não pode ser guardada: os modos
+            // 0-2 só a refazem quando ela falta
+            if (texture != mt->textures[mode]) SDL_DestroyTexture(texture);
+            return false;
+        }
+        SDL_SetRenderDrawColor(renderer, 0, 0, 0, 255);
+        SDL_RenderClear(renderer);
+        *rebuilds += draw_static_mode(renderer, demo, mode);
+        SDL_SetRenderTarget(renderer, NULL);
+        mt->textures[mode] = texture;
+        mt->clip_version[mode] = clip_window_version;
+    }
+
+    // A textura cobre a tela inteira: nem o SDL_RenderClear é necessário
+    SDL_RenderCopy(renderer, texture, NULL, NULL);
+    return true;
+}
+
+// --- Thread de renderização (modo 14) ---
+
+/*
+ * O loop de eventos não rasteriza: ele monta uma lista de comandos por quadro
+ * e a entrega por um anel SPSC (um produtor, um consumidor) sem travas, feito
+ * só de SDL_atomic_t. A thread de renderização executa a lista num dos três
+ * framebuffers e publica o quadro pronto; o loop de eventos só envia o mais
+ * recente para a textura. Com o anel cheio a lista do quadro é descartada em
+ * vez de esperar, então tratar a entrada não depende do custo de desenhar.
+ */
+typedef enum {
+    CMD_CLEAR,        // Limpa o framebuffer com 'color'
+    CMD_FILL_POLYGON, // fill_polygon_topleft nos vértices da lista
+    CMD_LINE          // framebuffer_draw_line de (x0, y0) a (x1, y1)
+} DrawCommandType;
+
+typedef struct {
+    DrawCommandType type;
+    SDL_Color color;
+    int first_vertex;      // CMD_FILL_POLYGON: posição em CommandList.vertices
+    int num_vertices;
+    float x0, y0, x1, y1;  // CMD_LINE
+    LineStyle style;
+} DrawCommand;
+
+enum { CMD_MAX_COMMANDS = 8192, CMD_MAX_VERTICES = 65536, RENDER_QUEUE_SLOTS = 4 };
+
+typedef struct {
+    DrawCommand commands[CMD_MAX_COMMANDS];
+    int num_commands;
+    SDL_Point vertices[CMD_MAX_VERTICES];
+    int num_vertices;
+    Uint64 submitted;      // SDL_GetPerformanceCounter() na entrega
+} CommandList;
+
+void cmdlist_reset(CommandList* list) {
+    list->num_commands = 0;
+    list->num_vertices = 0;
+}
+
+static DrawCommand* cmdlist_push(CommandList* list, DrawCommandType type, SDL_Color color) {
+    if (list->num_commands == CMD_MAX_COMMANDS) return NULL;
+    DrawCommand* cmd = &list->commands[list->num_commands++];
+    cmd->type = type;
+    cmd->color = color;
+    return cmd;
+}
+
+void cmdlist_clear(CommandList* list, SDL_Color color) {
+    cmdlist_push(list, CMD_CLEAR, color);
+}
+
+bool cmdlist_fill_polygon(CommandList* list, const SDL_Point vertices[], int num_vertices, SDL_Color color) {
+    if (list->num_vertices + num_vertices > CMD_MAX_VERTICES) return false;
+    DrawCommand* cmd = cmdlist_push(list, CMD_FILL_POLYGON, color);
+    if (!cmd) return false;
+    cmd->first_vertex = list->num_vertices;
+    cmd->num_vertices = num_vertices;
+    SDL_memcpy(list->vertices + list->num_vertices, vertices, num_vertices * sizeof(SDL_Point));
+    list->num_vertices += num_vertices;
+    return true;
+}
+
+bool cmdlist_line(CommandList* list, float x0, float y0, float x1, float y1, SDL_Color color, LineStyle style) {
+    DrawCommand* cmd = cmdlist_push(list, CMD_LINE, color);
+    if (!cmd) return false;
+    cmd->x0 = x0;
+    cmd->y0 = y0;
+    cmd->x1 = x1;
+    cmd->y1 = y1;
+    cmd->style = style;
+    return true;
+}
+
+// Executa a lista no framebuffer (na thread que chamar; usa a arena dela)
+void cmdlist_execute(const CommandList* list, Framebuffer* fb) {
+    Framebuffer* prev = raster_framebuffer;
+    raster_framebuffer = fb;
+    for (int i = 0; i < list->num_commands; ++i) {
+        const DrawCommand* cmd = &list->commands[i];
+        switch (cmd->type) {
+            case CMD_CLEAR:
+                framebuffer_clear(fb, framebuffer_map(cmd->color));
+                break;
+            case CMD_FILL_POLYGON:
+                fb->color = framebuffer_map(cmd->color);
+                fill_polygon_topleft(NULL, (SDL_Point*)list->vertices + cmd->first_vertex, cmd->num_vertices);
+                break;
+            case CMD_LINE:
+                framebuffer_draw_line(fb, cmd->x0, cmd->y0, cmd->x1, cmd->y1, cmd->color, cmd->style);
+                break;
+        }
+    }
+    raster_framebuffer = prev;
+}
+
+// Anel SPSC: 'head' só é escrito pelo produtor e 'tail' só pelo consumidor
+typedef struct {
+    CommandList* slots;    // RENDER_QUEUE_SLOTS listas pré-alocadas
+    SDL_atomic_t head;     // Próxima posição a preencher
+    SDL_atomic_t tail;     // Próxima posição a consumir
+} CommandRing;
+
+// Produtor: lista livre para preencher, ou NULL se o anel estiver cheio
+CommandList* ring_begin_push(CommandRing* ring) {
+    int head = SDL_AtomicGet(&ring->head);
+    if (head - SDL_AtomicGet(&ring->tail) == RENDER_QUEUE_SLOTS) return NULL;
+    return &ring->slots[head % RENDER_QUEUE_SLOTS];
+}
+
+// Produtor: publica a lista preenchida (SDL_AtomicSet é uma barreira completa)
+void ring_commit_push(CommandRing* ring) {
+    SDL_AtomicSet(&ring->head, SDL_AtomicGet(&ring->head) + 1);
+}
+
+// Consumidor: listas esperando na fila
+int ring_pending(CommandRing* ring) {
+    return SDL_AtomicGet(&ring->head) - SDL_AtomicGet(&ring->tail);
+}
+
+CommandList* ring_peek(CommandRing* ring) {
+    return &ring->slots[SDL_AtomicGet(&ring->tail) % RENDER_QUEUE_SLOTS];
+}
+
+void ring_pop(CommandRing* ring) {
+    SDL_AtomicSet(&ring->tail, SDL_AtomicGet(&ring->tail) + 1);
+}
+
+// Bit em 'ready' que indica um quadro ainda não enviado para a textura
+const int RENDER_FRESH = 4;
+
+typedef struct {
+    SDL_Thread* thread;
+    SDL_sem* wake;             // Acorda a thread quando chega uma lista
+    SDL_atomic_t quit;
+    CommandRing ring;
+    Framebuffer buffers[3];    // Triple buffering
+    SDL_atomic_t ready;        // Índice do último quadro pronto | RENDER_FRESH
+    int back;                  // Sendo desenhado (só a thread de renderização)
+    int front;                 // Na textura (só o loop de eventos)
+    SDL_Texture* texture;
+    SDL_atomic_t render_us;    // Tempo do último quadro na thread
+    SDL_atomic_t latency_us;   // Da entrega da lista até o quadro pronto
+    int dropped;               // Listas descartadas com o anel cheio
+} RenderThread;
+
+static int SDLCALL render_thread_main(void* data) {
+    RenderThread* rt = (RenderThread*)data;
+    while (!SDL_AtomicGet(&rt->quit)) {
+        SDL_SemWait(rt->wake);
+        while (ring_pending(&rt->ring) > 0) {
+            // Se já há uma lista mais nova, a velha não precisa ser desenhada
+            if (ring_pending(&rt->ring) > 1) {
+                ring_pop(&rt->ring);
+                continue;
+            }
+            CommandList* list = ring_peek(&rt->ring);
+            Uint64 start = SDL_GetPerformanceCounter();
+            arena_reset(&frame_arena);
+            cmdlist_execute(list, &rt->buffers[rt->back]);
+            Uint64 end = SDL_GetPerformanceCounter();
+            double freq = (double)SDL_GetPerformanceFrequency();
+            SDL_AtomicSet(&rt->render_us, (int)((double)(end - start) * 1e6 / freq));
+            SDL_AtomicSet(&rt->latency_us, (int)((double)(end - list->submitted) * 1e6 / freq));
+            ring_pop(&rt->ring);
+
+            // Publica o quadro e fica com o que estava pronto antes
+            rt->back = SDL_AtomicSet(&rt->ready, rt->back | RENDER_FRESH) & 3;
+        }
+    }
+    arena_destroy(&frame_arena);
+    return 0;
+}
+
+/**
+ * @brief Cria os framebuffers, o anel, a textura e inicia a thread.
+ * @return true se deu certo.
+ */
+bool render_thread_start(RenderThread* rt, SDL_Renderer* renderer) {
+    SDL_zerop(rt);
+    rt->ring.slots = (CommandList*)SDL_malloc(RENDER_QUEUE_SLOTS * sizeof(CommandList));
+    rt->wake = SDL_CreateSemaphore(0);
+    rt->texture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STREAMING, SCREEN_WIDTH, SCREEN_HEIGHT);
+    bool ok = rt->ring.slots && rt->wake && rt->texture;
+    for (int i = 0; i < 3 && ok; ++i) {
+        ok = framebuffer_init(&rt->buffers[i], NULL, SCREEN_WIDTH, SCREEN_HEIGHT);
+    }
+    if (!ok) {
+        printf("Falha ao preparar a thread de renderizacao! Erro: %s\n", SDL_GetError());
+        return false;
+    }
+    rt->back = 0;
+    SDL_AtomicSet(&rt->ready, 1);
+    rt->front = 2;
+    rt->thread = SDL_CreateThread(render_thread_main, "render", rt);
+    if (!rt->thread) {
+        printf("Thread de renderizacao nao pode ser criada! Erro: %s\n", SDL_GetError());
+        return false;
+    }
+    return true;
+}
+
+// Loop de eventos: lista do próximo quadro, ou NULL se a thread está atrasada
+CommandList* render_thread_begin(RenderThread* rt) {
+    CommandList* list = rt->thread ? ring_begin_push(&rt->ring) : NULL;
+    if (!list) {
+        rt->dropped++;
+        return NULL;
+    }
+    cmdlist_reset(list);
+    return list;
+}
+
+void render_thread_submit(RenderThread* rt, CommandList* list) {
+    list->submitted = SDL_GetPerformanceCounter();
+    ring_commit_push(&rt->ring);
+    SDL_SemPost(rt->wake);
+}
+
+// Loop de eventos: troca pelo quadro pronto mais recente (se houver) e o desenha
+void render_thread_present(SDL_Renderer* renderer, RenderThread* rt) {
+    if (SDL_AtomicGet(&rt->ready) & RENDER_FRESH) {
+        rt->front = SDL_AtomicSet(&rt->ready, rt->front) & 3;
+        Framebuffer* fb = &rt->buffers[rt->front];
+        SDL_UpdateTexture(rt->texture, NULL, fb->pixels, fb->pitch * (int)sizeof(Uint32));
+    }
+    SDL_RenderCopy(renderer, rt->texture, NULL, NULL);
+}
+
+void render_thread_stop(RenderThread* rt) {
+    if (rt->thread) {
+        SDL_AtomicSet(&rt->quit, 1);
+        SDL_SemPost(rt->wake);
+        SDL_WaitThread(rt->thread, NULL);
+    }
+    for (int i = 0; i < 3; ++i) framebuffer_destroy(&rt->buffers[i]);
+    if (rt->texture) SDL_DestroyTexture(rt->texture);
+    if (rt->wake) SDL_DestroySemaphore(rt->wake);
+    SDL_free(rt->ring.slots);
+    SDL_zerop(rt);
+}
+
+// --- Destinos por formato (modo 15) ---
+
+/**
+ * @brief Desenha os polígonos sobrepostos e um leque de retas num PixelTarget.
+ * Os preenchimentos chegam ao destino por raster_span() e as retas pelo laço
+ * de ponto médio do formato; a cor é convertida uma vez por primitiva.
+ * * @param scale Escala aplicada à cena de 640x480.
+ */
+void draw_pixel_format_scene(PixelTarget* t, float scale, float angle) {
+    enum { FAN_LINES = 90 };
+    PixelTarget* prev = raster_target;
+    raster_target = t;
+
+    SDL_Color preto = { 0, 0, 0, 255 };
+    pixel_target_set_color(t, preto);
+    t->writers->clear(t);
+
+    for (int i = 0; i < OVERLAP_NUM_POLYGONS; ++i) {
+        const ColoredPolygon* poly = &overlap_polygons[i];
+        SDL_Point scaled[OVERLAP_MAX_VERTICES];
+        for (int v = 0; v < poly->num_vertices; ++v) {
+            scaled[v].x = (int)lrintf(poly->vertices[v].x * scale);
+            scaled[v].y = (int)lrintf(poly->vertices[v].y * scale);
+        }
+        pixel_target_set_color(t, poly->color);
+        fill_polygon_topleft(NULL, scaled, poly->num_vertices);
+    }
+
+    SDL_Color branco = { 255, 255, 255, 255 };
+    pixel_target_set_color(t, branco);
+    float cx = t->width / 2.0f, cy = t->height / 2.0f, r = 0.45f * SDL_min(t->width, t->height);
+    for (int i = 0; i < FAN_LINES; ++i) {
+        float a = angle + 2.0f * (float)M_PI * i / FAN_LINES;
+        draw_line_midpoint(NULL, (int)lrintf(cx), (int)lrintf(cy), (int)lrintf(cx + r * cosf(a)), (int)lrintf(cy + r * sinf(a)));
+    }
+
+    raster_target = prev;
+}
+
+// --- Rasterização progressiva (modo 16) ---
+
+/*
+ * Um preenchimento enorme ou um milhão de retas travariam o loop de
+ * eventos até acabar. Aqui cada primitiva grande vira um trabalho que
+ * guarda onde parou (a próxima scanline do preenchimento ou o próximo
+ * segmento) e o escalonador roda os trabalhos, na ordem em que entraram,
+ * até gastar o orçamento do quadro; o resto fica para o quadro seguinte.
+ * Como o desenho atravessa vários quadros, o destino é um framebuffer
+ * que não é limpo entre eles. O tempo é conferido a cada scanline e a
+ * cada RASTER_LINE_CHUNK retas; um pedaço só começa se o custo do
+ * anterior ainda couber no orçamento. Todo quadro avança pelo menos um
+ * pedaço, mesmo com orçamento mínimo.
+ */
+enum { RASTER_MAX_JOBS = 8, RASTER_LINE_CHUNK = 256 };
+
+typedef enum {
+    RASTER_JOB_FILL,  // Polígono por scanline (par-ímpar, como fill_polygon_scanline)
+    RASTER_JOB_LINES  // Retas pelo ponto médio
+} RasterJobKind;
+
+typedef struct {
+    RasterJobKind kind;
+    Uint32 color;                    // ARGB no framebuffer
+    // Preenchimento: polígono e próxima scanline
+    SDL_Point* vertices;
+    int num_vertices;
+    int y;
+    int y_end;
+    ScanIntersection* intersections; // Do trabalho: a arena é zerada a cada quadro
+    // Retas: dois pontos por reta e a próxima a desenhar
+    const SDL_Point* endpoints;
+    int num_lines;
+    int next_line;
+    Uint64 unit_ticks;               // Custo do último pedaço, para não começar um que não cabe
+} RasterJob;
+
+typedef struct {
+    RasterJob jobs[RASTER_MAX_JOBS];
+    int num_jobs;
+    int current;       // Primeiro trabalho não terminado
+    Framebuffer* fb;   // Destino que fica de um quadro para o outro
+    Uint64 work_total; // Scanlines + retas de todos os trabalhos
+    Uint64 work_done;
+    double used_ms;    // Tempo gasto no último quadro
+} RasterScheduler;
+
+void raster_scheduler_init(RasterScheduler* s, Framebuffer* fb) {
+    SDL_zerop(s);
+    s->fb = fb;
+}
+
+// Descarta os trabalhos (terminados ou não)
+void raster_scheduler_clear(RasterScheduler* s) {
+    for (int i = 0; i < s->num_jobs; ++i) SDL_free(s->jobs[i].intersections);
+    Framebuffer* fb = s->fb;
+    raster_scheduler_init(s, fb);
+}
+
+/**
+ * @brief Enfileira o preenchimento de um polígono. Os vértices precisam
+ * continuar válidos até o trabalho terminar.
+ * @return false se a fila está cheia ou faltou memória.
+ */
+bool raster_scheduler_add_fill(RasterScheduler* s, SDL_Point vertices[], int num_vertices, SDL_Color color) {
+    if (s->num_jobs == RASTER_MAX_JOBS || num_vertices < 3) return false;
+    RasterJob* job = &s->jobs[s->num_jobs];
+    SDL_zerop(job);
+    job->kind = RASTER_JOB_FILL;
+    job->color = framebuffer_map(color);
+    job->vertices = vertices;
+    job->num_vertices = num_vertices;
+    contours_y_range(&job->vertices, &job->num_vertices, 1, &job->y, &job->y_end);
+    job->intersections = (ScanIntersection*)SDL_malloc(num_vertices * sizeof(ScanIntersection));
+    if (!job->intersections) return false;
+    s->work_total += (Uint64)(job->y_end - job->y + 1);
+    s->num_jobs++;
+    return true;
+}
+
+/**
+ * @brief Enfileira retas (endpoints[2 * i] a endpoints[2 * i + 1]).
+ * @return false se a fila está cheia.
+ */
+bool raster_scheduler_add_lines(RasterScheduler* s, const SDL_Point* endpoints, int num_lines, SDL_Color color) {
+    if (s->num_jobs == RASTER_MAX_JOBS) return false;
+    RasterJob* job = &s->jobs[s->num_jobs++];
+    SDL_zerop(job);
+    job->kind = RASTER_JOB_LINES;
+    job->color = framebuffer_map(color);
+    job->endpoints = endpoints;
+    job->num_lines = num_lines;
+    s->work_total += (Uint64)num_lines;
+    return true;
+}
+
+static bool raster_job_finished(const RasterJob* job) {
+    return job->kind == RASTER_JOB_FILL ? job->y > job->y_end : job->next_line >= job->num_lines;
+}
+
+/**
+ * @brief Avança um trabalho, pedaço a pedaço, até ele acabar ou o próximo
+ * pedaço não caber antes de deadline.
+ * * @param must_progress Faz pelo menos um pedaço mesmo sem tempo.
+ * @return Unidades feitas (scanlines ou retas).
+ */
+static int raster_job_step(RasterJob* job, Uint64 deadline, bool must_progress) {
+    int done = 0;
+    Uint64 now = SDL_GetPerformanceCounter();
+    while (!raster_job_finished(job)) {
+        if ((done > 0 || !must_progress) && now + job->unit_ticks > deadline) break;
+        if (job->kind == RASTER_JOB_FILL) {
+            contours_scanline(NULL, &job->vertices, &job->num_vertices, 1, FILL_EVEN_ODD, job->y, job->intersections);
+            job->y++;
+            done++;
+        } else {
+            int end = SDL_min(job->next_line + RASTER_LINE_CHUNK, job->num_lines);
+            for (int i = job->next_line; i < end; ++i) {
+                const SDL_Point* p = job->endpoints + 2 * (size_t)i;
+                draw_line_midpoint(NULL, p[0].x, p[0].y, p[1].x, p[1].y);
+            }
+            done += end - job->next_line;
+            job->next_line = end;
+        }
+        Uint64 after = SDL_GetPerformanceCounter();
+        job->unit_ticks = after - now;
+        now = after;
+    }
+    return done;
+}
+
+bool raster_scheduler_done(const RasterScheduler* s) {
+    return s->current >= s->num_jobs;
+}
+
+/**
+ * @brief Roda os trabalhos pendentes no framebuffer até gastar o orçamento.
+ * * @param budget_ms Tempo máximo neste quadro.
+ * @return true se não sobrou nada.
+ */
+bool raster_scheduler_run(RasterScheduler* s, double budget_ms) {
+    Uint64 start = SDL_GetPerformanceCounter();
+    Uint64 deadline = start + (Uint64)(budget_ms * (double)SDL_GetPerformanceFrequency() / 1000.0);
+    Framebuffer* prev = raster_framebuffer;
+    raster_framebuffer = s->fb;
+    bool progressed = false;
+    while (s->current < s->num_jobs) {
+        RasterJob* job = &s->jobs[s->current];
+        s->fb->color = job->color;
+        int done = raster_job_step(job, deadline, !progressed);
+        s->work_done += (Uint64)done;
+        progressed = progressed || done > 0;
+        if (!raster_job_finished(job)) break; // Sem tempo para o resto
+        SDL_free(job->intersections);
+        job->intersections = NULL;
+        s->current++;
+    }
+    raster_framebuffer = prev;
+    s->used_ms = (double)(SDL_GetPerformanceCounter() - start) * 1000.0 / (double)SDL_GetPerformanceFrequency();
+    return raster_scheduler_done(s);
+}
+
+// Conteúdo pesado do modo 16: uma estrela de muitas pontas e um milhão de retas curtas
+enum { PROGRESSIVE_STAR_POINTS = 20000, PROGRESSIVE_LINES = 1000000, PROGRESSIVE_LINE_JOBS = 4 };
+
+typedef struct {
+    SDL_Point* star;      // 2 * PROGRESSIVE_STAR_POINTS vértices
+    SDL_Point* endpoints; // 2 * PROGRESSIVE_LINES pontos
+} ProgressiveScene;
+
+bool progressive_scene_generate(ProgressiveScene* scene) {
+    scene->star = (SDL_Point*)SDL_malloc(2 * PROGRESSIVE_STAR_POINTS * sizeof(SDL_Point));
+    scene->endpoints = (SDL_Point*)SDL_malloc(2 * (size_t)PROGRESSIVE_LINES * sizeof(SDL_Point));
+    if (!scene->star || !scene->endpoints) {
+        printf("Falha ao alocar memoria para o modo progressivo.\n");
+        SDL_free(scene->star);
+        SDL_free(scene->endpoints);
+        SDL_zerop(scene);
+        return false;
+    }
+    srand(4321); // Sempre o mesmo conteúdo
+    for (int i = 0; i < 2 * PROGRESSIVE_STAR_POINTS; ++i) {
+        float a = (float)M_PI * i / PROGRESSIVE_STAR_POINTS;
+        float r = (i % 2) ? 80.0f + rand() % 40 : 200.0f + rand() % 30;
+        scene->star[i].x = SCREEN_WIDTH / 2 + (int)lrintf(r * cosf(a));
+        scene->star[i].y = SCREEN_HEIGHT / 2 + (int)lrintf(r * sinf(a));
+    }
+    for (int i = 0; i < PROGRESSIVE_LINES; ++i) {
+        SDL_Point* p = scene->endpoints + 2 * (size_t)i;
+        p[0].x = rand() % SCREEN_WIDTH;
+        p[0].y = rand() % SCREEN_HEIGHT;
+        p[1].x = p[0].x + rand() % 41 - 20;
+        p[1].y = p[0].y + rand() % 41 - 20;
+    }
+    return true;
+}
+
+void progressive_scene_destroy(ProgressiveScene* scene) {
+    SDL_free(scene->star);
+    SDL_free(scene->endpoints);
+    SDL_zerop(scene);
+}
+
+// Põe a cena inteira na fila: a estrela primeiro, depois as retas em lotes de cores diferentes
+void progressive_scene_schedule(const ProgressiveScene* scene, RasterScheduler* s) {
+    static const SDL_Color cores[PROGRESSIVE_LINE_JOBS] = {
+        { 40, 90, 200, 255 }, { 40, 200, 120, 255 }, { 220, 200, 60, 255 }, { 220, 70, 70, 255 }
+    };
+    raster_scheduler_clear(s);
+    SDL_Color laranja = { 255, 140, 0, 255 };
+    raster_scheduler_add_fill(s, scene->star, 2 * PROGRESSIVE_STAR_POINTS, laranja);
+    const int per_job = PROGRESSIVE_LINES / PROGRESSIVE_LINE_JOBS;
+    for (int j = 0; j < PROGRESSIVE_LINE_JOBS; ++j) {
+        raster_scheduler_add_lines(s, scene->endpoints + 2 * (size_t)j * per_job, per_job, cores[j]);
+    }
+}
+
+// --- Mapa de sobreposição (tecla O) ---
+
+typedef struct {
+    Uint64 writes;   // Escritas no quadro
+    int unique;      // Pixels escritos ao menos uma vez
+    int repeated;    // Pixels escritos mais de uma vez
+    int max_depth;   // Maior contagem (satura em 255)
+} OverdrawSummary;
+
+// Cor de cada profundidade: preto, azul, ciano, verde, amarelo, laranja, vermelho, magenta, branco
+Uint32 overdraw_palette[256];
+
+static const int OVERDRAW_LEGEND[] = { 1, 2, 3, 4, 6, 8, 16, 255 };
+
+void overdraw_palette_init(void) {
+    static const struct { int depth; Uint8 r, g, b; } stops[] = {
+        { 0, 0, 0, 0 }, { 1, 0, 0, 160 }, { 2, 0, 160, 255 }, { 3, 0, 200, 0 }, { 4, 255, 230, 0 },
+        { 6, 255, 128, 0 }, { 8, 255, 0, 0 }, { 16, 255, 0, 255 }, { 255, 255, 255, 255 }
+    };
+    int s = 0;
+    for (int d = 0; d < 256; ++d) {
+        while (d > stops[s + 1].depth) s++;
+        float t = (float)(d - stops[s].depth) / (float)(stops[s + 1].depth - stops[s].depth);
+        SDL_Color c = {
+            (Uint8)(stops[s].r + t * (stops[s + 1].r - stops[s].r)),
+            (Uint8)(stops[s].g + t * (stops[s + 1].g - stops[s].g)),
+            (Uint8)(stops[s].b + t * (stops[s + 1].b - stops[s].b)),
+            255
+        };
+        overdraw_palette[d] = framebuffer_map(c);
+    }
+}
+
+bool overdraw_init(OverdrawBuffer* od, int width, int height) {
+    SDL_zerop(od);
+    od->counts = (Uint8*)SDL_calloc((size_t)width * height, 1);
+    if (!od->counts) return false;
+    od->width = width;
+    od->height = height;
+    return true;
+}
+
+void overdraw_destroy(OverdrawBuffer* od) {
+    SDL_free(od->counts);
+    SDL_zerop(od);
+}
+
+void overdraw_reset(OverdrawBuffer* od) {
+    SDL_memset(od->counts, 0, (size_t)od->width * od->height);
+    od->writes = 0;
+}
+
+void overdraw_summarize(const OverdrawBuffer* od, OverdrawSummary* sum) {
+    SDL_zerop(sum);
+    sum->writes = od->writes;
+    for (size_t i = 0; i < (size_t)od->width * od->height; ++i) {
+        int c = od->counts[i];
+        sum->unique += c > 0;
+        sum->repeated += c > 1;
+        if (c > sum->max_depth) sum->max_depth = c;
+    }
+}
+
+/**
+ * @brief Mostra os contadores como mapa de calor na tela inteira, com a
+ * legenda das cores e os totais do quadro.
+ * * @param fb Framebuffer do tamanho da tela, usado para a conversão.
+ */
+void overdraw_present(SDL_Renderer* renderer, const OverdrawBuffer* od, const OverdrawSummary* sum, Framebuffer* fb) {
+    for (int y = 0; y < od->height && y < fb->height; ++y) {
+        const Uint8* src = od->counts + (size_t)y * od->width;
+        Uint32* dst = fb->pixels + (size_t)y * fb->pitch;
+        for (int x = 0; x < od->width && x < fb->width; ++x) dst[x] = overdraw_palette[src[x]];
+    }
+    framebuffer_present(renderer, fb);
+
+    int y = SCREEN_HEIGHT - 2 * FONT_LINE_HEIGHT - 8;
+    int x = 4;
+    for (size_t i = 0; i < SDL_arraysize(OVERDRAW_LEGEND); ++i) {
+        Uint32 c = overdraw_palette[OVERDRAW_LEGEND[i]];
+        SDL_Rect box = { x, y, FONT_CHARACTER_SIZE, FONT_CHARACTER_SIZE };
+        SDL_SetRenderDrawColor(renderer, (Uint8)(c >> 16), (Uint8)(c >> 8), (Uint8)c, 255);
+        SDL_RenderFillRect(renderer, &box);
+        char label[8];
+        snprintf(label, sizeof(label), "%d", OVERDRAW_LEGEND[i]);
+        SDL_SetRenderDrawColor(renderer, 255, 255, 255, 255);
+        SDLTest_DrawString(renderer, x + FONT_CHARACTER_SIZE + 2, y, label);
+        x += FONT_CHARACTER_SIZE * 6;
+    }
+    char line[96];
+    snprintf(line, sizeof(line), "escritas %llu, pixels %d (%d repetidos), max %d, media %.2f",
+             (unsigned long long)sum->writes, sum->unique, sum->repeated, sum->max_depth,
+             sum->unique > 0 ? (double)sum->writes / sum->unique : 0.0);
+    SDLTest_DrawString(renderer, 4, y + FONT_LINE_HEIGHT + 2, line);
+}
+
+// --- Autotuner de kernels ---
+
+/*
+ * Várias rotinas têm mais de uma implementação com a mesma saída (spans
+ * de 32 bits, transformação de vértices, preenchimento par-ímpar por
+ * scanline ou edge flag), e qual é a mais rápida depende da máquina e do
+ * tamanho da entrada. No início, autotune_run() mede cada candidata em
+ * microbenchmarks curtos, calibrados para durar alguns milissegundos, e
+ * escolhe a mais rápida de cada classe. As escolhas ficam nos mesmos
+ * ponteiros de função de sempre (fill_span32, transform_points,
+ * fill_polygon_by_class) e no limite da limpeza com streaming. O resultado
+ * é guardado em AUTOTUNE_FILE com uma chave das capacidades da CPU
+ * (SDL_cpuinfo.h); se a chave bate, as medições são puladas. --kernels
+ * fixa escolhas na linha de comando, para execuções reproduzíveis.
+ */
+typedef enum {
+    KERNEL_SPAN,
+    KERNEL_TRANSFORM,
+    KERNEL_FILL_SMALL,  // Uma entrada por FillSizeClass, na mesma ordem
+    KERNEL_FILL_MEDIUM,
+    KERNEL_FILL_LARGE,
+    KERNEL_CLEAR,       // Limite da limpeza com streaming
+    KERNEL_SLOT_COUNT
+} KernelSlot;
+
+enum { KERNEL_MAX_CANDIDATES = 4 };
+
+static const char* const KERNEL_SLOT_NAMES[KERNEL_SLOT_COUNT] = {
+    "span", "transform", "fill_pequeno", "fill_medio", "fill_grande", "limpeza"
+};
+
+static const char* const KERNEL_CANDIDATE_NAMES[KERNEL_SLOT_COUNT][KERNEL_MAX_CANDIDATES] = {
+    { "escalar", "sse2", "avx2", NULL },
+    { "escalar", "sse2", "avx", NULL },
+    { "scanline", "edgeflag", NULL, NULL },
+    { "scanline", "edgeflag", NULL, NULL },
+    { "scanline", "edgeflag", NULL, NULL },
+    { "256k", "1m", "4m", "nunca" }, // A partir de que tamanho usar streaming
+};
+
+static const size_t CLEAR_STREAM_SIZES[KERNEL_MAX_CANDIDATES] = { 256 * 1024, 1024 * 1024, 4 * 1024 * 1024, SIZE_MAX };
+
+const char* const AUTOTUNE_FILE = "autotune.cfg";
+
+// Índice da candidata escolhida em cada slot
+typedef struct {
+    int choice[KERNEL_SLOT_COUNT];
+} KernelTable;
+
+// Tabela em uso (os padrões são os de fill_span32_init/transform_init)
+KernelTable kernel_table;
+
+static bool kernel_available(KernelSlot slot, int candidate) {
+    if (candidate < 0 || candidate >= KERNEL_MAX_CANDIDATES || !KERNEL_CANDIDATE_NAMES[slot][candidate]) return false;
+    switch (slot) {
+        case KERNEL_SPAN:
+#if HAVE_X86_SIMD
+            return candidate == 0 || candidate == 1 || (candidate == 2 && SDL_HasAVX2());
+#else
+            return candidate == 0;
+#endif
+        case KERNEL_TRANSFORM:
+#if HAVE_X86_SIMD
+            return candidate == 0 || candidate == 1 || (candidate == 2 && SDL_HasAVX());
+#else
+            return candidate == 0;
+#endif
+        default:
+            return true;
+    }
+}
+
+static FillSpan32Func span_candidate(int candidate, bool stream) {
+#if HAVE_X86_SIMD
+    if (candidate == 1) return stream ? fill_span32_stream_sse2 : fill_span32_sse2;
+    if (candidate == 2) return stream ? fill_span32_stream_avx2 : fill_span32_avx2;
+#endif
+    (void)candidate;
+    (void)stream;
+    return fill_span32_scalar;
+}
+
+static TransformFunc transform_candidate(int candidate) {
+#if HAVE_X86_SIMD
+    if (candidate == 1) return transform_points_sse2;
+    if (candidate == 2) return transform_points_avx;
+#endif
+    (void)candidate;
+    return transform_points_scalar;
+}
+
+static FillFunc fill_candidate(int candidate) {
+    return candidate == 1 ? fill_polygon_edgeflag_even_odd : fill_polygon_scanline;
+}
+
+/**
+ * @brief Instala as escolhas da tabela nos ponteiros de função.
+ */
+void kernel_table_apply(const KernelTable* table) {
+    kernel_table = *table;
+    fill_span32 = span_candidate(table->choice[KERNEL_SPAN], false);
+    fill_span32_stream = span_candidate(table->choice[KERNEL_SPAN], true);
+    transform_points = transform_candidate(table->choice[KERNEL_TRANSFORM]);
+    for (int c = 0; c < FILL_CLASS_COUNT; ++c) {
+        fill_polygon_by_class[c] = fill_candidate(table->choice[KERNEL_FILL_SMALL + c]);
+    }
+    fb_stream_bytes = CLEAR_STREAM_SIZES[table->choice[KERNEL_CLEAR]];
+}
+
+/**
+ * @brief Tabela equivalente ao que o programa fazia sem autotuner.
+ */
+void kernel_table_defaults(KernelTable* table) {
+    table->choice[KERNEL_SPAN] = kernel_available(KERNEL_SPAN, 2) ? 2 : kernel_available(KERNEL_SPAN, 1) ? 1 : 0;
+    table->choice[KERNEL_TRANSFORM] = kernel_available(KERNEL_TRANSFORM, 2) ? 2 : kernel_available(KERNEL_TRANSFORM, 1) ? 1 : 0;
+    for (int c = 0; c < FILL_CLASS_COUNT; ++c) table->choice[KERNEL_FILL_SMALL + c] = 0;
+    table->choice[KERNEL_CLEAR] = 2;
+}
+
+void kernel_table_print(const KernelTable* table) {
+    printf("kernels:");
+    for (int s = 0; s < KERNEL_SLOT_COUNT; ++s) {
+        printf(" %s=%s", KERNEL_SLOT_NAMES[s], KERNEL_CANDIDATE_NAMES[s][table->choice[s]]);
+    }
+    printf("\n");
+}
+
+/**
+ * @brief Muda uma escolha a partir de "slot=candidata".
+ * @return false se o slot ou a candidata não existem nesta máquina.
+ */
+bool kernel_table_set(KernelTable* table, const char* assignment) {
+    const char* eq = strchr(assignment, '=');
+    if (!eq) return false;
+    size_t slot_len = (size_t)(eq - assignment);
+    for (int s = 0; s < KERNEL_SLOT_COUNT; ++s) {
+        if (strlen(KERNEL_SLOT_NAMES[s]) != slot_len || strncmp(assignment, KERNEL_SLOT_NAMES[s], slot_len) != 0) continue;
+        for (int c = 0; c < KERNEL_MAX_CANDIDATES; ++c) {
+            if (kernel_available((KernelSlot)s, c) && strcmp(eq + 1, KERNEL_CANDIDATE_NAMES[s][c]) == 0) {
+                table->choice[s] = c;
+                return true;
+            }
+        }
+        return false;
+    }
+    return false;
+}
+
+/**
+ * @brief Aplica uma lista "slot=candidata,slot=candidata" (argumento de --kernels).
+ * @return false se alguma entrada não pôde ser usada.
+ */
+bool kernel_table_override(KernelTable* table, const char* list) {
+    char item[64];
+    bool ok = true;
+    while (*list) {
+        size_t len = strcspn(list, ",");
+        if (len >= sizeof(item)) len = sizeof(item) - 1;
+        SDL_memcpy(item, list, len);
+        item[len] = '\0';
+        if (!kernel_table_set(table, item)) {
+            printf("Kernel desconhecido ou indisponivel: %s\n", item);
+            ok = false;
+        }
+        list += strcspn(list, ",");
+        if (*list == ',') list++;
+    }
+    return ok;
+}
+
+// Capacidades que mudam o resultado das medições; a versão invalida arquivos antigos
+static void autotune_cpu_key(char* key, size_t size) {
+    snprintf(key, size, "v1 sse2=%d sse41=%d avx=%d avx2=%d avx512f=%d neon=%d cpus=%d cache=%d",
+             SDL_HasSSE2(), SDL_HasSSE41(), SDL_HasAVX(), SDL_HasAVX2(), SDL_HasAVX512F(), SDL_HasNEON(),
+             SDL_GetCPUCount(), SDL_GetCPUCacheLineSize());
+}
+
+/**
+ * @brief Lê a tabela de AUTOTUNE_FILE.
+ * @return false se o arquivo não existe, foi feito para outra CPU ou está incompleto.
+ */
+bool autotune_load(KernelTable* table) {
+    FILE* f = fopen(AUTOTUNE_FILE, "r");
+    if (!f) return false;
+    char key[160], line[256];
+    autotune_cpu_key(key, sizeof(key));
+    bool key_ok = false;
+    int found = 0;
+    KernelTable loaded;
+    kernel_table_defaults(&loaded);
+    while (fgets(line, sizeof(line), f)) {
+        line[strcspn(line, "\r\n")] = '\0';
+        if (strncmp(line, "cpu=", 4) == 0) {
+            key_ok = strcmp(line + 4, key) == 0;
+        } else if (line[0] && line[0] != '#') {
+            if (!kernel_table_set(&loaded, line)) break;
+            found++;
+        }
+    }
+    fclose(f);
+    if (!key_ok || found != KERNEL_SLOT_COUNT) return false;
+    *table = loaded;
+    return true;
+}
+
+void autotune_save(const KernelTable* table) {
+    FILE* f = fopen(AUTOTUNE_FILE, "w");
+    if (!f) {
+        printf("Nao foi possivel gravar %s\n", AUTOTUNE_FILE);
+        return;
+    }
+    char key[160];
+    autotune_cpu_key(key, sizeof(key));
+    fprintf(f, "# Gerado pelo autotuner; apague para medir de novo\ncpu=%s\n", key);
+    for (int s = 0; s < KERNEL_SLOT_COUNT; ++s) {
+        fprintf(f, "%s=%s\n", KERNEL_SLOT_NAMES[s], KERNEL_CANDIDATE_NAMES[s][table->choice[s]]);
+    }
+    fclose(f);
+}
+
+/**
+ * @brief Gera uma estrela de 'points' pontas centrada em (cx, cy).
+ * @param out Precisa de espaço para 2 * points vértices.
+ */
+static void make_star(SDL_Point out[], int points, int cx, int cy, double r_outer, double r_inner) {
+    for (int i = 0; i < 2 * points; ++i) {
+        double a = M_PI * i / points;
+        double r = (i % 2) ? r_inner : r_outer;
+        out[i].x = cx + (int)round(r * cos(a));
+        out[i].y = cy + (int)round(r * sin(a));
+    }
+}
+
+// Entradas dos microbenchmarks, compartilhadas pelas candidatas de um slot
+typedef struct {
+    PixelTarget target;
+    SDL_Point* vertices;
+    int num_vertices;
+    float* xs;
+    float* ys;
+    SDL_Point* out;
+    int count;
+    size_t bytes;
+} AutotuneInput;
+
+typedef void (*AutotuneBody)(AutotuneInput* in, int candidate);
+
+static void autotune_span_body(AutotuneInput* in, int candidate) {
+    // Spans curtos, médios e da largura da tela, com começos desalinhados
+    FillSpan32Func fill = span_candidate(candidate, false);
+    static const int sizes[4] = { 5, 24, 120, SCREEN_WIDTH };
+    for (int y = 0; y < in->target.height; ++y) {
+        int count = sizes[y & 3];
+        int x0 = (y * 7) % (in->target.width - count + 1);
+        fill((Uint32*)(in->target.pixels + (size_t)y * in->target.pitch) + x0, count, 0xFF000000u | (Uint32)y);
+    }
+}
+
+static void autotune_transform_body(AutotuneInput* in, int candidate) {
+    Affine2D m = affine_multiply(affine_translate(320.5f, 240.25f), affine_rotate(0.3f));
+    transform_candidate(candidate)(&m, in->xs, in->ys, in->count, in->out);
+}
+
+static void autotune_fill_body(AutotuneInput* in, int candidate) {
+    fill_candidate(candidate)(NULL, in->vertices, in->num_vertices);
+}
+
+static void autotune_clear_body(AutotuneInput* in, int candidate) {
+    // candidate 0: gravações normais, 1: streaming
+    (candidate ? fill_span32_stream : fill_span32)((Uint32*)in->target.pixels, (int)(in->bytes / 4), 0xFF102030u);
+}
+
+/**
+ * @brief Segundos por chamada de body(in, candidate).
+ * Dobra as repetições até a medição passar de 2 ms e fica com a menor de
+ * cinco medições (a menos afetada por interrupções e troca de contexto).
+ */
+static double autotune_measure(AutotuneBody body, AutotuneInput* in, int candidate) {
+    double freq = (double)SDL_GetPerformanceFrequency();
+    int reps = 1;
+    double seconds;
+    body(in, candidate); // Aquece cache e preditores
+    while (1) {
+        Uint64 start = SDL_GetPerformanceCounter();
+        for (int r = 0; r < reps; ++r) body(in, candidate);
+        seconds = (double)(SDL_GetPerformanceCounter() - start) / freq;
+        if (seconds >= 0.002 || reps >= (1 << 20)) break;
+        reps *= 2;
+    }
+    double best = seconds / reps;
+    for (int k = 0; k < 4; ++k) {
+        Uint64 start = SDL_GetPerformanceCounter();
+        for (int r = 0; r < reps; ++r) body(in, candidate);
+        double t = (double)(SDL_GetPerformanceCounter() - start) / freq / reps;
+        if (t < best) best = t;
+    }
+    arena_reset(&frame_arena);
+    return best;
+}
+
+// Mede as candidatas disponíveis de um slot e devolve a mais rápida
+static int autotune_pick(KernelSlot slot, AutotuneBody body, AutotuneInput* in, bool verbose) {
+    int best = 0;
+    double best_time = 0.0;
+    if (verbose) printf("  %-12s", KERNEL_SLOT_NAMES[slot]);
+    for (int c = 0; c < KERNEL_MAX_CANDIDATES; ++c) {
+        if (!kernel_available(slot, c)) continue;
+        double t = autotune_measure(body, in, c);
+        if (verbose) printf(" %s %.2f us", KERNEL_CANDIDATE_NAMES[slot][c], t * 1e6);
+        if (c == 0 || t < best_time) {
+            best = c;
+            best_time = t;
+        }
+    }
+    if (verbose) printf(" -> %s\n", KERNEL_CANDIDATE_NAMES[slot][best]);
+    return best;
+}
+
+/**
+ * @brief Mede as candidatas de todos os slots nesta máquina.
+ * As candidatas de preenchimento que não derem os mesmos pixels que o
+ * scanline são descartadas.
+ * @return false se faltou memória (a tabela fica com os padrões).
+ */
+bool autotune_run(KernelTable* table, bool verbose) {
+    enum { TRANSFORM_COUNT = 4096 };
+    AutotuneInput in;
+    SDL_zero(in);
+    kernel_table_defaults(table);
+    // 4 MB de pixels para a maior classe de limpeza
+    bool ok = pixel_target_init(&in.target, PIXEL_ARGB8888, 1024, 1024, NULL, 0);
+    in.xs = (float*)SDL_SIMDAlloc(TRANSFORM_COUNT * sizeof(float));
+    in.ys = (float*)SDL_SIMDAlloc(TRANSFORM_COUNT * sizeof(float));
+    in.out = (SDL_Point*)SDL_malloc(TRANSFORM_COUNT * sizeof(SDL_Point));
+    PixelTarget reference;
+    ok = pixel_target_init(&reference, PIXEL_ARGB8888, SCREEN_WIDTH, SCREEN_HEIGHT, NULL, 0) && ok;
+    if (!ok || !in.xs || !in.ys || !in.out) {
+        printf("Falha ao alocar memoria para o autotuner.\n");
+        pixel_target_destroy(&in.target);
+        pixel_target_destroy(&reference);
+        SDL_SIMDFree(in.xs);
+        SDL_SIMDFree(in.ys);
+        SDL_free(in.out);
+        return false;
+    }
+    if (verbose) printf("autotuner (tempo por chamada):\n");
+
+    table->choice[KERNEL_SPAN] = autotune_pick(KERNEL_SPAN, autotune_span_body, &in, verbose);
+    kernel_table_apply(table); // A limpeza abaixo usa o span escolhido
+
+    for (int i = 0; i < TRANSFORM_COUNT; ++i) {
+        in.xs[i] = (float)(i % 640) - 320.0f;
+        in.ys[i] = (float)(i / 640) * 3.0f - 10.0f;
+    }
+    in.count = TRANSFORM_COUNT;
+    table->choice[KERNEL_TRANSFORM] = autotune_pick(KERNEL_TRANSFORM, autotune_transform_body, &in, verbose);
+
+    // Preenchimentos: uma estrela por classe, desenhada num destino de software
+    static const int star_points[FILL_CLASS_COUNT] = { 4, 32, 256 };
+    SDL_Point star[512];
+    PixelTarget* prev = raster_target;
+    for (int c = 0; c < FILL_CLASS_COUNT; ++c) {
+        make_star(star, star_points[c], SCREEN_WIDTH / 2, SCREEN_HEIGHT / 2, 230.0, 120.0 + c * 40.0);
+        in.vertices = star;
+        in.num_vertices = 2 * star_points[c];
+        raster_target = &in.target;
+        int pick = autotune_pick((KernelSlot)(KERNEL_FILL_SMALL + c), autotune_fill_body, &in, verbose);
+        if (pick != 0) {
+            // Só adota se der exatamente os pixels do scanline
+            reference.color = in.target.color = 0xFF000000u;
+            reference.writers->clear(&reference);
+            in.target.writers->clear(&in.target);
+            reference.color = in.target.color = 0xFFFFFFFFu;
+            raster_target = &reference;
+            fill_polygon_scanline(NULL, star, in.num_vertices);
+            raster_target = &in.target;
+            fill_candidate(pick)(NULL, star, in.num_vertices);
+            for (int y = 0; y < SCREEN_HEIGHT; ++y) {
+                if (memcmp(reference.pixels + (size_t)y * reference.pitch, in.target.pixels + (size_t)y * in.target.pitch,
+                           SCREEN_WIDTH * sizeof(Uint32)) != 0) {
+                    printf("  %s: %s difere do scanline, mantendo o scanline\n", KERNEL_SLOT_NAMES[KERNEL_FILL_SMALL + c],
+                           KERNEL_CANDIDATE_NAMES[KERNEL_FILL_SMALL + c][pick]);
+                    pick = 0;
+                    break;
+                }
+            }
+        }
+        table->choice[KERNEL_FILL_SMALL + c] = pick;
+    }
+    raster_target = prev;
+
+    // Limpeza: o menor tamanho a partir do qual o streaming ganha em todos os maiores
+    int clear_choice = 3;
+    for (int k = 2; k >= 0; --k) {
+        in.bytes = CLEAR_STREAM_SIZES[k];
+        double normal = autotune_measure(autotune_clear_body, &in, 0);
+        double stream = autotune_measure(autotune_clear_body, &in, 1);
+        if (verbose) {
+            printf("  %-12s %s: normal %.2f us, streaming %.2f us\n", KERNEL_SLOT_NAMES[KERNEL_CLEAR],
+                   KERNEL_CANDIDATE_NAMES[KERNEL_CLEAR][k], normal * 1e6, stream * 1e6);
+        }
+        if (stream >= normal) break;
+        clear_choice = k;
+    }
+    table->choice[KERNEL_CLEAR] = clear_choice;
+    if (verbose) printf("  %-12s -> %s\n", KERNEL_SLOT_NAMES[KERNEL_CLEAR], KERNEL_CANDIDATE_NAMES[KERNEL_CLEAR][clear_choice]);
+
+    pixel_target_destroy(&in.target);
+    pixel_target_destroy(&reference);
+    SDL_SIMDFree(in.xs);
+    SDL_SIMDFree(in.ys);
+    SDL_free(in.out);
+    return true;
+}
+
+typedef enum { AUTOTUNE_CACHED, AUTOTUNE_FORCE, AUTOTUNE_OFF } AutotuneMode;
+
+/**
+ * @brief Monta a tabela de kernels do início do programa e a instala.
+ * * @param mode AUTOTUNE_CACHED usa o arquivo se a CPU bate; AUTOTUNE_FORCE mede
+ * de novo; AUTOTUNE_OFF fica com os padrões.
+ * @param overrides Argumento de --kernels, ou NULL.
+ */
+void kernels_setup(AutotuneMode mode, const char* overrides) {
+    KernelTable table;
+    kernel_table_defaults(&table);
+    if (mode == AUTOTUNE_CACHED && autotune_load(&table)) {
+        printf("Kernels lidos de %s\n", AUTOTUNE_FILE);
+    } else if (mode != AUTOTUNE_OFF) {
+        if (autotune_run(&table, true)) autotune_save(&table);
+    }
+    if (overrides) kernel_table_override(&table, overrides);
+    kernel_table_apply(&table);
+    kernel_table_print(&table);
+}
+
+// --- Latência da entrada até a tela ---
+
+/*
+ * Mede quanto tempo uma entrada leva para aparecer. Cada evento de
+ * teclado ou mouse é datado pelo seu timestamp (SDL_GetTicks() de quando
+ * o SDL o recebeu), convertido para o contador de alta resolução no
+ * momento em que sai da fila. O quadro que trata a entrada mais antiga
+ * ainda não apresentada registra três trechos: da entrada ao início da
+ * rasterização, a rasterização e do fim dela até SDL_RenderPresent
+ * retornar. Os percentis são calculados numa janela das últimas
+ * LATENCY_WINDOW amostras. No modo 14 a imagem vem da thread de
+ * renderização, que pode apresentar um quadro anterior à entrada.
+ */
+enum { LATENCY_WINDOW = 256 };
+
+typedef enum {
+    LATENCY_TO_RASTER,  // Da entrada ao início da rasterização
+    LATENCY_RASTER,     // Rasterização do quadro
+    LATENCY_TO_PRESENT, // Do fim da rasterização ao retorno de SDL_RenderPresent
+    LATENCY_TOTAL,
+    LATENCY_STAGE_COUNT
+} LatencyStage;
+
+static const char* const LATENCY_STAGE_NAMES[LATENCY_STAGE_COUNT] = { "entrada->raster", "raster", "raster->present", "total" };
+
+typedef struct {
+    double ms[LATENCY_STAGE_COUNT][LATENCY_WINDOW];
+    int count;            // Amostras na janela
+    int next;             // Próxima posição do anel
+    Uint64 total_samples;
+    Uint64 pending_input; // Contador da entrada mais antiga ainda não apresentada (0 = nenhuma)
+} LatencyTracker;
+
+// Valor no percentil p (0..100) de um vetor já ordenado
+static double percentile_sorted(const double* sorted, int count, double p) {
+    if (count == 0) return 0.0;
+    int i = (int)ceil(p / 100.0 * count) - 1;
+    return sorted[SDL_clamp(i, 0, count - 1)];
+}
+
+/**
+ * @brief Anota um evento que acabou de sair da fila.
+ * Só teclado e mouse contam como entrada.
+ */
+void latency_note_event(LatencyTracker* lt, const SDL_Event* e) {
+    switch (e->type) {
+        case SDL_KEYDOWN:
+        case SDL_KEYUP:
+        case SDL_MOUSEMOTION:
+        case SDL_MOUSEBUTTONDOWN:
+        case SDL_MOUSEBUTTONUP:
+        case SDL_MOUSEWHEEL:
+            break;
+        default:
+            return;
+    }
+    // O timestamp do evento está em ms (é o que o SDL2 oferece): a idade dele
+    // leva para o contador, com até 1 ms de erro no trecho entrada->raster
+    Uint64 now = SDL_GetPerformanceCounter();
+    Uint32 ticks = SDL_GetTicks();
+    Uint32 age_ms = SDL_TICKS_PASSED(ticks, e->common.timestamp) ? ticks - e->common.timestamp : 0;
+    Uint64 age = (Uint64)age_ms * SDL_GetPerformanceFrequency() / 1000;
+    Uint64 input = age < now ? now - age : 1;
+    if (lt->pending_input == 0 || input < lt->pending_input) lt->pending_input = input;
+}
+
+/**
+ * @brief Fecha o quadro: se ele tratou alguma entrada, guarda uma amostra.
+ */
+void latency_frame(LatencyTracker* lt, Uint64 raster_start, Uint64 raster_end, Uint64 present_end) {
+    if (lt->pending_input == 0) return;
+    double to_ms = 1000.0 / (double)SDL_GetPerformanceFrequency();
+    Uint64 input = SDL_min(lt->pending_input, raster_start);
+    lt->ms[LATENCY_TO_RASTER][lt->next] = (double)(raster_start - input) * to_ms;
+    lt->ms[LATENCY_RASTER][lt->next] = (double)(raster_end - raster_start) * to_ms;
+    lt->ms[LATENCY_TO_PRESENT][lt->next] = (double)(present_end - raster_end) * to_ms;
+    lt->ms[LATENCY_TOTAL][lt->next] = (double)(present_end - input) * to_ms;
+    lt->next = (lt->next + 1) % LATENCY_WINDOW;
+    if (lt->count < LATENCY_WINDOW) lt->count++;
+    lt->total_samples++;
+    lt->pending_input = 0;
+}
+
+/**
+ * @brief Percentis de um trecho na janela atual.
+ * * @param out p50, p95, p99 e máximo, em ms.
+ */
+void latency_percentiles(const LatencyTracker* lt, LatencyStage stage, double out[4]) {
+    double sorted[LATENCY_WINDOW];
+    SDL_memcpy(sorted, lt->ms[stage], lt->count * sizeof(double));
+    qsort(sorted, lt->count, sizeof(double), compare_doubles);
+    out[0] = percentile_sorted(sorted, lt->count, 50.0);
+    out[1] = percentile_sorted(sorted, lt->count, 95.0);
+    out[2] = percentile_sorted(sorted, lt->count, 99.0);
+    out[3] = lt->count ? sorted[lt->count - 1] : 0.0;
+}
+
+void latency_print(const LatencyTracker* lt) {
+    printf("Latencia entrada->tela (ultimas %d de %llu amostras):\n", lt->count, (unsigned long long)lt->total_samples);
+    for (int s = 0; s < LATENCY_STAGE_COUNT; ++s) {
+        double p[4];
+        latency_percentiles(lt, (LatencyStage)s, p);
+        printf("  %-16s p50 %7.3f  p95 %7.3f  p99 %7.3f  max %7.3f ms\n", LATENCY_STAGE_NAMES[s], p[0], p[1], p[2], p[3]);
+    }
+}
+
+// --- Estatísticas do quadro (F1) ---
+
+// Números coletados a cada quadro e mostrados no overlay
+typedef struct {
+    double frame_ms;        // Tempo de CPU do último quadro (eventos + desenho)
+    size_t arena_used;      // Bytes da arena usados no último quadro
+    size_t arena_high;      // Pico de uso da arena
+    size_t arena_capacity;  // Tamanho reservado pela arena
+    int alloc_delta;        // Variação de SDL_GetNumAllocations() no quadro
+    int shapes_visible;     // Formas que passaram pelo recorte de visão (modo 6)
+    int shapes_total;       // Formas na cena (modo 6)
+    int cache_rebuilds;     // Formas retidas rasterizadas de novo no quadro
+    Uint64 pixels_written;  // Pixels escritos pelos rasterizadores no quadro
+    bool mesh_test;         // Modo 13: mostrar a contagem da malha
+    int mesh_doubles;       // Pixels da malha escritos mais de uma vez
+    int mesh_holes;         // Pixels da janela que a malha não escreveu
+    bool render_thread;     // Modo 14: mostrar os números da thread
+    double render_ms;       // Tempo do último quadro na thread de renderização
+    double render_latency_ms; // Da entrega da lista até o quadro pronto
+    int render_dropped;     // Listas descartadas porque a thread estava atrasada
+    int latency_samples;    // Amostras de latência na janela
+    double latency_p50;     // Entrada -> SDL_RenderPresent, em ms
+    double latency_p95;
+    double latency_p99;
+} FrameStats;
+
+/**
+ * @brief Desenha o overlay de estatísticas no canto superior esquerdo.
+ */
+void draw_stats_overlay(SDL_Renderer* renderer, const FrameStats* stats) {
+    char line[96];
+    int y = 4;
+
+    SDL_SetRenderDrawColor(renderer, 255, 255, 255, 255);
+    snprintf(line, sizeof(line), "quadro: %.2f ms", stats->frame_ms);
+    SDLTest_DrawString(renderer, 4, y, line);
+    y += FONT_LINE_HEIGHT;
+    snprintf(line, sizeof(line), "arena: %zu B (pico %zu B / %zu B)",
+             stats->arena_used, stats->arena_high, stats->arena_capacity);
+    SDLTest_DrawString(renderer, 4, y, line);
+    y += FONT_LINE_HEIGHT;
+    snprintf(line, sizeof(line), "alocacoes/quadro: %+d", stats->alloc_delta);
+    SDLTest_DrawString(renderer, 4, y, line);
+    y += FONT_LINE_HEIGHT;
+    snprintf(line, sizeof(line), "caches refeitos: %d", stats->cache_rebuilds);
+    SDLTest_DrawString(renderer, 4, y, line);
+    y += FONT_LINE_HEIGHT;
+    snprintf(line, sizeof(line), "pixels escritos: %llu", (unsigned long long)stats->pixels_written);
+    SDLTest_DrawString(renderer, 4, y, line);
+    if (stats->latency_samples > 0) {
+        y += FONT_LINE_HEIGHT;
+        snprintf(line, sizeof(line), "entrada->tela: p50 %.1f p95 %.1f p99 %.1f ms (%d)",
+                 stats->latency_p50, stats->latency_p95, stats->latency_p99, stats->latency_samples);
+        SDLTest_DrawString(renderer, 4, y, line);
+    }
+    if (stats->shapes_total > 0) {
+        y += FONT_LINE_HEIGHT;
+        snprintf(line, sizeof(line), "formas visiveis: %d / %d", stats->shapes_visible, stats->shapes_total);
+        SDLTest_DrawString(renderer, 4, y, line);
+    }
+    if (stats->mesh_test) {
+        y += FONT_LINE_HEIGHT;
+        snprintf(line, sizeof(line), "malha: %d pixels escritos 2x, %d buracos", stats->mesh_doubles, stats->mesh_holes);
+        SDLTest_DrawString(renderer, 4, y, line);
+    }
+    if (stats->render_thread) {
+        y += FONT_LINE_HEIGHT;
+        snprintf(line, sizeof(line), "thread: %.2f ms/quadro, atraso %.2f ms, %d listas descartadas",
+                 stats->render_ms, stats->render_latency_ms, stats->render_dropped);
+        SDLTest_DrawString(renderer, 4, y, line);
+    }
+    if (perf_enabled) {
+        // Estágios que rodaram no último quadro (--perf)
+        for (int s = 0; s < PERF_STAGE_COUNT; ++s) {
+            if (perf_last_frame.stage[s].calls == 0) continue;
+            y += FONT_LINE_HEIGHT;
+            perf_format_stage(line, sizeof(line), &perf_last_frame, (PerfStage)s);
+            SDLTest_DrawString(renderer, 4, y, line);
+        }
+    }
+}
+
+// --- Gravação e reprodução de entrada (--record / --replay) ---
+
+/*
+ * Para uma sessão interativa virar um teste de carga repetível, --record
+ * grava num arquivo binário compacto cada evento de entrada, marcando o
+ * início de cada quadro com o relógio das animações. --replay lê o
+ * arquivo e devolve os eventos de cada quadro com SDL_PushEvent, no ritmo
+ * gravado ou o mais rápido possível (--replay-max). O relógio das
+ * animações (demo_ticks) fica fixo em cada quadro e, na reprodução, vem
+ * da gravação, então os mesmos quadros são desenhados nas duas
+ * velocidades. No fim, imprime um histograma do
+ * tempo de quadro.
+ *
+ * Formato: "CGEV", LE32 versão e registros de um byte de tipo seguido dos
+ * campos em little-endian.
+ */
+enum { INPUT_LOG_VERSION = 1 };
+static const char INPUT_LOG_MAGIC[4] = { 'C', 'G', 'E', 'V' };
+
+typedef enum {
+    INPUT_FRAME = 1, // LE32 ms (relógio das animações)
+    INPUT_KEY,       // U8 pressionada, U8 repetição, LE32 sym, LE16 mod
+    INPUT_MOTION,    // LE16 x, y, xrel, yrel (com sinal), LE32 botões
+    INPUT_BUTTON,    // U8 pressionado, U8 botão, U8 cliques, LE16 x, y
+    INPUT_WHEEL,     // LE32 x, y (com sinal)
+    INPUT_WINDOW,    // U8 evento, LE32 data1, data2
+    INPUT_QUIT
+} InputRecordKind;
+
+typedef struct {
+    SDL_RWops* file;
+    bool replay;
+    bool max_speed;     // Reprodução sem esperar os tempos gravados
+    bool started;
+    Uint32 first_clock; // Relógio do primeiro quadro gravado
+    Uint32 wall_start;  // SDL_GetTicks() no primeiro quadro reproduzido
+    Uint8 pending;      // Tipo do próximo registro, já lido (0 = nenhum)
+    bool finished;      // A reprodução chegou ao fim do arquivo
+    int frames;
+    int events;
+} InputLog;
+
+// Relógio das animações; na reprodução vem do arquivo, para os quadros saírem iguais
+bool demo_clock_fixed = false;
+Uint32 demo_clock_ms = 0;
+
+static inline Uint32 demo_ticks(void) {
+    return demo_clock_fixed ? demo_clock_ms : SDL_GetTicks();
+}
+
+/**
+ * @brief Abre o arquivo para gravar ou reproduzir.
+ * @return false se não deu para abrir ou o arquivo não é uma gravação válida.
+ */
+bool input_log_open(InputLog* log, const char* path, bool replay, bool max_speed) {
+    SDL_zerop(log);
+    SDL_RWops* file = SDL_RWFromFile(path, replay ? "rb" : "wb");
+    if (!file) {
+        printf("Nao foi possivel abrir %s: %s\n", path, SDL_GetError());
+        return false;
+    }
+    if (replay) {
+        char magic[4];
+        if (SDL_RWread(file, magic, 1, 4) != 4 || memcmp(magic, INPUT_LOG_MAGIC, 4) != 0 ||
+            SDL_ReadLE32(file) != INPUT_LOG_VERSION) {
+            printf("%s nao e uma gravacao de entrada valida.\n", path);
+            SDL_RWclose(file);
+            return false;
+        }
+    } else if (SDL_RWwrite(file, INPUT_LOG_MAGIC, 1, 4) != 4 || !SDL_WriteLE32(file, INPUT_LOG_VERSION)) {
+        printf("Nao foi possivel gravar em %s: %s\n", path, SDL_GetError());
+        SDL_RWclose(file);
+        return false;
+    }
+    // Só um log aberto com sucesso fica marcado como gravação/reprodução
+    log->file = file;
+    log->replay = replay;
+    log->max_speed = max_speed;
+    // Um relógio por quadro também na gravação: gravação e reprodução desenham o mesmo
+    demo_clock_fixed = true;
+    return true;
+}
+
+void input_log_close(InputLog* log) {
+    if (log->file) SDL_RWclose(log->file);
+    log->file = NULL;
+    demo_clock_fixed = false;
+}
+
+/**
+ * @brief Grava um evento de entrada (só no modo de gravação).
+ */
+void input_log_event(InputLog* log, const SDL_Event* e) {
+    if (!log->file || log->replay) return;
+    SDL_RWops* f = log->file;
+    switch (e->type) {
+        case SDL_KEYDOWN:
+        case SDL_KEYUP:
+            SDL_WriteU8(f, INPUT_KEY);
+            SDL_WriteU8(f, e->type == SDL_KEYDOWN);
+            SDL_WriteU8(f, e->key.repeat);
+            SDL_WriteLE32(f, (Uint32)e->key.keysym.sym);
+            SDL_WriteLE16(f, e->key.keysym.mod);
+            break;
+        case SDL_MOUSEMOTION:
+            SDL_WriteU8(f, INPUT_MOTION);
+            SDL_WriteLE16(f, (Uint16)e->motion.x);
+            SDL_WriteLE16(f, (Uint16)e->motion.y);
+            SDL_WriteLE16(f, (Uint16)e->motion.xrel);
+            SDL_WriteLE16(f, (Uint16)e->motion.yrel);
+            SDL_WriteLE32(f, e->motion.state);
+            break;
+        case SDL_MOUSEBUTTONDOWN:
+        case SDL_MOUSEBUTTONUP:
+            SDL_WriteU8(f, INPUT_BUTTON);
+            SDL_WriteU8(f, e->type == SDL_MOUSEBUTTONDOWN);
+            SDL_WriteU8(f, e->button.button);
+            SDL_WriteU8(f, e->button.clicks);
+            SDL_WriteLE16(f, (Uint16)e->button.x);
+            SDL_WriteLE16(f, (Uint16)e->button.y);
+            break;
+        case SDL_MOUSEWHEEL:
+            SDL_WriteU8(f, INPUT_WHEEL);
+            SDL_WriteLE32(f, (Uint32)e->wheel.x);
+            SDL_WriteLE32(f, (Uint32)e->wheel.y);
+            break;
+        case SDL_WINDOWEVENT:
+            SDL_WriteU8(f, INPUT_WINDOW);
+            SDL_WriteU8(f, e->window.event);
+            SDL_WriteLE32(f, (Uint32)e->window.data1);
+            SDL_WriteLE32(f, (Uint32)e->window.data2);
+            break;
+        case SDL_QUIT:
+            SDL_WriteU8(f, INPUT_QUIT);
+            break;
+        default:
+            return; // Eventos do renderer e afins não são entrada
+    }
+    log->events++;
+}
+
+// Lê um registro de evento (o tipo já foi lido) e o põe na fila do SDL
+static void input_log_push(InputLog* log, Uint8 kind, Uint32 window_id) {
+    SDL_RWops* f = log->file;
+    SDL_Event e;
+    SDL_zero(e);
+    switch (kind) {
+        case INPUT_KEY: {
+            bool down = SDL_ReadU8(f);
+            e.type = down ? SDL_KEYDOWN : SDL_KEYUP;
+            e.key.state = down ? SDL_PRESSED : SDL_RELEASED;
+            e.key.repeat = SDL_ReadU8(f);
+            e.key.keysym.sym = (SDL_Keycode)SDL_ReadLE32(f);
+            e.key.keysym.scancode = SDL_GetScancodeFromKey(e.key.keysym.sym);
+            e.key.keysym.mod = SDL_ReadLE16(f);
+            e.key.windowID = window_id;
+            break;
+        }
+        case INPUT_MOTION:
+            e.type = SDL_MOUSEMOTION;
+            e.motion.x = (Sint16)SDL_ReadLE16(f);
+            e.motion.y = (Sint16)SDL_ReadLE16(f);
+            e.motion.xrel = (Sint16)SDL_ReadLE16(f);
+            e.motion.yrel = (Sint16)SDL_ReadLE16(f);
+            e.motion.state = SDL_ReadLE32(f);
+            e.motion.windowID = window_id;
+            break;
+        case INPUT_BUTTON: {
+            bool down = SDL_ReadU8(f);
+            e.type = down ? SDL_MOUSEBUTTONDOWN : SDL_MOUSEBUTTONUP;
+            e.button.state = down ? SDL_PRESSED : SDL_RELEASED;
+            e.button.button = SDL_ReadU8(f);
+            e.button.clicks = SDL_ReadU8(f);
+            e.button.x = (Sint16)SDL_ReadLE16(f);
+            e.button.y = (Sint16)SDL_ReadLE16(f);
+            e.button.windowID = window_id;
+            break;
+        }
+        case INPUT_WHEEL:
+            e.type = SDL_MOUSEWHEEL;
+            e.wheel.x = (Sint32)SDL_ReadLE32(f);
+            e.wheel.y = (Sint32)SDL_ReadLE32(f);
+            e.wheel.windowID = window_id;
+            break;
+        case INPUT_WINDOW:
+            e.type = SDL_WINDOWEVENT;
+            e.window.event = SDL_ReadU8(f);
+            e.window.data1 = (Sint32)SDL_ReadLE32(f);
+            e.window.data2 = (Sint32)SDL_ReadLE32(f);
+            e.window.windowID = window_id;
+            break;
+        case INPUT_QUIT:
+            e.type = SDL_QUIT;
+            break;
+        default:
+            printf("Registro de entrada desconhecido (%d); reproducao interrompida.\n", kind);
+            log->finished = true;
+            return;
+    }
+    SDL_PushEvent(&e);
+    log->events++;
+}
+
+/**
+ * @brief Marca o início de um quadro.
+ * Na gravação, escreve o relógio do quadro. Na reprodução, espera até o
+ * tempo gravado (a não ser em --replay-max), fixa o relógio das animações
+ * e põe na fila os eventos daquele quadro no lugar da entrada real.
+ */
+void input_log_frame(InputLog* log, Uint32 window_id) {
+    if (!log->file) return;
+    SDL_RWops* f = log->file;
+    log->frames++;
+    if (!log->replay) {
+        demo_clock_ms = SDL_GetTicks();
+        SDL_WriteU8(f, INPUT_FRAME);
+        SDL_WriteLE32(f, demo_clock_ms);
+        return;
+    }
+
+    Uint8 kind = log->pending;
+    log->pending = 0;
+    if (kind == 0 && SDL_RWread(f, &kind, 1, 1) != 1) kind = 0;
+    if (kind != INPUT_FRAME) {
+        log->finished = true;
+        return;
+    }
+    Uint32 clock = SDL_ReadLE32(f);
+    if (!log->started) {
+        log->started = true;
+        log->first_clock = clock;
+        log->wall_start = SDL_GetTicks();
+    }
+    if (!log->max_speed) {
+        Uint32 elapsed = SDL_GetTicks() - log->wall_start;
+        Uint32 target = clock - log->first_clock;
+        if (target > elapsed) SDL_Delay(target - elapsed);
+    }
+    demo_clock_ms = clock;
+
+    // Só a entrada gravada conta (fechar a janela continua funcionando)
+    SDL_FlushEvents(SDL_KEYDOWN, SDL_MOUSEWHEEL);
+    while (SDL_RWread(f, &kind, 1, 1) == 1) {
+        if (kind == INPUT_FRAME) {
+            log->pending = kind;
+            break;
+        }
+        input_log_push(log, kind, window_id);
+        if (log->finished) break;
+    }
+}
+
+// Tempos de quadro de uma execução, para o histograma do fim
+typedef struct {
+    double* ms;
+    int count;
+    int capacity;
+} FrameTimes;
+
+void frame_times_add(FrameTimes* ft, double ms) {
+    if (ft->count == ft->capacity) {
+        int capacity = ft->capacity ? ft->capacity * 2 : 1024;
+        double* grown = (double*)SDL_realloc(ft->ms, capacity * sizeof(double));
+        if (!grown) return;
+        ft->ms = grown;
+        ft->capacity = capacity;
+    }
+    ft->ms[ft->count++] = ms;
+}
+
+/**
+ * @brief Imprime o histograma dos tempos de quadro (faixas em potências de 2 ms)
+ * e os percentis principais.
+ */
+void frame_times_print_histogram(FrameTimes* ft) {
+    static const double edges[] = { 1, 2, 4, 8, 16, 32, 64, 128 };
+    enum { NUM_EDGES = sizeof(edges) / sizeof(edges[0]), BAR_WIDTH = 40 };
+    if (ft->count == 0) {
+        printf("Nenhum quadro medido.\n");
+        return;
+    }
+    qsort(ft->ms, ft->count, sizeof(double), compare_doubles);
+    int buckets[NUM_EDGES + 1] = { 0 };
+    double total = 0.0;
+    for (int i = 0; i < ft->count; ++i) {
+        int b = 0;
+        while (b < NUM_EDGES && ft->ms[i] >= edges[b]) b++;
+        buckets[b]++;
+        total += ft->ms[i];
+    }
+    int largest = 1;
+    for (int b = 0; b <= NUM_EDGES; ++b) largest = SDL_max(largest, buckets[b]);
+
+    printf("\nTempo de quadro (%d quadros):\n", ft->count);
+    for (int b = 0; b <= NUM_EDGES; ++b) {
+        char range[32];
+        if (b == 0) snprintf(range, sizeof(range), "< %g ms", edges[0]);
+        else if (b == NUM_EDGES) snprintf(range, sizeof(range), ">= %g ms", edges[NUM_EDGES - 1]);
+        else snprintf(range, sizeof(range), "%g-%g ms", edges[b - 1], edges[b]);
+        char bar[BAR_WIDTH + 1];
+        int len = (int)((double)buckets[b] * BAR_WIDTH / largest + 0.5);
+        SDL_memset(bar, '#', len);
+        bar[len] = '\0';
+        printf("  %-12s %6d %5.1f%% %s\n", range, buckets[b], 100.0 * buckets[b] / ft->count, bar);
+    }
+    printf("  min %.3f, media %.3f, p50 %.3f, p95 %.3f, p99 %.3f, max %.3f ms\n",
+           ft->ms[0], total / ft->count, percentile_sorted(ft->ms, ft->count, 50.0),
+           percentile_sorted(ft->ms, ft->count, 95.0), percentile_sorted(ft->ms, ft->count, 99.0), ft->ms[ft->count - 1]);
+}
+
+// --- Benchmark (modo --bench) ---
+
+// Quantas vezes cada preenchimento é repetido por medição
+const int BENCH_ITERATIONS = 2000;
+
+/**
+ * @brief Mede o tempo médio (em microssegundos) de uma função de preenchimento.
+ */
+static double bench_fill(SDL_Renderer* renderer, FillFunc fill, SDL_Point vertices[], int num_vertices) {
+    Uint64 start = SDL_GetPerformanceCounter();
+    for (int i = 0; i < BENCH_ITERATIONS; ++i) {
+        fill(renderer, vertices, num_vertices);
+        arena_reset(&frame_arena);
+    }
+    Uint64 end = SDL_GetPerformanceCounter();
+    return (double)(end - start) * 1e6 / (double)SDL_GetPerformanceFrequency() / BENCH_ITERATIONS;
+}
+
+/**
+ * @brief Mede fill_span32 (escalar contra a variante escolhida) em spans de
+ * vários tamanhos e a limpeza do quadro com e sem gravações não temporais.
+ * @return 1 se alguma variante escreveu algo diferente da escalar.
+ */
+static int bench_span_kernels(void) {
+    Framebuffer fb[2];
+    bool ok = framebuffer_init(&fb[0], NULL, SCREEN_WIDTH, SCREEN_HEIGHT);
+    ok = framebuffer_init(&fb[1], NULL, SCREEN_WIDTH, SCREEN_HEIGHT) && ok;
+    if (!ok) {
+        printf("Falha ao alocar o framebuffer.\n");
+        framebuffer_destroy(&fb[0]);
+        framebuffer_destroy(&fb[1]);
+        return 1;
+    }
+    const char* variant = fill_span32_init();
+    const int sizes[] = { 3, 16, 100, SCREEN_WIDTH };
+    const int rounds = 200;
+    double freq = (double)SDL_GetPerformanceFrequency();
+    int status = 0;
+
+    printf("\nspans de 32 bits (%s):\n", variant);
+    for (int s = 0; s < 4; ++s) {
+        double ns[2];
+        for (int v = 0; v < 2; ++v) {
+            FillSpan32Func fill = v == 0 ? fill_span32_scalar : fill_span32;
+            Uint64 start = SDL_GetPerformanceCounter();
+            for (int r = 0; r < rounds; ++r) {
+                // Começos desalinhados de propósito
+                for (int y = 0; y < SCREEN_HEIGHT; ++y) {
+                    int x0 = (y * 7) % (SCREEN_WIDTH - sizes[s] + 1);
+                    fill(fb[v].pixels + (size_t)y * fb[v].pitch + x0, sizes[s], 0xFF000000u | (Uint32)(r * 31 + y));
+                }
+            }
+            ns[v] = (double)(SDL_GetPerformanceCounter() - start) * 1e9 / freq / ((double)rounds * SCREEN_HEIGHT);
+        }
+        printf("  %4d pixels: escalar %.2f ns/span, %s %.2f ns/span (%.2fx)\n", sizes[s], ns[0], variant, ns[1], ns[0] / ns[1]);
+        if (memcmp(fb[0].pixels, fb[1].pixels, (size_t)fb[0].pitch * SCREEN_HEIGHT * sizeof(Uint32)) != 0) {
+            printf("  ERRO: a variante %s difere da escalar\n", variant);
+            status = 1;
+        }
+    }
+
+    double us[2];
+    size_t count = (size_t)fb[0].pitch * SCREEN_HEIGHT;
+    for (int v = 0; v < 2; ++v) {
+        FillSpan32Func fill = v == 0 ? fill_span32 : fill_span32_stream;
+        Uint64 start = SDL_GetPerformanceCounter();
+        for (int r = 0; r < rounds; ++r) fill(fb[v].pixels, (int)count, 0xFF102030u + r);
+        us[v] = (double)(SDL_GetPerformanceCounter() - start) * 1e6 / freq / rounds;
+    }
+    printf("  limpeza de %dx%d: normal %.2f us, streaming %.2f us (%.2f GB/s)\n", SCREEN_WIDTH, SCREEN_HEIGHT,
+           us[0], us[1], (double)count * sizeof(Uint32) / (us[1] * 1e3));
+    if (memcmp(fb[0].pixels, fb[1].pixels, count * sizeof(Uint32)) != 0) {
+        printf("  ERRO: a limpeza com streaming difere da normal\n");
+        status = 1;
+    }
+
+    framebuffer_destroy(&fb[0]);
+    framebuffer_destroy(&fb[1]);
+    return status;
+}
+
+/**
+ * @brief Converte um destino ARGB8888 para o formato de 'dst', pixel a pixel,
+ * com a mesma conversão de cor usada ao desenhar direto no formato.
+ */
+static void pixel_target_convert_argb(const PixelTarget* src, PixelTarget* dst) {
+    Uint32 last_argb = 0;
+    Uint32 last_native = 0;
+    bool have_last = false;
+    for (int y = 0; y < src->height; ++y) {
+        const Uint32* in = (const Uint32*)(src->pixels + (size_t)y * src->pitch);
+        for (int x = 0; x < src->width; ++x) {
+            if (!have_last || in[x] != last_argb) {
+                // A cena tem poucas cores: a busca na paleta só roda quando a cor muda
+                SDL_Color c = { (Uint8)(in[x] >> 16), (Uint8)(in[x] >> 8), (Uint8)in[x], (Uint8)(in[x] >> 24) };
+                last_argb = in[x];
+                last_native = pixel_target_map(dst, c);
+                have_last = true;
+            }
+            dst->color = last_native;
+            dst->writers->point(dst, x, y);
+        }
+    }
+}
+
+/**
+ * @brief Desenha a mesma cena direto em cada formato e compara com desenhar
+ * em ARGB8888 e converter depois.
+ * @return 1 se algum formato difere da conversão do quadro de 32 bits.
+ */
+static int bench_pixel_formats(void) {
+    const int rounds = 200;
+    PixelTarget targets[PIXEL_FORMAT_COUNT];
+    PixelTarget converted;
+    bool ok = true;
+    for (int f = 0; f < PIXEL_FORMAT_COUNT; ++f) {
+        ok = pixel_target_init(&targets[f], (PixelFormatKind)f, SCREEN_WIDTH, SCREEN_HEIGHT, palette_332, 256) && ok;
+    }
+    if (!ok) {
+        printf("Falha ao alocar os destinos de pixel.\n");
+        for (int f = 0; f < PIXEL_FORMAT_COUNT; ++f) pixel_target_destroy(&targets[f]);
+        return 1;
+    }
+    double freq = (double)SDL_GetPerformanceFrequency();
+    int status = 0;
+    double us[PIXEL_FORMAT_COUNT];
+
+    printf("\nformatos de pixel (%d poligonos + retas, %dx%d):\n", OVERLAP_NUM_POLYGONS, SCREEN_WIDTH, SCREEN_HEIGHT);
+    for (int f = 0; f < PIXEL_FORMAT_COUNT; ++f) {
+        Uint64 start = SDL_GetPerformanceCounter();
+        for (int r = 0; r < rounds; ++r) {
+            draw_pixel_format_scene(&targets[f], 1.0f, 0.3f);
+            arena_reset(&frame_arena);
+        }
+        us[f] = (double)(SDL_GetPerformanceCounter() - start) * 1e6 / freq / rounds;
+        printf("  %-8s %8.2f us/quadro, %7.1f KB por quadro\n", PIXEL_FORMAT_NAMES[f], us[f],
+               (double)targets[f].pitch * targets[f].height / 1024.0);
+    }
+
+    // Cada formato tem que dar os mesmos pixels que o quadro ARGB convertido
+    for (int f = PIXEL_RGB565; f < PIXEL_FORMAT_COUNT; ++f) {
+        if (!pixel_target_init(&converted, (PixelFormatKind)f, SCREEN_WIDTH, SCREEN_HEIGHT, palette_332, 256)) {
+            status = 1;
+            break;
+        }
+        Uint64 start = SDL_GetPerformanceCounter();
+        pixel_target_convert_argb(&targets[PIXEL_ARGB8888], &converted);
+        double convert_us = (double)(SDL_GetPerformanceCounter() - start) * 1e6 / freq;
+        int row_bytes = f == PIXEL_RGB565 ? SCREEN_WIDTH * 2 : f == PIXEL_INDEX8 ? SCREEN_WIDTH : (SCREEN_WIDTH + 7) / 8;
+        for (int y = 0; y < SCREEN_HEIGHT; ++y) {
+            if (memcmp(targets[f].pixels + (size_t)y * targets[f].pitch, converted.pixels + (size_t)y * converted.pitch, row_bytes) != 0) {
+                printf("  ERRO: %s direto difere do ARGB8888 convertido (linha %d)\n", PIXEL_FORMAT_NAMES[f], y);
+                status = 1;
+                break;
+            }
+        }
+        if (f == PIXEL_RGB565) {
+            printf("  ARGB8888 + conversao para RGB565: %.2f us/quadro (direto %.2fx mais rapido)\n",
+                   us[PIXEL_ARGB8888] + convert_us, (us[PIXEL_ARGB8888] + convert_us) / us[PIXEL_RGB565]);
+        }
+        pixel_target_destroy(&converted);
+    }
+
+    for (int f = 0; f < PIXEL_FORMAT_COUNT; ++f) pixel_target_destroy(&targets[f]);
+    return status;
+}
+
+/**
+ * @brief Compara a transformação escalar com a variante SIMD escolhida.
+ */
+static int bench_transform(void) {
+    const int count = 1 << 20;
+    const int rounds = 20;
+    VertexSoA soa = { 0 };
+    SDL_Point* out_scalar = (SDL_Point*)SDL_malloc(count * sizeof(SDL_Point));
+    SDL_Point* out_simd = (SDL_Point*)SDL_malloc(count * sizeof(SDL_Point));
+    soa.x = (float*)SDL_SIMDAlloc(count * sizeof(float));
+    soa.y = (float*)SDL_SIMDAlloc(count * sizeof(float));
+    soa.count = count;
+    int status = 0;
+
+    if (!out_scalar || !out_simd || !soa.x || !soa.y) {
+        printf("Falha ao alocar memoria para o benchmark de transformacao.\n");
+        status = 1;
+    } else {
+        for (int i = 0; i < count; ++i) {
+            soa.x[i] = (float)(rand() % 4096 - 2048);
+            soa.y[i] = (float)(rand() % 4096 - 2048);
+        }
+        Affine2D m = affine_multiply(affine_translate(320.5f, 240.25f),
+                                     affine_multiply(affine_rotate(0.3f), affine_scale(1.7f, 0.8f)));
+        const char* variant = transform_init();
+
+        Uint64 t0 = SDL_GetPerformanceCounter();
+        for (int r = 0; r < rounds; ++r) transform_points_scalar(&m, soa.x, soa.y, count, out_scalar);
+        Uint64 t1 = SDL_GetPerformanceCounter();
+        for (int r = 0; r < rounds; ++r) transform_points(&m, soa.x, soa.y, count, out_simd);
+        Uint64 t2 = SDL_GetPerformanceCounter();
+
+        double freq = (double)SDL_GetPerformanceFrequency();
+        double ns_scalar = (double)(t1 - t0) * 1e9 / freq / ((double)count * rounds);
+        double ns_simd = (double)(t2 - t1) * 1e9 / freq / ((double)count * rounds);
+        printf("\ntransformacao de %d vertices: escalar %.3f ns/vertice, %s %.3f ns/vertice (%.2fx)\n",
+               count, ns_scalar, variant, ns_simd, ns_scalar / ns_simd);
+        if (memcmp(out_scalar, out_simd, count * sizeof(SDL_Point)) != 0) {
+            printf("  ERRO: a variante %s difere da escalar\n", variant);
+            status = 1;
+        }
+    }
+
+    SDL_free(out_scalar);
+    SDL_free(out_simd);
+    soa_destroy(&soa);
+    return status;
+}
+
+/**
+ * @brief Compara redesenhar os modos estáticos a cada quadro com apresentar
+ * a textura pré-renderizada deles.
+ */
+static int bench_mode_textures(SDL_Renderer* renderer) {
+    const int frames = 500;
+    DemoShapes demo;
+    ModeTextures mt = { { NULL }, { 0 }, 0, 0, true };
+    int rebuilds = 0;
+    int status = 0;
+    double freq = (double)SDL_GetPerformanceFrequency();
+
+    demo_shapes_init(&demo);
+    printf("\n%-6s %16s %16s %8s\n", "modo", "imediato (us)", "textura (us)", "ganho");
+    for (int mode = 0; mode < NUM_STATIC_MODES; ++mode) {
+        Uint64 t0 = SDL_GetPerformanceCounter();
+        for (int f = 0; f < frames; ++f) {
+            SDL_SetRenderDrawColor(renderer, 0, 0, 0, 255);
+            SDL_RenderClear(renderer);
+            rebuilds += draw_static_mode(renderer, &demo, mode);
+            SDL_RenderFlush(renderer);
+        }
+        Uint64 t1 = SDL_GetPerformanceCounter();
+        if (!mode_textures_draw(renderer, &mt, &demo, mode, &rebuilds)) {
+            printf("%-6d sem suporte a texturas alvo: %s\n", mode, SDL_GetError());
+            status = 1;
+            break;
+        }
+        Uint64 t2 = SDL_GetPerformanceCounter();
+        for (int f = 0; f < frames; ++f) {
+            mode_textures_draw(renderer, &mt, &demo, mode, &rebuilds);
+            SDL_RenderFlush(renderer);
+        }
+        Uint64 t3 = SDL_GetPerformanceCounter();
+
+        double us_immediate = (double)(t1 - t0) * 1e6 / freq / frames;
+        double us_texture = (double)(t3 - t2) * 1e6 / freq / frames;
+        printf("%-6d %16.2f %16.2f %7.2fx\n", mode, us_immediate, us_texture, us_immediate / us_texture);
+    }
+
+    mode_textures_invalidate(&mt);
+    demo_shapes_destroy(&demo);
+    return status;
+}
+
+// Uma forma usada nas comparações do benchmark
+typedef struct {
+    const char* name;
+    SDL_Point* vertices;
+    int num_vertices;
+} BenchShape;
+
+// Duas superfícies com renderizador de software: referência e variante
+typedef struct {
+    SDL_Surface* surface[2];
+    SDL_Renderer* renderer[2];
+} BenchTargets;
+
+/**
+ * @brief Cronometra fill_polygon_scanline contra 'fast' em cada forma e confere
+ * se os dois pintaram exatamente os mesmos pixels.
+ * @return 0 se tudo bateu, 1 se alguma forma divergiu.
+ */
+static int bench_compare_fills(BenchTargets* t, const char* fast_name, FillFunc fast, BenchShape shapes[], int num_shapes, bool needs_convex) {
+    int status = 0;
+
+    printf("\n%-10s %14s %14s %8s\n", "forma", "geral (us)", fast_name, "ganho");
+    for (int s = 0; s < num_shapes; ++s) {
+        if (needs_convex && !is_polygon_convex(shapes[s].vertices, shapes[s].num_vertices)) {
+            printf("%-10s nao e convexo, ignorado\n", shapes[s].name);
+            continue;
+        }
+
+        for (int i = 0; i < 2; ++i) {
+            SDL_SetRenderDrawColor(t->renderer[i], 0, 0, 0, 255);
+            SDL_RenderClear(t->renderer[i]);
+            SDL_SetRenderDrawColor(t->renderer[i], 0, 255, 0, 255);
+        }
+
+        double t_general = bench_fill(t->renderer[0], fill_polygon_scanline, shapes[s].vertices, shapes[s].num_vertices);
+        double t_fast = bench_fill(t->renderer[1], fast, shapes[s].vertices, shapes[s].num_vertices);
+        printf("%-10s %14.2f %14.2f %7.2fx\n", shapes[s].name, t_general, t_fast, t_general / t_fast);
+
+        // Os dois caminhos precisam pintar exatamente os mesmos pixels
+        SDL_RenderPresent(t->renderer[0]);
+        SDL_RenderPresent(t->renderer[1]);
+        for (int y = 0; y < SCREEN_HEIGHT; ++y) {
+            const Uint8* row_g = (const Uint8*)t->surface[0]->pixels + y * t->surface[0]->pitch;
+            const Uint8* row_f = (const Uint8*)t->surface[1]->pixels + y * t->surface[1]->pitch;
+            if (memcmp(row_g, row_f, SCREEN_WIDTH * 4) != 0) {
+                printf("  ERRO: %s difere do scanline geral na linha %d\n", shapes[s].name, y);
+                status = 1;
+                break;
+            }
+        }
+    }
+    return status;
+}
+
+/**
+ * @brief Compara pintar os polígonos sobrepostos um a um com a passada única
+ * da tabela global de arestas: tempo, pixels escritos e igualdade do resultado.
+ */
+static int bench_scene_fill(BenchTargets* t) {
+    Uint64 written[2];
+    double us[2];
+    int status = 0;
+
+    for (int i = 0; i < 2; ++i) {
+        SDL_SetRenderDrawColor(t->renderer[i], 0, 0, 0, 255);
+        SDL_RenderClear(t->renderer[i]);
+        raster_pixels_written = 0;
+        Uint64 start = SDL_GetPerformanceCounter();
+        for (int k = 0; k < BENCH_ITERATIONS / 10; ++k) {
+            if (i == 0) fill_polygons_painter(t->renderer[i], overlap_polygons, OVERLAP_NUM_POLYGONS);
+            else fill_polygons_scene(t->renderer[i], overlap_polygons, OVERLAP_NUM_POLYGONS);
+            arena_reset(&frame_arena);
+        }
+        Uint64 end = SDL_GetPerformanceCounter();
+        us[i] = (double)(end - start) * 1e6 / (double)SDL_GetPerformanceFrequency() / (BENCH_ITERATIONS / 10);
+        written[i] = raster_pixels_written / (BENCH_ITERATIONS / 10);
+        SDL_RenderPresent(t->renderer[i]);
+    }
+
+    printf("\n%d poligonos sobrepostos: um a um %.2f us (%llu pixels escritos), cena %.2f us (%llu pixels escritos)\n",
+           OVERLAP_NUM_POLYGONS, us[0], (unsigned long long)written[0], us[1], (unsigned long long)written[1]);
+    printf("  sobreposicao evitada: %.2fx menos escritas\n", (double)written[0] / (double)written[1]);
+    for (int y = 0; y < SCREEN_HEIGHT; ++y) {
+        const Uint8* row_p = (const Uint8*)t->surface[0]->pixels + y * t->surface[0]->pitch;
+        const Uint8* row_s = (const Uint8*)t->surface[1]->pixels + y * t->surface[1]->pitch;
+        if (memcmp(row_p, row_s, SCREEN_WIDTH * 4) != 0) {
+            printf("  ERRO: a cena difere da pintura um a um na linha %d\n", y);
+            status = 1;
+            break;
+        }
+    }
+    return status;
+}
+
+/**
+ * @brief Anti-aliasing de referência: preenche a versão 4x maior do polígono
+ * com o scanline atual (gravando os spans) e conta as 16 amostras por pixel.
+ * É o caminho que fill_polygon_aa precisa superar; a saída (spans opacos e
+ * bordas agrupadas por alpha) é a mesma, então só a cobertura é comparada.
+ */
+static void fill_polygon_supersample4(SDL_Renderer* renderer, SDL_FPoint vertices[], int num_vertices, SDL_Color color) {
+    SDL_Point* big = (SDL_Point*)arena_alloc(&frame_arena, num_vertices * sizeof(SDL_Point));
+    if (!big) return;
+    for (int i = 0; i < num_vertices; ++i) {
+        big[i].x = (int)lrintf(vertices[i].x * 4.0f);
+        big[i].y = (int)lrintf(vertices[i].y * 4.0f);
+    }
+
+    RasterRecording rec;
+    SDL_zero(rec);
+    RasterRecording* prev = raster_recording;
+    raster_recording = &rec;
+    fill_polygon_scanline(renderer, big, num_vertices);
+    raster_recording = prev;
+
+    Uint8* samples = (Uint8*)arena_alloc(&frame_arena, (size_t)SCREEN_WIDTH * SCREEN_HEIGHT);
+    if (samples) {
+        SDL_memset(samples, 0, (size_t)SCREEN_WIDTH * SCREEN_HEIGHT);
+        for (int s = 0; s < rec.num_spans; ++s) {
+            int y = rec.spans[s].y / 4;
+            if (rec.spans[s].y < 0 || y >= SCREEN_HEIGHT) continue;
+            for (int x = rec.spans[s].x; x < rec.spans[s].x + rec.spans[s].w; ++x) {
+                if (x >= 0 && x / 4 < SCREEN_WIDTH) samples[(size_t)y * SCREEN_WIDTH + x / 4]++;
+            }
+        }
+        // Amostras viram alpha no próprio buffer e saem como no caminho por acumulação
+        for (size_t i = 0; i < (size_t)SCREEN_WIDTH * SCREEN_HEIGHT; ++i) {
+            samples[i] = (Uint8)(samples[i] >= 16 ? 255 : samples[i] * 255 / 16);
+        }
+        SDL_BlendMode prev_blend;
+        SDL_GetRenderDrawBlendMode(renderer, &prev_blend);
+        aa_emit_rows(renderer, samples, SCREEN_WIDTH, SCREEN_HEIGHT, SCREEN_WIDTH, 0, 0, color);
+        SDL_SetRenderDrawBlendMode(renderer, prev_blend);
+    }
+    SDL_free(rec.spans);
+    SDL_free(rec.points);
+}
+
+// Diferença média aceita entre acumulação e supersampling 4x4 (em 1/255)
+const double AA_MAX_MEAN_DIFF = 1.0;
+
+/**
+ * @brief Compara o anti-aliasing por acumulação com o supersampling 4x4.
+ * Também mede a diferença média de cor entre os dois resultados.
+ * @return 1 se a diferença passar de AA_MAX_MEAN_DIFF.
+ */
+static int bench_aa_fill(BenchTargets* t, SDL_Point star[], int num_vertices) {
+    SDL_FPoint* fstar = (SDL_FPoint*)SDL_malloc(num_vertices * sizeof(SDL_FPoint));
+    if (!fstar) return 1;
+    for (int i = 0; i < num_vertices; ++i) {
+        fstar[i].x = star[i].x + 0.3f;
+        fstar[i].y = star[i].y + 0.6f;
+    }
+    SDL_Color white = { 255, 255, 255, 255 };
+    const int iterations = 50;
+    double us[2];
+
+    for (int i = 0; i < 2; ++i) {
+        Uint64 start = SDL_GetPerformanceCounter();
+        for (int k = 0; k < iterations; ++k) {
+            SDL_SetRenderDrawColor(t->renderer[i], 0, 0, 0, 255);
+            SDL_RenderClear(t->renderer[i]);
+            if (i == 0) fill_polygon_supersample4(t->renderer[i], fstar, num_vertices, white);
+            else fill_polygon_aa(t->renderer[i], fstar, num_vertices, white);
+            SDL_RenderPresent(t->renderer[i]);
+            arena_reset(&frame_arena);
+        }
+        us[i] = (double)(SDL_GetPerformanceCounter() - start) * 1e6 / (double)SDL_GetPerformanceFrequency() / iterations;
+    }
+
+    // Diferença média no canal verde (as duas aproximam a mesma cobertura)
+    double diff = 0.0;
+    for (int y = 0; y < SCREEN_HEIGHT; ++y) {
+        const Uint32* row_s = (const Uint32*)((const Uint8*)t->surface[0]->pixels + y * t->surface[0]->pitch);
+        const Uint32* row_a = (const Uint32*)((const Uint8*)t->surface[1]->pixels + y * t->surface[1]->pitch);
+        for (int x = 0; x < SCREEN_WIDTH; ++x) {
+            diff += abs((int)((row_s[x] >> 8) & 0xFF) - (int)((row_a[x] >> 8) & 0xFF));
+        }
+    }
+    diff /= (double)SCREEN_WIDTH * SCREEN_HEIGHT;
+
+    printf("\nanti-aliasing (estrela de %d vertices): supersampling 4x4 %.2f us, acumulacao %.2f us (%.2fx), diferenca media %.2f/255\n",
+           num_vertices, us[0], us[1], us[0] / us[1], diff);
+    SDL_free(fstar);
+    if (diff > AA_MAX_MEAN_DIFF) {
+        printf("  ERRO: a diferenca media passa de %.2f/255\n", AA_MAX_MEAN_DIFF);
+        return 1;
+    }
+    return 0;
+}
+
+// Espiral com 'num_points' pontos (polilinha longa para os contornos grossos)
+static void make_spiral(SDL_FPoint out[], int num_points, float cx, float cy, float r_max, float turns) {
+    for (int i = 0; i < num_points; ++i) {
+        float t = (float)i / (num_points - 1);
+        float a = 2.0f * (float)M_PI * turns * t;
+        out[i].x = cx + r_max * t * cosf(a);
+        out[i].y = cy + r_max * t * sinf(a);
+    }
+}
+
+/**
+ * @brief Compara o stroker com o jeito ingênuo de fazer traço grosso:
+ * 'width' retas de 1 pixel deslocadas ao longo da normal de cada segmento.
+ */
+static int bench_stroke(BenchTargets* t) {
+    enum { SPIRAL_POINTS = 2000 };
+    const int iterations = 20;
+    SDL_FPoint* spiral = (SDL_FPoint*)SDL_malloc(SPIRAL_POINTS * sizeof(SDL_FPoint));
+    if (!spiral) return 1;
+    make_spiral(spiral, SPIRAL_POINTS, SCREEN_WIDTH / 2.0f, SCREEN_HEIGHT / 2.0f, 220.0f, 6.0f);
+    StrokeStyle style = { 16.0f, JOIN_ROUND, CAP_ROUND, 4.0f };
+    SDL_Color white = { 255, 255, 255, 255 };
+    Uint64 written[2];
+    double us[2];
+
+    for (int i = 0; i < 2; ++i) {
+        SDL_Renderer* r = t->renderer[i];
+        SDL_SetRenderDrawColor(r, 0, 0, 0, 255);
+        SDL_RenderClear(r);
+        SDL_SetRenderDrawColor(r, 255, 255, 255, 255);
+        raster_pixels_written = 0;
+        Uint64 start = SDL_GetPerformanceCounter();
+        for (int k = 0; k < iterations; ++k) {
+            if (i == 0) {
+                for (int s = 0; s + 1 < SPIRAL_POINTS; ++s) {
+                    SDL_FPoint a = spiral[s], b = spiral[s + 1];
+                    float len = sqrtf((b.x - a.x) * (b.x - a.x) + (b.y - a.y) * (b.y - a.y));
+                    float nx = -(b.y - a.y) / len, ny = (b.x - a.x) / len;
+                    for (int o = -(int)style.width / 2; o <= (int)style.width / 2; ++o) {
+                        draw_line_midpoint(r, (int)lrintf(a.x + nx * o), (int)lrintf(a.y + ny * o),
+                                           (int)lrintf(b.x + nx * o), (int)lrintf(b.y + ny * o));
+                    }
+                }
+            } else {
+                stroke_polyline(r, spiral, SPIRAL_POINTS, false, &style, white);
+            }
+            arena_reset(&frame_arena);
+        }
+        us[i] = (double)(SDL_GetPerformanceCounter() - start) * 1e6 / (double)SDL_GetPerformanceFrequency() / iterations;
+        written[i] = raster_pixels_written / iterations;
+        SDL_RenderPresent(r);
+    }
+
+    // Pixels distintos do traço, para saber quanto cada caminho reescreveu
+    Uint64 distinct = 0;
+    for (int y = 0; y < SCREEN_HEIGHT; ++y) {
+        const Uint32* row = (const Uint32*)((const Uint8*)t->surface[1]->pixels + y * t->surface[1]->pitch);
+        for (int x = 0; x < SCREEN_WIDTH; ++x) distinct += (row[x] & 0xFFFFFF) != 0;
+    }
+    printf("\ncontorno grosso (espiral de %d pontos, largura %.0f): retas deslocadas %.2f us (%llu escritas), stroker %.2f us (%llu escritas, %llu pixels)\n",
+           SPIRAL_POINTS, style.width, us[0], (unsigned long long)written[0], us[1],
+           (unsigned long long)written[1], (unsigned long long)distinct);
+    SDL_free(spiral);
+    return 0;
+}
+
+/**
+ * @brief Teste da malha: o scanline atual contra a regra top-left.
+ * @return 1 se a regra top-left escreveu algum pixel duas vezes ou deixou buraco.
+ */
+static int bench_mesh(void) {
+    Uint8* counts = (Uint8*)SDL_malloc((size_t)SCREEN_WIDTH * SCREEN_HEIGHT);
+    if (!counts) return 1;
+    mesh_init();
+    int doubles[2], holes[2];
+    double us[2];
+    void (*fills[2])(SDL_Renderer*, SDL_Point[], int) = { fill_polygon_scanline, fill_polygon_topleft };
+
+    for (int i = 0; i < 2; ++i) {
+        Uint64 start = SDL_GetPerformanceCounter();
+        mesh_count_writes(fills[i], counts, &doubles[i], &holes[i]);
+        us[i] = (double)(SDL_GetPerformanceCounter() - start) * 1e6 / (double)SDL_GetPerformanceFrequency();
+        arena_reset(&frame_arena);
+    }
+
+    printf("\nmalha de %d triangulos: scanline %.2f us (%d pixels 2x, %d buracos), top-left %.2f us (%d pixels 2x, %d buracos)\n",
+           MESH_NUM_TRIANGLES, us[0], doubles[0], holes[0], us[1], doubles[1], holes[1]);
+    SDL_free(counts);
+    if (doubles[1] != 0 || holes[1] != 0) {
+        printf("  ERRO: a regra top-left deveria escrever cada pixel uma vez\n");
+        return 1;
+    }
+    return 0;
+}
+
+// Leque de retas subpixel a partir do centro, usado no modo 10 e no benchmark
+static void make_line_fan(SDL_FPoint out[][2], int num_lines, float cx, float cy, float radius, float phase) {
+    for (int i = 0; i < num_lines; ++i) {
+        float a = phase + 2.0f * (float)M_PI * i / num_lines;
+        out[i][0].x = cx + 20.0f * cosf(a);
+        out[i][0].y = cy + 20.0f * sinf(a);
+        out[i][1].x = cx + radius * cosf(a);
+        out[i][1].y = cy + radius * sinf(a);
+    }
+}
+
+/**
+ * @brief Compara as retas de Wu com as do ponto médio, ambas no framebuffer.
+ * O pedido é que a versão anti-aliased fique a no máximo 2x da serrilhada.
+ */
+static int bench_lines(void) {
+    enum { NUM_LINES = 360 };
+    const int iterations = 200;
+    Framebuffer fb;
+    if (!framebuffer_init(&fb, NULL, SCREEN_WIDTH, SCREEN_HEIGHT)) {
+        printf("Falha ao alocar o framebuffer.\n");
+        return 1;
+    }
+    SDL_FPoint (*fan)[2] = (SDL_FPoint(*)[2])SDL_malloc(NUM_LINES * sizeof(*fan));
+    if (!fan) {
+        framebuffer_destroy(&fb);
+        return 1;
+    }
+    make_line_fan(fan, NUM_LINES, SCREEN_WIDTH / 2.0f + 0.3f, SCREEN_HEIGHT / 2.0f + 0.7f, 230.0f, 0.01f);
+    SDL_Color white = { 255, 255, 255, 255 };
+    double us[2];
+
+    for (int style = LINE_ALIASED; style <= LINE_ANTIALIASED; ++style) {
+        Uint64 start = SDL_GetPerformanceCounter();
+        for (int k = 0; k < iterations; ++k) {
+            for (int i = 0; i < NUM_LINES; ++i) {
+                framebuffer_draw_line(&fb, fan[i][0].x, fan[i][0].y, fan[i][1].x, fan[i][1].y, white, (LineStyle)style);
+            }
+            arena_reset(&frame_arena);
+        }
+        us[style] = (double)(SDL_GetPerformanceCounter() - start) * 1e6 / (double)SDL_GetPerformanceFrequency() / iterations;
+    }
+
+    printf("\nretas (%d por quadro): ponto medio %.2f us, Wu %.2f us (%.2fx)%s\n",
+           NUM_LINES, us[LINE_ALIASED], us[LINE_ANTIALIASED], us[LINE_ANTIALIASED] / us[LINE_ALIASED],
+           us[LINE_ANTIALIASED] > 2.0 * us[LINE_ALIASED] ? " ACIMA DE 2x" : "");
+    SDL_free(fan);
+    framebuffer_destroy(&fb);
+    return 0;
+}
+
+/**
+ * @brief Roda as comparações do modo --bench, sem abrir janela.
+ * Desenha em SDL_Surfaces com o renderizador por software, cronometra cada
+ * variante contra a referência e confere se produziram os mesmos pixels.
+ */
+static int run_benchmarks(void) {
+    if (SDL_Init(SDL_INIT_TIMER) < 0) {
+        printf("SDL nao pode inicializar! Erro: %s\n", SDL_GetError());
+        return 1;
+    }
+
+    BenchTargets t;
+    for (int i = 0; i < 2; ++i) {
+        t.surface[i] = SDL_CreateRGBSurfaceWithFormat(0, SCREEN_WIDTH, SCREEN_HEIGHT, 32, SDL_PIXELFORMAT_ARGB8888);
+        t.renderer[i] = t.surface[i] ? SDL_CreateSoftwareRenderer(t.surface[i]) : NULL;
+    }
+    if (!t.renderer[0] || !t.renderer[1]) {
+        printf("Renderer de software nao pode ser criado! Erro: %s\n", SDL_GetError());
+        SDL_Quit();
+        return 1;
+    }
+
+    // Um polígono convexo grande (aproximação de círculo) para ter muitas linhas
+    SDL_Point circulo[64];
+    for (int i = 0; i < 64; ++i) {
+        double a = 2.0 * M_PI * i / 64;
+        circulo[i].x = 320 + (int)round(220.0 * cos(a));
+        circulo[i].y = 240 + (int)round(220.0 * sin(a));
+    }
+    BenchShape convexas[] = {
+        { "triangulo", triangulo, num_vertices_tri },
+        { "pentagono", pentagono, num_vertices_pen },
+        { "circulo64", circulo, 64 },
+    };
+
+    // Estrelas: muitas interseções por scanline, onde ordenar domina
+    SDL_Point estrela8[16], estrela64[128], estrela256[512];
+    make_star(estrela8, 8, 320, 240, 230.0, 90.0);
+    make_star(estrela64, 64, 320, 240, 230.0, 150.0);
+    make_star(estrela256, 256, 320, 240, 230.0, 200.0);
+    BenchShape estrelas[] = {
+        { "pentagono", pentagono, num_vertices_pen },
+        { "estrela8", estrela8, 16 },
+        { "estrela64", estrela64, 128 },
+        { "estrela256", estrela256, 512 },
+    };
+
+    int status = 0;
+    status |= bench_compare_fills(&t, "convexo (us)", fill_convex_polygon, convexas, 3, true);
+    status |= bench_compare_fills(&t, "edgeflag (us)", fill_polygon_edgeflag_even_odd, estrelas, 4, false);
+    overlap_scene_init();
+    status |= bench_scene_fill(&t);
+    status |= bench_aa_fill(&t, estrela8, 16);
+    status |= bench_lines();
+    status |= bench_stroke(&t);
+    status |= bench_mesh();
+    if (bench_transform() != 0) status = 1;
+    if (bench_span_kernels() != 0) status = 1;
+    if (bench_pixel_formats() != 0) status = 1;
+    if (bench_mode_textures(t.renderer[0]) != 0) status = 1;
+
+    // Medições do autotuner nesta máquina (sem gravar o arquivo)
+    KernelTable tuned;
+    printf("\n");
+    if (autotune_run(&tuned, true)) kernel_table_print(&tuned);
+
+    for (int i = 0; i < 2; ++i) {
+        SDL_DestroyRenderer(t.renderer[i]);
+        SDL_FreeSurface(t.surface[i]);
+    }
+    arena_destroy(&frame_arena);
+    SDL_Quit();
+    return status;
+}
+
+// --- Teste diferencial (--difftest) ---
+
+/*
+ * Antes de adotar um caminho otimizado, ele tem que dar exatamente os
+ * pixels da referência. A referência roda gravada (raster_recording, um
+ * raster_point por pixel, como no renderer) e é pintada num quadro; cada
+ * variante desenha pelo próprio caminho noutro quadro, e os dois são
+ * comparados pixel a pixel. As entradas vêm do fuzzer do SDL_test com
+ * semente fixa, então qualquer caso relatado se repete com a mesma
+ * semente: retas degeneradas, horizontais, verticais e com coordenadas
+ * enormes, recortes com pontos na borda da janela e polígonos que se
+ * cruzam, com arestas nos eixos ou sem área.
+ */
+typedef enum { DIFF_LINE, DIFF_CLIP, DIFF_FILL, DIFF_KIND_COUNT } DiffKind;
+
+enum { DIFF_MAX_VERTICES = 16, DIFF_MAX_REPORTS = 10 };
+
+// Bem além da tela, mas sem estourar as contas inteiras do ponto médio
+const int DIFF_HUGE = 30000;
+
+const Uint32 DIFF_BACKGROUND = 0xFF000000u;
+const Uint32 DIFF_FOREGROUND = 0xFFFFFFFFu;
+
+static const char* const DIFF_KIND_NAMES[DIFF_KIND_COUNT] = { "draw_line_midpoint", "clip_and_draw_line", "fill_polygon_scanline" };
+
+typedef struct {
+    DiffKind kind;
+    const char* category;
+    int x0, y0, x1, y1;         // DIFF_LINE
+    double dx0, dy0, dx1, dy1;  // DIFF_CLIP
+    SDL_Point vertices[DIFF_MAX_VERTICES];
+    int num_vertices;           // DIFF_FILL
+} DiffCase;
+
+typedef struct {
+    PixelTarget expected;
+    PixelTarget actual;
+    PixelTarget formats[PIXEL_FORMAT_COUNT]; // Destinos das variantes por formato
+    Framebuffer fb;
+    int failures;
+    int reports;
+} DiffContext;
+
+static int diff_random(int min, int max) {
+    return (int)SDLTest_RandomIntegerInRange(min, max);
+}
+
+static void diff_generate(DiffCase* c, DiffKind kind, int index) {
+    const int w = SCREEN_WIDTH, h = SCREEN_HEIGHT;
+    SDL_zerop(c);
+    c->kind = kind;
+    if (kind == DIFF_LINE || kind == DIFF_CLIP) {
+        int x0 = diff_random(-50, w + 50), y0 = diff_random(-50, h + 50);
+        int x1 = diff_random(-50, w + 50), y1 = diff_random(-50, h + 50);
+        switch (index % 7) {
+            case 0: c->category = "aleatoria"; break;
+            case 1: c->category = "ponto"; x1 = x0; y1 = y0; break;
+            case 2: c->category = "horizontal"; y1 = y0; break;
+            case 3: c->category = "vertical"; x1 = x0; break;
+            case 4: c->category = "diagonal"; y1 = y0 + (x1 - x0) * (diff_random(0, 1) ? 1 : -1); break;
+            case 5:
+                c->category = "enorme";
+                x0 = diff_random(-DIFF_HUGE, DIFF_HUGE);
+                y0 = diff_random(-DIFF_HUGE, DIFF_HUGE);
+                x1 = diff_random(-DIFF_HUGE, DIFF_HUGE);
+                y1 = diff_random(-DIFF_HUGE, DIFF_HUGE);
+                break;
+            default:
+                // Pontos em cima da borda da janela de recorte
+                c->category = "borda";
+                x0 = diff_random(0, 1) ? X_MIN : X_MAX;
+                y1 = diff_random(0, 1) ? Y_MIN : Y_MAX;
+                break;
+        }
+        c->x0 = x0;
+        c->y0 = y0;
+        c->x1 = x1;
+        c->y1 = y1;
+        // O recorte recebe coordenadas fracionárias (exceto na borda, que é exata)
+        bool exact = index % 7 == 6;
+        c->dx0 = x0 + (exact ? 0.0 : SDLTest_RandomUnitDouble());
+        c->dy0 = y0 + (exact ? 0.0 : SDLTest_RandomUnitDouble());
+        c->dx1 = x1 + (exact ? 0.0 : SDLTest_RandomUnitDouble());
+        c->dy1 = y1 + (exact ? 0.0 : SDLTest_RandomUnitDouble());
+        return;
+    }
+
+    c->num_vertices = diff_random(3, 12);
+    switch (index % 6) {
+        case 0: // Vértices soltos: quase sempre se cruza
+            c->category = "aleatorio";
+            for (int i = 0; i < c->num_vertices; ++i) {
+                c->vertices[i].x = diff_random(-50, w + 50);
+                c->vertices[i].y = diff_random(-50, h + 50);
+            }
+            break;
+        case 1: // Grade grossa: muitas arestas horizontais, verticais e colineares
+            c->category = "eixos";
+            for (int i = 0; i < c->num_vertices; ++i) {
+                c->vertices[i].x = diff_random(-1, w / 40 + 1) * 40;
+                c->vertices[i].y = diff_random(-1, h / 40 + 1) * 40;
+            }
+            break;
+        case 2: { // Sem área: vértices repetidos ou todos numa reta
+            c->category = "degenerado";
+            int x = diff_random(0, w), y = diff_random(0, h), dx = diff_random(-20, 20), dy = diff_random(-20, 20);
+            for (int i = 0; i < c->num_vertices; ++i) {
+                int k = diff_random(0, 1) ? i : 0;
+                c->vertices[i].x = x + k * dx;
+                c->vertices[i].y = y + k * dy;
+            }
+            break;
+        }
+        case 3: { // Convexo: ângulos crescentes num círculo
+            c->category = "convexo";
+            int cx = diff_random(0, w), cy = diff_random(0, h), r = diff_random(1, 300);
+            double start = SDLTest_RandomUnitDouble() * 2.0 * M_PI;
+            for (int i = 0; i < c->num_vertices; ++i) {
+                double a = start + 2.0 * M_PI * i / c->num_vertices;
+                c->vertices[i].x = cx + (int)round(r * cos(a));
+                c->vertices[i].y = cy + (int)round(r * sin(a));
+            }
+            break;
+        }
+        case 4:
+            c->category = "enorme";
+            for (int i = 0; i < c->num_vertices; ++i) {
+                c->vertices[i].x = diff_random(-DIFF_HUGE, DIFF_HUGE);
+                c->vertices[i].y = diff_random(-DIFF_HUGE, DIFF_HUGE);
+            }
+            break;
+        default: { // Estrela: muitas interseções por linha
+            c->category = "estrela";
+            int points = c->num_vertices / 2 < 3 ? 3 : c->num_vertices / 2;
+            c->num_vertices = 2 * points;
+            int cx = diff_random(0, w), cy = diff_random(0, h);
+            double r_outer = diff_random(20, 300), r_inner = r_outer * (0.2 + 0.7 * SDLTest_RandomUnitDouble());
+            for (int i = 0; i < c->num_vertices; ++i) {
+                double a = M_PI * i / points;
+                double r = (i % 2) ? r_inner : r_outer;
+                c->vertices[i].x = cx + (int)round(r * cos(a));
+                c->vertices[i].y = cy + (int)round(r * sin(a));
+            }
+            break;
+        }
+    }
+}
+
+static void diff_print_case(const DiffCase* c) {
+    switch (c->kind) {
+        case DIFF_LINE:
+            printf("    entrada: (%d, %d) -> (%d, %d)\n", c->x0, c->y0, c->x1, c->y1);
+            break;
+        case DIFF_CLIP:
+            printf("    entrada: (%.17g, %.17g) -> (%.17g, %.17g), janela [%d, %d] x [%d, %d]\n",
+                   c->dx0, c->dy0, c->dx1, c->dy1, X_MIN, X_MAX, Y_MIN, Y_MAX);
+            break;
+        default:
+            printf("    entrada:");
+            for (int i = 0; i < c->num_vertices; ++i) printf(" (%d, %d)", c->vertices[i].x, c->vertices[i].y);
+            printf("\n");
+            break;
+    }
+}
+
+// Desenha o caso pela rotina de referência, no destino de saída que estiver ativo
+static void diff_draw_reference(const DiffCase* c) {
+    switch (c->kind) {
+        case DIFF_LINE: draw_line_midpoint(NULL, c->x0, c->y0, c->x1, c->y1); break;
+        case DIFF_CLIP: clip_and_draw_line(NULL, c->dx0, c->dy0, c->dx1, c->dy1); break;
+        default: fill_polygon_scanline(NULL, (SDL_Point*)c->vertices, c->num_vertices); break;
+    }
+    arena_reset(&frame_arena);
+}
+
+/**
+ * @brief Grava a referência e a pinta em ctx->expected.
+ * @return false se a gravação ficou sem memória.
+ */
+static bool diff_render_expected(DiffContext* ctx, const DiffCase* c) {
+    RasterRecording rec;
+    SDL_zero(rec);
+    rec.clip = true;
+    rec.x_max = SCREEN_WIDTH - 1;
+    rec.y_max = SCREEN_HEIGHT - 1;
+    RasterRecording* prev = raster_recording;
+    raster_recording = &rec;
+    diff_draw_reference(c);
+    raster_recording = prev;
+
+    PixelTarget* t = &ctx->expected;
+    t->color = DIFF_BACKGROUND;
+    t->writers->clear(t);
+    t->color = DIFF_FOREGROUND;
+    for (int s = 0; s < rec.num_spans; ++s) {
+        t->writers->span(t, rec.spans[s].y, rec.spans[s].x, rec.spans[s].x + rec.spans[s].w - 1);
+    }
+    for (int p = 0; p < rec.num_points; ++p) t->writers->point(t, rec.points[p].x, rec.points[p].y);
+    bool ok = !rec.failed;
+    SDL_free(rec.spans);
+    SDL_free(rec.points);
+    return ok;
+}
+
+static void diff_report(DiffContext* ctx, const char* variant, int index, const DiffCase* c, int x, int y,
+                        Uint32 expected, Uint32 actual, int count) {
+    ctx->failures++;
+    if (ctx->reports++ >= DIFF_MAX_REPORTS) return;
+    printf("  DIFERENCA %s [%s] caso %d (%s): primeiro pixel (%d, %d) esperado %08X, obtido %08X; %d pixels diferentes\n",
+           DIFF_KIND_NAMES[c->kind], variant, index, c->category, x, y, (unsigned)expected, (unsigned)actual, count);
+    diff_print_case(c);
+}
+
+// Compara ctx->actual com ctx->expected e relata o primeiro pixel diferente
+static bool diff_compare(DiffContext* ctx, const char* variant, int index, const DiffCase* c) {
+    int count = 0, first_x = 0, first_y = 0;
+    Uint32 first_expected = 0, first_actual = 0;
+    for (int y = 0; y < SCREEN_HEIGHT; ++y) {
+        const Uint32* e = (const Uint32*)(ctx->expected.pixels + (size_t)y * ctx->expected.pitch);
+        const Uint32* a = (const Uint32*)(ctx->actual.pixels + (size_t)y * ctx->actual.pitch);
+        if (memcmp(e, a, SCREEN_WIDTH * sizeof(Uint32)) == 0) continue;
+        for (int x = 0; x < SCREEN_WIDTH; ++x) {
+            if (e[x] == a[x]) continue;
+            if (count++ == 0) {
+                first_x = x;
+                first_y = y;
+                first_expected = e[x];
+                first_actual = a[x];
+            }
+        }
+    }
+    if (count > 0) diff_report(ctx, variant, index, c, first_x, first_y, first_expected, first_actual, count);
+    return count == 0;
+}
+
+// Variante: a mesma rotina, mas escrevendo direto num PixelTarget do formato
+static void diff_run_format(DiffContext* ctx, PixelFormatKind format, int index, const DiffCase* c) {
+    PixelTarget* t = format == PIXEL_ARGB8888 ? &ctx->actual : &ctx->formats[format];
+    pixel_target_set_color(t, (SDL_Color){ 0, 0, 0, 255 });
+    t->writers->clear(t);
+    pixel_target_set_color(t, (SDL_Color){ 255, 255, 255, 255 });
+    PixelTarget* prev = raster_target;
+    raster_target = t;
+    diff_draw_reference(c);
+    raster_target = prev;
+    if (format != PIXEL_ARGB8888) {
+        pixel_target_to_argb(t, (Uint32*)ctx->actual.pixels, ctx->actual.pitch / (int)sizeof(Uint32));
+    }
+    diff_compare(ctx, PIXEL_FORMAT_NAMES[format], index, c);
+}
+
+// Variante: pelo framebuffer de software (framebuffer_draw_line nas retas)
+static void diff_run_framebuffer(DiffContext* ctx, int index, const DiffCase* c) {
+    Framebuffer* fb = &ctx->fb;
+    framebuffer_clear(fb, DIFF_BACKGROUND);
+    if (c->kind == DIFF_LINE) {
+        SDL_Color branco = { 255, 255, 255, 255 };
+        framebuffer_draw_line(fb, (float)c->x0, (float)c->y0, (float)c->x1, (float)c->y1, branco, LINE_ALIASED);
+    } else {
+        Framebuffer* prev = raster_framebuffer;
+        raster_framebuffer = fb;
+        fb->color = DIFF_FOREGROUND;
+        diff_draw_reference(c);
+        raster_framebuffer = prev;
+    }
+    for (int y = 0; y < SCREEN_HEIGHT; ++y) {
+        SDL_memcpy(ctx->actual.pixels + (size_t)y * ctx->actual.pitch, fb->pixels + (size_t)y * fb->pitch, SCREEN_WIDTH * sizeof(Uint32));
+    }
+    diff_compare(ctx, "framebuffer", index, c);
+}
+
+// Variantes só de preenchimento: outras implementações do mesmo par-ímpar
+static void diff_run_fills(DiffContext* ctx, int index, const DiffCase* c) {
+    SDL_Point vertices[DIFF_MAX_VERTICES];
+    SDL_memcpy(vertices, c->vertices, c->num_vertices * sizeof(SDL_Point));
+    PixelTarget* prev = raster_target;
+    PixelTarget* t = &ctx->actual;
+    raster_target = t;
+
+    for (int v = 0; v < 3; ++v) {
+        const char* name;
+        t->color = DIFF_BACKGROUND;
+        t->writers->clear(t);
+        t->color = DIFF_FOREGROUND;
+        if (v == 0) {
+            name = "edgeflag";
+            fill_polygon_edgeflag_even_odd(NULL, vertices, c->num_vertices);
+        } else if (v == 1) {
+            // O caminho convexo só vale para polígonos convexos
+            if (!is_polygon_convex(vertices, c->num_vertices)) continue;
+            name = "convexo";
+            fill_convex_polygon(NULL, vertices, c->num_vertices);
+        } else {
+            name = "cena";
+            ColoredPolygon poly = { vertices, c->num_vertices, { 255, 255, 255, 255 } };
+            fill_polygons_scene(NULL, &poly, 1);
+        }
+        arena_reset(&frame_arena);
+        diff_compare(ctx, name, index, c);
+    }
+    raster_target = prev;
 }
 
 /**
- * @brief Recorta e desenha uma linha (x0, y0) - (x1, y1) usando o 
- * algoritmo Cohen-Sutherland.
- * * @param renderer O renderizador SDL.
- * @param x0 Coordenada x inicial.
- * @param y0 Coordenada y inicial.
- * @param x1 Coordenada x final.
- * @param y1 Coordenada y final.
+ * @brief Roda o teste diferencial sem abrir janela.
+ * * @param seed Semente do fuzzer (a mesma semente repete os mesmos casos).
+ * @param num_cases Casos por rotina de referência.
+ * @return 1 se alguma variante diferiu da referência.
  */
-void clip_and_draw_line(SDL_Renderer* renderer, double x0, double y0, double x1, double y1) {
-    // Calcula os outcodes dos pontos inicial e final
-    int outcode0 = compute_outcode(x0, y0);
-    int outcode1 = compute_outcode(x1, y1);
-    bool accept = false;
-
-    while (1) {
-        if (!(outcode0 | outcode1)) {
-            // Aceite trivial: Ambos os pontos estão dentro da janela
-            accept = true;
-            break;
-        } else if (outcode0 & outcode1) {
-            // Rejeição trivial: Ambos os pontos estão fora na mesma região
-            break;
-        } else {
-            // Recorte necessário
-            double x, y;
-            
-            // Pega o ponto que está fora
-            int outcodeOut = outcode0 ? outcode0 : outcode1;
+static int run_difftest(Uint64 seed, int num_cases) {
+    if (SDL_Init(SDL_INIT_TIMER) < 0) {
+        printf("SDL nao pode inicializar! Erro: %s\n", SDL_GetError());
+        return 1;
+    }
+    DiffContext ctx;
+    SDL_zero(ctx);
+    bool ok = pixel_target_init(&ctx.expected, PIXEL_ARGB8888, SCREEN_WIDTH, SCREEN_HEIGHT, NULL, 0);
+    ok = pixel_target_init(&ctx.actual, PIXEL_ARGB8888, SCREEN_WIDTH, SCREEN_HEIGHT, NULL, 0) && ok;
+    for (int f = PIXEL_RGB565; f < PIXEL_FORMAT_COUNT; ++f) {
+        ok = pixel_target_init(&ctx.formats[f], (PixelFormatKind)f, SCREEN_WIDTH, SCREEN_HEIGHT, palette_332, 256) && ok;
+    }
+    ok = framebuffer_init(&ctx.fb, NULL, SCREEN_WIDTH, SCREEN_HEIGHT) && ok;
+    int status = 0;
 
-            // Encontra a interseção
-            if (outcodeOut & TOP) {           // Ponto está acima
-                if (y1 != y0) {
-                    x = x0 + (x1 - x0) * (Y_MAX - y0) / (y1 - y0);
-                } else {
-                    // Degenerate: horizontal line. Keep x as the outside point's x.
-                    x = x0;
-                }
-                y = Y_MAX;
-            } else if (outcodeOut & BOTTOM) { // Ponto está abaixo
-                if (y1 != y0) {
-                    x = x0 + (x1 - x0) * (Y_MIN - y0) / (y1 - y0);
-                } else {
-                    x = x0;
-                }
-                y = Y_MIN;
-            } else if (outcodeOut & RIGHT) {  // Ponto está à direita
-                if (x1 != x0) {
-                    y = y0 + (y1 - y0) * (X_MAX - x0) / (x1 - x0);
-                } else {
-                    y = y0;
+    if (!ok) {
+        printf("Falha ao alocar os quadros do teste diferencial.\n");
+        status = 1;
+    } else {
+        SDLTest_FuzzerInit(seed);
+        printf("teste diferencial: semente %llu, %d casos por rotina\n", (unsigned long long)seed, num_cases);
+        for (int k = 0; k < DIFF_KIND_COUNT; ++k) {
+            int failures_before = ctx.failures;
+            Uint64 start = SDL_GetPerformanceCounter();
+            for (int i = 0; i < num_cases; ++i) {
+                DiffCase c;
+                diff_generate(&c, (DiffKind)k, i);
+                if (!diff_render_expected(&ctx, &c)) {
+                    printf("  Faltou memoria gravando o caso %d de %s\n", i, DIFF_KIND_NAMES[k]);
+                    status = 1;
+                    continue;
                 }
-                x = X_MAX;
-            } else if (outcodeOut & LEFT) {   // Ponto está à esquerda
-                if (x1 != x0) {
-                    y = y0 + (y1 - y0) * (X_MIN - x0) / (x1 - x0);
-                } else {
-                    y = y0;
+                // O recorte nunca pode escrever fora da janela
+                if (c.kind == DIFF_CLIP) {
+                    SDL_memcpy(ctx.actual.pixels, ctx.expected.pixels, (size_t)ctx.actual.pitch * SCREEN_HEIGHT);
+                    for (int y = 0; y < SCREEN_HEIGHT; ++y) {
+                        Uint32* row = (Uint32*)(ctx.actual.pixels + (size_t)y * ctx.actual.pitch);
+                        for (int x = 0; x < SCREEN_WIDTH; ++x) {
+                            if (x < X_MIN || x > X_MAX || y < Y_MIN || y > Y_MAX) row[x] = DIFF_BACKGROUND;
+                        }
+                    }
+                    diff_compare(&ctx, "dentro da janela", i, &c);
                 }
-                x = X_MIN;
-            }
-
-            // Atualiza o ponto que estava fora para o ponto de interseção
-            if (outcodeOut == outcode0) {
-                x0 = x;
-                y0 = y;
-                outcode0 = compute_outcode(x0, y0);
-            } else {
-                x1 = x;
-                y1 = y;
-                outcode1 = compute_outcode(x1, y1);
+                for (int f = 0; f < PIXEL_FORMAT_COUNT; ++f) diff_run_format(&ctx, (PixelFormatKind)f, i, &c);
+                diff_run_framebuffer(&ctx, i, &c);
+                if (c.kind == DIFF_FILL) diff_run_fills(&ctx, i, &c);
             }
+            double seconds = (double)(SDL_GetPerformanceCounter() - start) / (double)SDL_GetPerformanceFrequency();
+            printf("  %-22s %d casos, %d diferencas (%.2f s)\n", DIFF_KIND_NAMES[k], num_cases,
+                   ctx.failures - failures_before, seconds);
         }
+        if (ctx.reports > DIFF_MAX_REPORTS) printf("  (%d diferencas nao detalhadas)\n", ctx.reports - DIFF_MAX_REPORTS);
+        if (ctx.failures > 0) status = 1;
     }
 
-    if (accept) {
-        // Desenha a linha recortada (convertendo para int)
-        draw_line_midpoint(renderer, (int)round(x0), (int)round(y0), (int)round(x1), (int)round(y1));
+    pixel_target_destroy(&ctx.expected);
+    pixel_target_destroy(&ctx.actual);
+    for (int f = PIXEL_RGB565; f < PIXEL_FORMAT_COUNT; ++f) pixel_target_destroy(&ctx.formats[f]);
+    framebuffer_destroy(&ctx.fb);
+    arena_destroy(&frame_arena);
+    SDL_Quit();
+    return status;
+}
+
+// --- Gerador de carga (--stress) ---
+
+/*
+ * A demonstração desenha uma forma de cada vez; para dimensionar o
+ * hardware é preciso a quantidade real de primitivas. --stress gera uma
+ * carga sintética configurável (retas dentro, cruzando e fora da janela
+ * de recorte, polígonos convexos e côncavos com número de vértices e
+ * distribuição de tamanhos escolhidos), desenha a mesma carga por um
+ * número fixo de quadros e relata a vazão e os percentis de latência por
+ * quadro. Não abre janela: desenha num renderer de software ou direto
+ * num PixelTarget do formato escolhido.
+ */
+typedef enum { STRESS_SIZE_UNIFORM, STRESS_SIZE_LOG } StressSizeDist;
+
+typedef struct {
+    int num_lines;
+    double frac_inside;     // Frações das retas em relação à janela de recorte
+    double frac_crossing;   // (o resto fica fora)
+    int num_polys;
+    double frac_convex;     // O resto é côncavo
+    int min_vertices, max_vertices;
+    int min_size, max_size; // Raio dos polígonos, em pixels
+    StressSizeDist size_dist;
+    int frames;
+    Uint64 seed;
+    bool use_target;        // false: renderer de software
+    PixelFormatKind format;
+} StressConfig;
+
+typedef struct {
+    double (*lines)[4];     // x0, y0, x1, y1
+    SDL_Point* vertices;    // Vértices de todos os polígonos, em sequência
+    int* first_vertex;
+    int* num_vertices;
+    bool* convex;
+    SDL_Color* colors;
+    int lines_inside, lines_crossing, lines_outside;
+    int polys_convex;
+    Uint64 total_vertices;
+} StressWorkload;
+
+void stress_config_defaults(StressConfig* cfg) {
+    cfg->num_lines = 10000;
+    cfg->frac_inside = 0.5;
+    cfg->frac_crossing = 0.3;
+    cfg->num_polys = 2000;
+    cfg->frac_convex = 0.5;
+    cfg->min_vertices = 3;
+    cfg->max_vertices = 12;
+    cfg->min_size = 4;
+    cfg->max_size = 120;
+    cfg->size_dist = STRESS_SIZE_LOG;
+    cfg->frames = 100;
+    cfg->seed = 1;
+    cfg->use_target = false;
+    cfg->format = PIXEL_ARGB8888;
+}
+
+// Lê "A-B" (ou só "A") em dois inteiros
+static bool parse_range(const char* text, int* lo, int* hi) {
+    char* end;
+    long a = strtol(text, &end, 10);
+    long b = a;
+    if (end == text) return false;
+    if (*end == '-') {
+        const char* rest = end + 1;
+        b = strtol(rest, &end, 10);
+        if (end == rest) return false;
     }
+    if (*end != '\0' || a > b) return false;
+    *lo = (int)a;
+    *hi = (int)b;
+    return true;
 }
 
 /**
- * @brief Desenha o contorno de um polígono.
- * * @param renderer O renderizador SDL.
- * @param vertices Um array de SDL_Point (vértices).
- * @param num_vertices O número de vértices no array.
+ * @brief Lê as opções de --stress.
+ * @return false se alguma opção é inválida (a mensagem já foi impressa).
  */
-void draw_polygon(SDL_Renderer* renderer, SDL_Point vertices[], int num_vertices) {
-    if (num_vertices < 3) {
-        return; // Não é um polígono
+bool stress_parse_args(StressConfig* cfg, int argc, char* argv[]) {
+    for (int i = 1; i < argc; ++i) {
+        const char* opt = argv[i];
+        const char* val = i + 1 < argc ? argv[i + 1] : NULL;
+        bool ok = true;
+        if (strcmp(opt, "--stress") == 0) {
+            continue;
+        } else if (!val) {
+            continue; // Opções de outros modos sem valor
+        } else if (strcmp(opt, "--lines") == 0) {
+            cfg->num_lines = atoi(val);
+            ok = cfg->num_lines >= 0;
+        } else if (strcmp(opt, "--inside") == 0) {
+            cfg->frac_inside = atof(val);
+        } else if (strcmp(opt, "--crossing") == 0) {
+            cfg->frac_crossing = atof(val);
+        } else if (strcmp(opt, "--polys") == 0) {
+            cfg->num_polys = atoi(val);
+            ok = cfg->num_polys >= 0;
+        } else if (strcmp(opt, "--convex") == 0) {
+            cfg->frac_convex = atof(val);
+            ok = cfg->frac_convex >= 0.0 && cfg->frac_convex <= 1.0;
+        } else if (strcmp(opt, "--vertices") == 0) {
+            ok = parse_range(val, &cfg->min_vertices, &cfg->max_vertices) && cfg->min_vertices >= 3 && cfg->max_vertices <= 256;
+        } else if (strcmp(opt, "--size") == 0) {
+            ok = parse_range(val, &cfg->min_size, &cfg->max_size) && cfg->min_size >= 1;
+        } else if (strcmp(opt, "--size-dist") == 0) {
+            if (strcmp(val, "uniforme") == 0) cfg->size_dist = STRESS_SIZE_UNIFORM;
+            else if (strcmp(val, "log") == 0) cfg->size_dist = STRESS_SIZE_LOG;
+            else ok = false;
+        } else if (strcmp(opt, "--frames") == 0) {
+            cfg->frames = atoi(val);
+            ok = cfg->frames > 0;
+        } else if (strcmp(opt, "--seed") == 0) {
+            cfg->seed = strtoull(val, NULL, 10);
+        } else if (strcmp(opt, "--target") == 0) {
+            cfg->use_target = strcmp(val, "renderer") != 0;
+            if (cfg->use_target) {
+                int f = 0;
+                while (f < PIXEL_FORMAT_COUNT && SDL_strcasecmp(val, PIXEL_FORMAT_NAMES[f]) != 0) f++;
+                ok = f < PIXEL_FORMAT_COUNT;
+                cfg->format = (PixelFormatKind)f;
+            }
+        } else {
+            continue;
+        }
+        if (!ok) {
+            printf("Valor invalido para %s: %s\n", opt, val);
+            return false;
+        }
+        i++;
+    }
+    if (cfg->frac_inside < 0.0 || cfg->frac_crossing < 0.0 || cfg->frac_inside + cfg->frac_crossing > 1.0) {
+        printf("--inside e --crossing precisam somar no maximo 1.\n");
+        return false;
     }
+    return true;
+}
 
-    for (int i = 0; i < num_vertices; ++i) {
-        // Pega o ponto atual e o próximo ponto (com 'wrap-around')
-        SDL_Point p1 = vertices[i];
-        SDL_Point p2 = vertices[(i + 1) % num_vertices]; // O % garante a volta ao início
+static double stress_unit(void) {
+    return SDLTest_RandomUnitDouble();
+}
 
-        draw_line_midpoint(renderer, p1.x, p1.y, p2.x, p2.y);
+// Ponto dentro da janela de recorte, ou fora dela mas ainda perto da tela
+static void stress_point(bool inside, double* x, double* y) {
+    if (inside) {
+        *x = X_MIN + stress_unit() * (X_MAX - X_MIN);
+        *y = Y_MIN + stress_unit() * (Y_MAX - Y_MIN);
+        return;
     }
+    do {
+        *x = -100.0 + stress_unit() * (SCREEN_WIDTH + 200.0);
+        *y = -100.0 + stress_unit() * (SCREEN_HEIGHT + 200.0);
+    } while (*x >= X_MIN && *x <= X_MAX && *y >= Y_MIN && *y <= Y_MAX);
 }
 
-// Função de comparação para qsort (necessária para ordenar as interseções)
-int compare_doubles(const void* a, const void* b) {
-    double da = *(const double*)a;
-    double db = *(const double*)b;
-    return (da > db) - (da < db);
+static int stress_size(const StressConfig* cfg) {
+    if (cfg->size_dist == STRESS_SIZE_UNIFORM) {
+        return cfg->min_size + (int)(stress_unit() * (cfg->max_size - cfg->min_size + 1));
+    }
+    // Log-uniforme: muitos pequenos, poucos grandes
+    double lo = log((double)cfg->min_size), hi = log((double)cfg->max_size + 1.0);
+    return SDL_min((int)exp(lo + stress_unit() * (hi - lo)), cfg->max_size);
+}
+
+void stress_workload_destroy(StressWorkload* w) {
+    SDL_free(w->lines);
+    SDL_free(w->vertices);
+    SDL_free(w->first_vertex);
+    SDL_free(w->num_vertices);
+    SDL_free(w->convex);
+    SDL_free(w->colors);
+    SDL_zerop(w);
 }
 
 /**
- * @brief Preenche um polígono usando o algoritmo Scanline.
- * * @param renderer O renderizador SDL.
- * @param vertices Um array de SDL_Point (vértices).
- * @param num_vertices O número de vértices no array.
+ * @brief Gera a carga descrita por cfg (a mesma semente gera a mesma carga).
+ * @return false se faltou memória.
  */
-void fill_polygon_scanline(SDL_Renderer* renderer, SDL_Point vertices[], int num_vertices) {
-    if (num_vertices < 3) return;
+bool stress_workload_generate(StressWorkload* w, const StressConfig* cfg) {
+    SDL_zerop(w);
+    SDLTest_FuzzerInit(cfg->seed);
+    int n = cfg->num_polys;
+    w->lines = (double(*)[4])SDL_malloc((size_t)SDL_max(cfg->num_lines, 1) * sizeof(*w->lines));
+    w->vertices = (SDL_Point*)SDL_malloc((size_t)SDL_max(n, 1) * cfg->max_vertices * sizeof(SDL_Point));
+    w->first_vertex = (int*)SDL_malloc((size_t)SDL_max(n, 1) * sizeof(int));
+    w->num_vertices = (int*)SDL_malloc((size_t)SDL_max(n, 1) * sizeof(int));
+    w->convex = (bool*)SDL_malloc((size_t)SDL_max(n, 1) * sizeof(bool));
+    w->colors = (SDL_Color*)SDL_malloc((size_t)SDL_max(n, 1) * sizeof(SDL_Color));
+    if (!w->lines || !w->vertices || !w->first_vertex || !w->num_vertices || !w->convex || !w->colors) {
+        stress_workload_destroy(w);
+        return false;
+    }
 
-    // 1. Encontra os limites Y (min e max) do polígono
-    int y_min = vertices[0].y;
-    int y_max = vertices[0].y;
-    for (int i = 1; i < num_vertices; ++i) {
-        if (vertices[i].y < y_min) y_min = vertices[i].y;
-        if (vertices[i].y > y_max) y_max = vertices[i].y;
+    for (int i = 0; i < cfg->num_lines; ++i) {
+        double u = stress_unit();
+        bool a_inside, b_inside;
+        if (u < cfg->frac_inside) {
+            a_inside = b_inside = true;
+            w->lines_inside++;
+        } else if (u < cfg->frac_inside + cfg->frac_crossing) {
+            a_inside = true;
+            b_inside = false;
+            w->lines_crossing++;
+        } else {
+            a_inside = b_inside = false;
+            w->lines_outside++;
+        }
+        double* l = w->lines[i];
+        do {
+            stress_point(a_inside, &l[0], &l[1]);
+            stress_point(b_inside, &l[2], &l[3]);
+            // Fora: as duas pontas do mesmo lado, senão a reta pode cortar a janela
+        } while (!a_inside && !b_inside && !(compute_outcode(l[0], l[1]) & compute_outcode(l[2], l[3])));
     }
 
-    // Array para armazenar as interseções X em cada linha de varredura
-    double* intersections = (double*)malloc(num_vertices * sizeof(double));
-    if (!intersections) {
-        printf("Falha ao alocar memoria para scanline.\n");
-        return;
+    int next = 0;
+    for (int p = 0; p < n; ++p) {
+        bool convex = stress_unit() < cfg->frac_convex;
+        int count = cfg->min_vertices + (int)(stress_unit() * (cfg->max_vertices - cfg->min_vertices + 1));
+        count = SDL_min(count, cfg->max_vertices);
+        // Com 4 vértices a "estrela" é sempre uma pipa convexa
+        if (!convex && count < 5) count = SDL_min(5, cfg->max_vertices);
+        if (!convex && count < 5) convex = true;
+        double r = stress_size(cfg);
+        double cx = stress_unit() * SCREEN_WIDTH, cy = stress_unit() * SCREEN_HEIGHT;
+        double start = stress_unit() * 2.0 * M_PI;
+        // Côncavo: as pontas reduzidas ficam aquém da corda entre as vizinhas
+        double inner = r * cos(2.0 * M_PI / count);
+        SDL_Point* v = w->vertices + next;
+        for (int k = 0; k < count; ++k) {
+            // Côncavo: raio alternando entre cheio e reduzido (estrela irregular)
+            double rk = convex || (k % 2) == 0 ? r : inner * (0.3 + 0.4 * stress_unit());
+            double a = start + 2.0 * M_PI * k / count;
+            v[k].x = (int)lrint(cx + rk * cos(a));
+            v[k].y = (int)lrint(cy + rk * sin(a));
+        }
+        w->first_vertex[p] = next;
+        w->num_vertices[p] = count;
+        // Depois de arredondar, um polígono pequeno pode mudar de classe: conta o que saiu
+        w->convex[p] = is_polygon_convex(v, count);
+        w->polys_convex += w->convex[p];
+        w->colors[p].r = (Uint8)SDLTest_RandomIntegerInRange(40, 255);
+        w->colors[p].g = (Uint8)SDLTest_RandomIntegerInRange(40, 255);
+        w->colors[p].b = (Uint8)SDLTest_RandomIntegerInRange(40, 255);
+        w->colors[p].a = 255;
+        w->total_vertices += (Uint64)count;
+        next += count;
     }
+    return true;
+}
 
-    // 2. Itera por cada linha de varredura (scanline) de y_min até y_max
-    for (int y = y_min; y <= y_max; ++y) {
-        int num_intersections = 0;
+static void stress_print_percentiles(const char* name, FrameTimes* ft) {
+    qsort(ft->ms, ft->count, sizeof(double), compare_doubles);
+    printf("  %-10s p50 %8.3f  p90 %8.3f  p99 %8.3f  max %8.3f ms\n", name,
+           percentile_sorted(ft->ms, ft->count, 50.0), percentile_sorted(ft->ms, ft->count, 90.0),
+           percentile_sorted(ft->ms, ft->count, 99.0), ft->ms[ft->count - 1]);
+}
 
-        // 3. Encontra todas as interseções X para a linha 'y' atual
-        for (int i = 0; i < num_vertices; ++i) {
-            SDL_Point p1 = vertices[i];
-            SDL_Point p2 = vertices[(i + 1) % num_vertices];
+/**
+ * @brief Roda o gerador de carga sem abrir janela.
+ * @return 1 se não deu para criar o destino ou a carga.
+ */
+static int run_stress(const StressConfig* cfg) {
+    if (SDL_Init(SDL_INIT_TIMER) < 0) {
+        printf("SDL nao pode inicializar! Erro: %s\n", SDL_GetError());
+        return 1;
+    }
+    SDL_Surface* surface = NULL;
+    SDL_Renderer* renderer = NULL;
+    PixelTarget target;
+    SDL_zero(target);
+    StressWorkload w;
+    FrameTimes times[3] = { { NULL, 0, 0 }, { NULL, 0, 0 }, { NULL, 0, 0 } }; // Quadro, retas, polígonos
+    int status = 0;
 
-            // Verifica se a aresta (p1, p2) cruza a linha de varredura 'y'
-            if (((p1.y <= y && p2.y > y) || (p1.y > y && p2.y <= y))) {
-                // Evita divisão por zero (arestas horizontais são ignoradas pela lógica)
-                if (p1.y == p2.y) continue; 
-                
-                // Calcula o X da interseção usando interpolação linear
-                double x_intersect = (double)(y - p1.y) * (p2.x - p1.x) / (double)(p2.y - p1.y) + p1.x;
-                intersections[num_intersections++] = x_intersect;
-            }
+    if (cfg->use_target) {
+        if (!pixel_target_init(&target, cfg->format, SCREEN_WIDTH, SCREEN_HEIGHT, palette_332, 256)) status = 1;
+    } else {
+        surface = SDL_CreateRGBSurfaceWithFormat(0, SCREEN_WIDTH, SCREEN_HEIGHT, 32, SDL_PIXELFORMAT_ARGB8888);
+        renderer = surface ? SDL_CreateSoftwareRenderer(surface) : NULL;
+        if (!renderer) {
+            printf("Renderer de software nao pode ser criado! Erro: %s\n", SDL_GetError());
+            status = 1;
         }
+    }
+    if (status == 0 && !stress_workload_generate(&w, cfg)) {
+        printf("Falha ao alocar memoria para a carga.\n");
+        status = 1;
+    }
+    if (status != 0) {
+        pixel_target_destroy(&target);
+        if (renderer) SDL_DestroyRenderer(renderer);
+        SDL_FreeSurface(surface);
+        SDL_Quit();
+        return status;
+    }
 
-        // 4. Ordena as interseções em X
-        qsort(intersections, num_intersections, sizeof(double), compare_doubles);
+    printf("carga: %d retas (%d dentro, %d cruzando, %d fora da janela [%d, %d] x [%d, %d])\n",
+           cfg->num_lines, w.lines_inside, w.lines_crossing, w.lines_outside, X_MIN, X_MAX, Y_MIN, Y_MAX);
+    printf("       %d poligonos (%d convexos, %d concavos), %d-%d vertices, raio %d-%d (%s)\n",
+           cfg->num_polys, w.polys_convex, cfg->num_polys - w.polys_convex, cfg->min_vertices, cfg->max_vertices,
+           cfg->min_size, cfg->max_size, cfg->size_dist == STRESS_SIZE_LOG ? "log" : "uniforme");
+    printf("       %d quadros em %s, semente %llu\n", cfg->frames,
+           cfg->use_target ? PIXEL_FORMAT_NAMES[cfg->format] : "renderer de software", (unsigned long long)cfg->seed);
 
-        // 5. Preenche os pixels entre os pares de interseção
-        for (int i = 0; i < num_intersections; i += 2) {
-            if (i + 1 < num_intersections) {
-                int x_start = (int)round(intersections[i]);
-                int x_end = (int)round(intersections[i+1]);
+    PixelTarget* prev_target = raster_target;
+    if (cfg->use_target) raster_target = &target;
+    double freq = (double)SDL_GetPerformanceFrequency();
+    Uint64 pixels = 0;
+    SDL_Color fundo = { 0, 0, 0, 255 }, branco = { 255, 255, 255, 255 };
 
-                // Desenha a linha horizontal (o scan)
-                SDL_RenderDrawLine(renderer, x_start, y, x_end, y);
-            }
+    for (int f = 0; f < cfg->frames; ++f) {
+        Uint64 t0 = SDL_GetPerformanceCounter();
+        raster_pixels_written = 0;
+        if (cfg->use_target) {
+            pixel_target_set_color(&target, fundo);
+            target.writers->clear(&target);
+            pixel_target_set_color(&target, branco);
+        } else {
+            SDL_SetRenderDrawColor(renderer, 0, 0, 0, 255);
+            SDL_RenderClear(renderer);
+            SDL_SetRenderDrawColor(renderer, 255, 255, 255, 255);
+        }
+        for (int i = 0; i < cfg->num_lines; ++i) {
+            clip_and_draw_line(renderer, w.lines[i][0], w.lines[i][1], w.lines[i][2], w.lines[i][3]);
         }
+        Uint64 t1 = SDL_GetPerformanceCounter();
+        for (int p = 0; p < cfg->num_polys; ++p) {
+            SDL_Color c = w.colors[p];
+            if (cfg->use_target) pixel_target_set_color(&target, c);
+            else SDL_SetRenderDrawColor(renderer, c.r, c.g, c.b, c.a);
+            SDL_Point* v = w.vertices + w.first_vertex[p];
+            if (w.convex[p]) fill_convex_polygon(renderer, v, w.num_vertices[p]);
+            else fill_polygon_tuned(renderer, v, w.num_vertices[p]);
+        }
+        arena_reset(&frame_arena);
+        Uint64 t2 = SDL_GetPerformanceCounter();
+        pixels += raster_pixels_written;
+        perf_frame_end();
+        frame_times_add(&times[0], (double)(t2 - t0) * 1000.0 / freq);
+        frame_times_add(&times[1], (double)(t1 - t0) * 1000.0 / freq);
+        frame_times_add(&times[2], (double)(t2 - t1) * 1000.0 / freq);
+    }
+    raster_target = prev_target;
+
+    double total_s = 0.0, lines_s = 0.0, polys_s = 0.0;
+    for (int f = 0; f < times[0].count; ++f) {
+        total_s += times[0].ms[f] / 1000.0;
+        lines_s += times[1].ms[f] / 1000.0;
+        polys_s += times[2].ms[f] / 1000.0;
+    }
+    if (times[0].count == cfg->frames) {
+        printf("vazao: %.1f quadros/s, %.2f M retas/s, %.2f M poligonos/s, %.2f M vertices/s, %.1f M pixels/s\n",
+               cfg->frames / total_s,
+               lines_s > 0.0 ? (double)cfg->num_lines * cfg->frames / lines_s / 1e6 : 0.0,
+               polys_s > 0.0 ? (double)cfg->num_polys * cfg->frames / polys_s / 1e6 : 0.0,
+               polys_s > 0.0 ? (double)w.total_vertices * cfg->frames / polys_s / 1e6 : 0.0,
+               (double)pixels / total_s / 1e6);
+        printf("latencia por quadro:\n");
+        stress_print_percentiles("quadro", &times[0]);
+        stress_print_percentiles("retas", &times[1]);
+        stress_print_percentiles("poligonos", &times[2]);
+        perf_print_run(cfg->frames);
+    } else {
+        printf("Faltou memoria para guardar os tempos.\n");
+        status = 1;
     }
 
-    free(intersections);
+    for (int k = 0; k < 3; ++k) SDL_free(times[k].ms);
+    stress_workload_destroy(&w);
+    pixel_target_destroy(&target);
+    if (renderer) SDL_DestroyRenderer(renderer);
+    SDL_FreeSurface(surface);
+    arena_destroy(&frame_arena);
+    SDL_Quit();
+    return status;
 }
 
 int main(int argc, char* argv[]) {
     SDL_Window* window = NULL;
     SDL_Renderer* renderer = NULL;
 
+    bool bench = false;
+    bool difftest = false;
+    bool stress = false;
+    bool perf = false;
+    Uint64 difftest_seed = 1;
+    int difftest_cases = 2000;
+    AutotuneMode autotune = AUTOTUNE_CACHED;
+    const char* kernel_overrides = NULL;
+    const char* record_path = NULL;
+    const char* replay_path = NULL;
+    bool replay_max_speed = false;
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--bench") == 0) {
+            bench = true;
+        } else if (strcmp(argv[i], "--stress") == 0) {
+            stress = true; // As opções da carga são lidas por stress_parse_args
+        } else if (strcmp(argv[i], "--difftest") == 0) {
+            // --difftest [semente [casos]]
+            difftest = true;
+            if (i + 1 < argc && argv[i + 1][0] != '-') difftest_seed = strtoull(argv[++i], NULL, 10);
+            if (i + 1 < argc && argv[i + 1][0] != '-') difftest_cases = SDL_max(atoi(argv[++i]), 1);
+        } else if (strcmp(argv[i], "--record") == 0 && i + 1 < argc) {
+            record_path = argv[++i];
+        } else if (strcmp(argv[i], "--replay") == 0 && i + 1 < argc) {
+            replay_path = argv[++i];
+        } else if (strcmp(argv[i], "--replay-max") == 0) {
+            replay_max_speed = true;
+        } else if (strcmp(argv[i], "--autotune") == 0) {
+            autotune = AUTOTUNE_FORCE;
+        } else if (strcmp(argv[i], "--no-autotune") == 0) {
+            autotune = AUTOTUNE_OFF;
+        } else if (strcmp(argv[i], "--kernels") == 0 && i + 1 < argc) {
+            kernel_overrides = argv[++i];
+        } else if (strcmp(argv[i], "--perf") == 0) {
+            perf = true;
+        } else if (strcmp(argv[i], "--alloc-stats") == 0) {
+            // Tem que acontecer antes de qualquer alocação feita pelo SDL
+            if (!alloc_tracking_install()) return 1;
+        }
+    }
+
+    fill_span32_init();
+    palette_332_init();
+    overdraw_palette_init();
+
+    // Modos sem janela
+    if (bench) {
+        int status = run_benchmarks();
+        alloc_dump_totals();
+        return status;
+    }
+    if (difftest) {
+        return run_difftest(difftest_seed, difftest_cases);
+    }
+    if (stress) {
+        StressConfig cfg;
+        stress_config_defaults(&cfg);
+        if (!stress_parse_args(&cfg, argc, argv)) return 1;
+        kernels_setup(autotune, kernel_overrides);
+        if (perf) perf_init();
+        int status = run_stress(&cfg);
+        perf_shutdown();
+        return status;
+    }
+
+    // Tabela de kernels: do arquivo, medida agora ou fixada por --kernels
+    kernels_setup(autotune, kernel_overrides);
+    if (perf) perf_init();
+
+    // Gravação ou reprodução da entrada; um arquivo inválido encerra antes da janela
+    InputLog input_log;
+    SDL_zero(input_log);
+    if ((replay_path && !input_log_open(&input_log, replay_path, true, replay_max_speed)) ||
+        (!replay_path && record_path && !input_log_open(&input_log, record_path, false, false))) {
+        perf_shutdown();
+        return 1;
+    }
+
     // 1. Inicializa o SDL
     if (SDL_Init(SDL_INIT_VIDEO) < 0) {
         printf("SDL nao pode inicializar! Erro: %s\n", SDL_GetError());
@@ -288,34 +6989,131 @@ int main(int argc, char* argv[]) {
         return 1;
     }
 
-    // --- Definição das formas ---
-    SDL_Point triangulo[] = {
-        {320, 50},  // Topo
-        {120, 250}, // Canto inferior esquerdo
-        {520, 250}  // Canto inferior direito
-    };
-    int num_vertices_tri = 3;
+    // Formas dos modos 0-5 em modo retido: rasterizadas uma vez, repetidas
+    // do cache nos quadros seguintes (convexidade e bbox calculadas aqui).
+    // Por cima disso, cada modo vira uma textura apresentada com uma cópia.
+    DemoShapes demo;
+    demo_shapes_init(&demo);
+    ModeTextures mode_textures = { { NULL }, { 0 }, 0, 0, true };
 
-    SDL_Point pentagono[] = {
-        {100, 300}, {200, 300}, {250, 400}, {150, 450}, {50, 400}
-    };
-    int num_vertices_pen = 5;
+    // Tempo de desenho dos modos estáticos: [0] imediato, [1] textura
+    double static_draw_ms[2] = { 0.0, 0.0 };
+    Uint64 static_frames[2] = { 0, 0 };
+
+    // Cena grande do modo 6, navegada pelas setas
+    Scene scene;
+    if (!scene_generate(&scene, SCENE_NUM_SHAPES)) {
+        printf("Falha ao alocar memoria para a cena.\n");
+    }
+    SDL_Rect view = { 0, 0, SCREEN_WIDTH, SCREEN_HEIGHT };
+    int selected = -1;
+    bool dragging = false;
+
+    // Pentágono do modo 7: uma cópia SoA, desenhada sob várias transformações
+    VertexSoA pentagono_soa;
+    if (!soa_from_points(&pentagono_soa, pentagono, num_vertices_pen)) {
+        printf("Falha ao alocar memoria para o pentagono.\n");
+    }
+    bool pentagono_convexo = is_polygon_convex(pentagono, num_vertices_pen);
+
+    // Polígonos sobrepostos do modo 8 ('G' alterna entre cena e um a um)
+    overlap_scene_init();
+    bool scene_fill = true;
+
+    // Malha do modo 13 e os contadores de escrita por pixel
+    mesh_init();
+    Uint8* mesh_counts = (Uint8*)SDL_malloc((size_t)SCREEN_WIDTH * SCREEN_HEIGHT);
+
+    // Thread de renderização do modo 14
+    RenderThread render_thread;
+    render_thread_start(&render_thread, renderer);
+    int mouse_x = 0, mouse_y = 0;
 
+    // Framebuffer de software dos modos 10 e 15
+    Framebuffer fb;
+    if (!framebuffer_init(&fb, renderer, SCREEN_WIDTH, SCREEN_HEIGHT)) {
+        printf("Falha ao criar o framebuffer.\n");
+    }
+
+    // Um destino por formato no modo 15, cada um num quadrante da tela
+    PixelTarget format_targets[PIXEL_FORMAT_COUNT];
+    bool format_targets_ok = true;
+    for (int f = 0; f < PIXEL_FORMAT_COUNT; ++f) {
+        format_targets_ok = pixel_target_init(&format_targets[f], (PixelFormatKind)f, SCREEN_WIDTH / 2, SCREEN_HEIGHT / 2,
+                                              palette_332, 256) && format_targets_ok;
+    }
+    if (!format_targets_ok) {
+        printf("Falha ao criar os destinos de pixel.\n");
+    }
+
+    FrameTimes frame_times = { NULL, 0, 0 };
+
+    // Latência da entrada até a tela ('L' imprime os percentis)
+    LatencyTracker latency;
+    SDL_zero(latency);
+
+    // Mapa de sobreposição ('O'): quantas vezes cada pixel foi escrito
+    OverdrawBuffer overdraw;
+    bool overdraw_ok = overdraw_init(&overdraw, SCREEN_WIDTH, SCREEN_HEIGHT);
+    bool show_overdraw = false;
+
+    // Modo 16: conteúdo grande rasterizado aos poucos num framebuffer próprio
+    Framebuffer stream_fb;
+    if (!framebuffer_init(&stream_fb, renderer, SCREEN_WIDTH, SCREEN_HEIGHT)) {
+        printf("Falha ao criar o framebuffer do modo progressivo.\n");
+    }
+    ProgressiveScene progressive;
+    SDL_zero(progressive);
+    RasterScheduler scheduler;
+    raster_scheduler_init(&scheduler, &stream_fb);
+    double raster_budget_ms = 8.0; // '+'/'-' dobram/dividem
+    bool progressive_restart = true; // 'R' recomeça
 
     SDL_SetWindowTitle(window, "Modo 0: Contorno do triângulo");
 
     // --- Loop Principal ---
     int running = 1; 
     SDL_Event e;     
+    FrameStats stats = { 0 };
+    bool show_stats = false;
+    Uint64 frame_number = 0;
+    AllocCounters alloc_since[ALLOC_TAG_COUNT];
+    SDL_memcpy(alloc_since, alloc_counters, sizeof(alloc_since));
     // Circular os desenhos com Enter
-    int mode = 0; // 0..4
-    const int NUM_MODES = 6;
+    int mode = 0; // 0..16
+    const int NUM_MODES = 17;
+    FillRule contour_rule = FILL_EVEN_ODD; // Modo 12: 'R' alterna
+    bool mesh_topleft = true; // Modo 13: 'T' alterna com o scanline antigo
+    int render_load = 4; // Modo 14: cópias da cena por quadro ('+'/'-')
+    float stroke_width = 12.0f; // Modo 11: '+'/'-' mudam a largura
+    bool anti_aliased = true; // Modos 9 e 10: 'A' alterna
 
     while (running) {
+        // Na reprodução, os eventos do quadro entram na fila aqui. A espera
+        // pelo tempo gravado fica antes do relógio do quadro: o histograma
+        // mede o desenho, não o ritmo da gravação.
+        input_log_frame(&input_log, SDL_GetWindowID(window));
+        if (input_log.finished) running = 0;
+
+        Uint64 frame_start = SDL_GetPerformanceCounter();
+        int allocs_before = SDL_GetNumAllocations();
+
+        // A memória temporária do quadro anterior é descartada de uma vez
+        // (se a arena for reorganizada, a conta vai para os rasterizadores)
+        alloc_set_tag(ALLOC_TAG_FILL);
+        arena_reset(&frame_arena);
+        alloc_set_tag(ALLOC_TAG_RENDERER);
+
         // 4. Processa eventos na fila
         while (SDL_PollEvent(&e) != 0) {
+            input_log_event(&input_log, &e);
+            latency_note_event(&latency, &e);
             if (e.type == SDL_QUIT) {
                 running = 0; 
+            } else if (e.type == SDL_RENDER_TARGETS_RESET || e.type == SDL_RENDER_DEVICE_RESET ||
+                       (e.type == SDL_WINDOWEVENT && e.window.event == SDL_WINDOWEVENT_SIZE_CHANGED)) {
+                // Conteúdo das texturas alvo perdido ou tamanho errado
+                mode_textures_invalidate(&mode_textures);
             } else if (e.type == SDL_KEYDOWN) {
                 // Enter cycles to next mode; Escape quits
                 if (e.key.keysym.sym == SDLK_RETURN) {
@@ -329,67 +7127,420 @@ int main(int argc, char* argv[]) {
                         case 3: snprintf(title, sizeof(title), "Modo 3: Mostrar caixa de recorte"); break;
                         case 4: snprintf(title, sizeof(title), "Modo 4: Linha recortada"); break;
                         case 5: snprintf(title, sizeof(title), "Modo 5: Linha rejeitada"); break;
+                        case 6: snprintf(title, sizeof(title), "Modo 6: Cena com %d formas (setas movem, clique seleciona)", scene.num_shapes); break;
+                        case 7: snprintf(title, sizeof(title), "Modo 7: Pentágonos instanciados"); break;
+                        case 8: snprintf(title, sizeof(title), "Modo 8: Polígonos sobrepostos (G alterna cena/um a um)"); break;
+                        case 9: snprintf(title, sizeof(title), "Modo 9: Estrela girando (A alterna anti-aliasing)"); break;
+                        case 10: snprintf(title, sizeof(title), "Modo 10: Leque de retas (A alterna anti-aliasing)"); break;
+                        case 11: snprintf(title, sizeof(title), "Modo 11: Contornos grossos (+/- mudam a largura)"); break;
+                        case 12: snprintf(title, sizeof(title), "Modo 12: Polígono com furos (R alterna a regra)"); break;
+                        case 13: snprintf(title, sizeof(title), "Modo 13: Malha (T alterna top-left/scanline)"); break;
+                        case 14: snprintf(title, sizeof(title), "Modo 14: Thread de renderização (+/- mudam a carga)"); break;
+                        case 15: snprintf(title, sizeof(title), "Modo 15: ARGB8888, RGB565, 8 bits e 1 bit"); break;
+                        case 16: snprintf(title, sizeof(title), "Modo 16: Desenho progressivo (+/- orçamento, R reinicia)"); break;
                         default: snprintf(title, sizeof(title), "Modo"); break;
                     }
                     SDL_SetWindowTitle(window, title);
                 } else if (e.key.keysym.sym == SDLK_ESCAPE) {
                     running = 0;
+                } else if (e.key.keysym.sym == SDLK_F1) {
+                    show_stats = !show_stats;
+                } else if (e.key.keysym.sym == SDLK_l) {
+                    latency_print(&latency);
+                } else if (e.key.keysym.sym == SDLK_o && overdraw_ok && fb.pixels && mode != 14) {
+                    show_overdraw = !show_overdraw;
+                } else if ((mode == 9 || mode == 10) && e.key.keysym.sym == SDLK_a) {
+                    anti_aliased = !anti_aliased;
+                } else if (mode == 13 && e.key.keysym.sym == SDLK_t) {
+                    mesh_topleft = !mesh_topleft;
+                } else if (mode == 12 && e.key.keysym.sym == SDLK_r) {
+                    contour_rule = contour_rule == FILL_EVEN_ODD ? FILL_NONZERO : FILL_EVEN_ODD;
+                } else if (mode == 16 && e.key.keysym.sym == SDLK_r) {
+                    progressive_restart = true;
+                } else if (mode == 8 && e.key.keysym.sym == SDLK_g) {
+                    scene_fill = !scene_fill;
+                } else if (e.key.keysym.sym == SDLK_p) {
+                    // Liga/desliga as texturas pré-renderizadas (para comparar)
+                    mode_textures.enabled = !mode_textures.enabled;
+                } else if (mode >= 3 && mode <= 5 &&
+                           (e.key.keysym.sym == SDLK_EQUALS || e.key.keysym.sym == SDLK_PLUS || e.key.keysym.sym == SDLK_KP_PLUS)) {
+                    // '+' aumenta a janela de recorte (invalida os caches das linhas)
+                    set_clip_window(X_MIN - 10, Y_MIN - 10, X_MAX + 10, Y_MAX + 10);
+                } else if (mode >= 3 && mode <= 5 &&
+                           (e.key.keysym.sym == SDLK_MINUS || e.key.keysym.sym == SDLK_KP_MINUS)) {
+                    set_clip_window(X_MIN + 10, Y_MIN + 10, X_MAX - 10, Y_MAX - 10);
+                } else if (mode == 14 && (e.key.keysym.sym == SDLK_EQUALS || e.key.keysym.sym == SDLK_PLUS || e.key.keysym.sym == SDLK_KP_PLUS)) {
+                    render_load = SDL_min(render_load * 2, 256);
+                } else if (mode == 14 && (e.key.keysym.sym == SDLK_MINUS || e.key.keysym.sym == SDLK_KP_MINUS)) {
+                    render_load = SDL_max(render_load / 2, 1);
+                } else if (mode == 16 && (e.key.keysym.sym == SDLK_EQUALS || e.key.keysym.sym == SDLK_PLUS || e.key.keysym.sym == SDLK_KP_PLUS)) {
+                    raster_budget_ms = SDL_min(raster_budget_ms * 2.0, 64.0);
+                } else if (mode == 16 && (e.key.keysym.sym == SDLK_MINUS || e.key.keysym.sym == SDLK_KP_MINUS)) {
+                    raster_budget_ms = SDL_max(raster_budget_ms / 2.0, 0.5);
+                } else if (mode == 11 && (e.key.keysym.sym == SDLK_EQUALS || e.key.keysym.sym == SDLK_PLUS || e.key.keysym.sym == SDLK_KP_PLUS)) {
+                    stroke_width = SDL_min(stroke_width + 2.0f, 60.0f);
+                } else if (mode == 11 && (e.key.keysym.sym == SDLK_MINUS || e.key.keysym.sym == SDLK_KP_MINUS)) {
+                    stroke_width = SDL_max(stroke_width - 2.0f, 2.0f);
+                } else if (mode == 6) {
+                    // Setas andam pelo mundo
+                    const int step = 64;
+                    if (e.key.keysym.sym == SDLK_LEFT) view.x -= step;
+                    if (e.key.keysym.sym == SDLK_RIGHT) view.x += step;
+                    if (e.key.keysym.sym == SDLK_UP) view.y -= step;
+                    if (e.key.keysym.sym == SDLK_DOWN) view.y += step;
+                    view.x = SDL_clamp(view.x, 0, SCENE_WORLD_SIZE - view.w);
+                    view.y = SDL_clamp(view.y, 0, SCENE_WORLD_SIZE - view.h);
                 }
+            } else if (mode == 6 && e.type == SDL_MOUSEBUTTONDOWN && e.button.button == SDL_BUTTON_LEFT) {
+                // Seleciona a forma sob o cursor; arrastar a move
+                selected = scene_pick(&scene, e.button.x + view.x, e.button.y + view.y);
+                dragging = selected >= 0;
+            } else if (e.type == SDL_MOUSEBUTTONUP && e.button.button == SDL_BUTTON_LEFT) {
+                dragging = false;
+            } else if (e.type == SDL_MOUSEMOTION && (mode == 14 || mode == 16)) {
+                mouse_x = e.motion.x;
+                mouse_y = e.motion.y;
+            } else if (mode == 6 && e.type == SDL_MOUSEMOTION && dragging) {
+                AllocTag prev = alloc_set_tag(ALLOC_TAG_SCENE);
+                scene_move_shape(&scene, selected, e.motion.xrel, e.motion.yrel);
+                alloc_set_tag(prev);
             }
         }
 
+        // No modo 14 quem rasteriza é a thread de renderização, e raster_overdraw
+        // é por thread: o mapa só mostraria zeros, então fica suspenso
+        bool overdraw_active = show_overdraw && mode != 14;
+
+        Uint64 draw_start = SDL_GetPerformanceCounter();
+        stats.cache_rebuilds = 0;
+        raster_pixels_written = 0;
+
+        // Modos estáticos com textura pronta: uma cópia e pronto
+        bool blitted = mode < NUM_STATIC_MODES && mode_textures.enabled && !overdraw_active &&
+                       mode_textures_draw(renderer, &mode_textures, &demo, mode, &stats.cache_rebuilds);
+
         // 5. Limpa a tela (com a cor preta)
-        SDL_SetRenderDrawColor(renderer, 0, 0, 0, 255); // R, G, B, A (Preto)
-        SDL_RenderClear(renderer);
+        if (!blitted) {
+            SDL_SetRenderDrawColor(renderer, 0, 0, 0, 255); // R, G, B, A (Preto)
+            SDL_RenderClear(renderer);
+        }
 
         // 6. --- INÍCIO DOS DESENHOS ---
-        
-        SDL_Rect clip_rect = { X_MIN, Y_MIN, X_MAX - X_MIN, Y_MAX - Y_MIN };
+
+        // Com o mapa de sobreposição, os rasterizadores só contam as escritas
+        if (overdraw_active) {
+            overdraw_reset(&overdraw);
+            raster_overdraw = &overdraw;
+        }
 
         switch (mode) {
-            case 0: //  // Desenhar triangulo
-                SDL_SetRenderDrawColor(renderer, 0, 255, 0, 255);
-                draw_polygon(renderer, triangulo, num_vertices_tri);
+            case 0:
+            case 1:
+            case 2:
+            case 3:
+            case 4:
+            case 5:
+                if (!blitted) {
+                    stats.cache_rebuilds += draw_static_mode(renderer, &demo, mode);
+                }
                 break;
-            case 1: // Encher Triangulo
-                SDL_SetRenderDrawColor(renderer, 0, 255, 0, 255);
-                fill_polygon_scanline(renderer, triangulo, num_vertices_tri);
+            case 6: // Cena grande: só desenha o que a grade diz estar visível
+                alloc_set_tag(ALLOC_TAG_FILL);
+                stats.shapes_visible = draw_scene(renderer, &scene, view, selected);
                 break;
-            case 2: // Desenhar polígono (Pentagono)
+            case 7: { // O mesmo pentágono girando em 8x6 posições
+                const int cols = 8, rows = 6;
+                Affine2D* instances = (Affine2D*)arena_alloc(&frame_arena, cols * rows * sizeof(Affine2D));
+                if (!instances) break;
+
+                // Centro aproximado do pentágono, levado para a origem antes de girar
+                Affine2D to_origin = affine_translate(-150.0f, -375.0f);
+                float t = demo_ticks() / 1000.0f;
+                for (int r = 0; r < rows; ++r) {
+                    for (int c = 0; c < cols; ++c) {
+                        int i = r * cols + c;
+                        Affine2D place = affine_translate((c + 0.5f) * SCREEN_WIDTH / cols, (r + 0.5f) * SCREEN_HEIGHT / rows);
+                        Affine2D spin = affine_rotate(t * (0.5f + 0.1f * i));
+                        Affine2D size = affine_scale(0.3f + 0.05f * (i % 4), 0.3f + 0.05f * (i % 4));
+                        instances[i] = affine_multiply(place, affine_multiply(spin, affine_multiply(size, to_origin)));
+                    }
+                }
+                alloc_set_tag(ALLOC_TAG_FILL);
                 SDL_SetRenderDrawColor(renderer, 255, 0, 0, 255);
-                draw_polygon(renderer, pentagono, num_vertices_pen);
+                draw_polygon_instances(renderer, &pentagono_soa, instances, cols * rows, pentagono_convexo, true);
+                SDL_SetRenderDrawColor(renderer, 255, 200, 0, 255);
+                draw_polygon_instances(renderer, &pentagono_soa, instances, cols * rows, pentagono_convexo, false);
+                break;
+            }
+            case 8: // Muitos polígonos sobrepostos
+                alloc_set_tag(ALLOC_TAG_FILL);
+                if (scene_fill) {
+                    fill_polygons_scene(renderer, overlap_polygons, OVERLAP_NUM_POLYGONS);
+                } else {
+                    fill_polygons_painter(renderer, overlap_polygons, OVERLAP_NUM_POLYGONS);
+                }
+                break;
+            case 9: { // Estrela grande girando devagar, com ou sem anti-aliasing
+                enum { STAR_POINTS = 7 };
+                SDL_FPoint star[2 * STAR_POINTS];
+                SDL_Point star_int[2 * STAR_POINTS];
+                float t = demo_ticks() / 4000.0f;
+                for (int i = 0; i < 2 * STAR_POINTS; ++i) {
+                    float a = t + (float)M_PI * i / STAR_POINTS;
+                    float r = (i % 2) ? 90.0f : 220.0f;
+                    star[i].x = SCREEN_WIDTH / 2 + r * cosf(a);
+                    star[i].y = SCREEN_HEIGHT / 2 + r * sinf(a);
+                    star_int[i].x = (int)lrintf(star[i].x);
+                    star_int[i].y = (int)lrintf(star[i].y);
+                }
+                SDL_Color cor = { 255, 160, 0, 255 };
+                alloc_set_tag(ALLOC_TAG_FILL);
+                if (anti_aliased) {
+                    fill_polygon_aa(renderer, star, 2 * STAR_POINTS, cor);
+                } else {
+                    SDL_SetRenderDrawColor(renderer, cor.r, cor.g, cor.b, cor.a);
+                    fill_polygon_tuned(renderer, star_int, 2 * STAR_POINTS);
+                }
+                break;
+            }
+            case 10: { // Leque de retas girando, desenhado no framebuffer
+                enum { FAN_LINES = 120 };
+                if (!fb.pixels) break;
+                SDL_FPoint (*fan)[2] = (SDL_FPoint(*)[2])arena_alloc(&frame_arena, FAN_LINES * sizeof(*fan));
+                if (!fan) break;
+                make_line_fan(fan, FAN_LINES, SCREEN_WIDTH / 2.0f, SCREEN_HEIGHT / 2.0f, 230.0f, demo_ticks() / 8000.0f);
+                framebuffer_clear(&fb, 0xFF000000);
+                SDL_Color cor = { 120, 220, 255, 255 };
+                for (int i = 0; i < FAN_LINES; ++i) {
+                    framebuffer_draw_line(&fb, fan[i][0].x, fan[i][0].y, fan[i][1].x, fan[i][1].y, cor,
+                                          anti_aliased ? LINE_ANTIALIASED : LINE_ALIASED);
+                }
+                framebuffer_present(renderer, &fb);
+                break;
+            }
+            case 11: { // Zigue-zagues com cada junção/ponta e o pentágono como contorno fechado
+                static const LineJoin joins[3] = { JOIN_MITER, JOIN_ROUND, JOIN_BEVEL };
+                static const LineCap caps[3] = { CAP_BUTT, CAP_ROUND, CAP_SQUARE };
+                static const SDL_Color cores[3] = { { 255, 80, 80, 255 }, { 80, 255, 80, 255 }, { 80, 160, 255, 255 } };
+                alloc_set_tag(ALLOC_TAG_FILL);
+                for (int k = 0; k < 3; ++k) {
+                    SDL_FPoint zigzag[5];
+                    for (int i = 0; i < 5; ++i) {
+                        zigzag[i].x = 60.0f + i * 70.0f;
+                        zigzag[i].y = 80.0f + k * 110.0f + ((i % 2) ? 60.0f : 0.0f);
+                    }
+                    StrokeStyle style = { stroke_width, joins[k], caps[k], 4.0f };
+                    stroke_polyline(renderer, zigzag, 5, false, &style, cores[k]);
+                }
+                SDL_FPoint contorno[5];
+                for (int i = 0; i < num_vertices_pen; ++i) {
+                    contorno[i].x = pentagono[i].x + 330.0f;
+                    contorno[i].y = pentagono[i].y - 180.0f;
+                }
+                StrokeStyle style = { stroke_width, JOIN_MITER, CAP_BUTT, 4.0f };
+                SDL_Color amarelo = { 255, 220, 0, 255 };
+                stroke_polyline(renderer, contorno, num_vertices_pen, true, &style, amarelo);
+                break;
+            }
+            case 12: { // Três contornos numa passada, com a regra escolhida
+                SDL_Point* const contornos[3] = { anel_externo, furo_inverso, furo_mesmo_sentido };
+                const int contagens[3] = { 4, 4, 3 };
+                alloc_set_tag(ALLOC_TAG_FILL);
+                SDL_SetRenderDrawColor(renderer, contour_rule == FILL_EVEN_ODD ? 0 : 255, 200, 120, 255);
+                fill_polygon_contours(renderer, contornos, contagens, 3, contour_rule);
                 break;
-            case 3: // Caixa para fazer o clip
-                SDL_SetRenderDrawColor(renderer, 100, 100, 100, 255);
-                SDL_RenderDrawRect(renderer, &clip_rect);
+            }
+            case 13: { // Malha colorida; os pixels escritos duas vezes ficam brancos
+                void (*fill)(SDL_Renderer*, SDL_Point[], int) = mesh_topleft ? fill_polygon_topleft : fill_polygon_scanline;
+                alloc_set_tag(ALLOC_TAG_FILL);
+                for (int t = 0; t < MESH_NUM_TRIANGLES; ++t) {
+                    SDL_SetRenderDrawColor(renderer, (Uint8)(60 + (t * 37) % 160), (Uint8)(60 + (t * 71) % 160), 90, 255);
+                    fill(renderer, mesh_triangles[t], 3);
+                }
+                if (mesh_counts) {
+                    mesh_count_writes(fill, mesh_counts, &stats.mesh_doubles, &stats.mesh_holes);
+                    SDL_SetRenderDrawColor(renderer, 255, 255, 255, 255);
+                    mesh_draw_doubles(renderer, mesh_counts);
+                }
                 break;
-            case 4: // Linha com o clip
-                SDL_SetRenderDrawColor(renderer, 100, 100, 100, 255);
-                SDL_RenderDrawRect(renderer, &clip_rect);
-                SDL_SetRenderDrawColor(renderer, 0, 0, 255, 255);
-                clip_and_draw_line(renderer, 50.0, 50.0, 600.0, 450.0);
+            }
+            case 14: { // Só monta a lista; quem desenha é a thread
+                CommandList* list = render_thread_begin(&render_thread);
+                if (list) {
+                    SDL_Color fundo = { 0, 0, 0, 255 };
+                    cmdlist_clear(list, fundo);
+                    float t = demo_ticks() / 1000.0f;
+                    for (int k = 0; k < render_load; ++k) {
+                        int dx = (int)(40.0f * cosf(t + k)), dy = (int)(30.0f * sinf(t + k));
+                        const ColoredPolygon* poly = &overlap_polygons[k % OVERLAP_NUM_POLYGONS];
+                        SDL_Point moved[OVERLAP_MAX_VERTICES];
+                        for (int v = 0; v < poly->num_vertices; ++v) {
+                            moved[v].x = poly->vertices[v].x + dx;
+                            moved[v].y = poly->vertices[v].y + dy;
+                        }
+                        cmdlist_fill_polygon(list, moved, poly->num_vertices, poly->color);
+                    }
+                    SDL_Color branco = { 255, 255, 255, 255 };
+                    for (int i = 0; i < 64; ++i) {
+                        float a = t * 0.2f + 2.0f * (float)M_PI * i / 64;
+                        cmdlist_line(list, SCREEN_WIDTH / 2.0f, SCREEN_HEIGHT / 2.0f,
+                                     SCREEN_WIDTH / 2.0f + 230.0f * cosf(a), SCREEN_HEIGHT / 2.0f + 230.0f * sinf(a),
+                                     branco, LINE_ANTIALIASED);
+                    }
+                    render_thread_submit(&render_thread, list);
+                }
+                render_thread_present(renderer, &render_thread);
+
+                // A mira segue o mouse direto no loop de eventos, sem esperar a thread
+                SDL_SetRenderDrawColor(renderer, 0, 255, 0, 255);
+                SDL_RenderDrawLine(renderer, mouse_x - 10, mouse_y, mouse_x + 10, mouse_y);
+                SDL_RenderDrawLine(renderer, mouse_x, mouse_y - 10, mouse_x, mouse_y + 10);
                 break;
-            case 5: // Linha feita com o clip fora da caixa
-                SDL_SetRenderDrawColor(renderer, 100, 100, 100, 255);
-                SDL_RenderDrawRect(renderer, &clip_rect);
+            }
+            case 15: { // A mesma cena nos quatro formatos; a conversão para ARGB é só para mostrar
+                if (!fb.pixels || !format_targets_ok) break;
+                alloc_set_tag(ALLOC_TAG_FILL);
+                float angle = demo_ticks() / 8000.0f;
+                for (int f = 0; f < PIXEL_FORMAT_COUNT; ++f) {
+                    PixelTarget* t = &format_targets[f];
+                    draw_pixel_format_scene(t, 0.5f, angle);
+                    int qx = (f % 2) * t->width, qy = (f / 2) * t->height;
+                    pixel_target_to_argb(t, fb.pixels + (size_t)qy * fb.pitch + qx, fb.pitch);
+                }
+                framebuffer_present(renderer, &fb);
                 SDL_SetRenderDrawColor(renderer, 255, 255, 0, 255);
-                clip_and_draw_line(renderer, 10.0, 10.0, 50.0, 400.0);
+                for (int f = 0; f < PIXEL_FORMAT_COUNT; ++f) {
+                    SDLTest_DrawString(renderer, (f % 2) * SCREEN_WIDTH / 2 + 4, (f / 2) * SCREEN_HEIGHT / 2 + 4, PIXEL_FORMAT_NAMES[f]);
+                }
+                break;
+            }
+            case 16: { // Conteúdo pesado chegando aos poucos; o que não coube no orçamento fica para o próximo quadro
+                if (!stream_fb.pixels) break;
+                if (progressive_restart) {
+                    if (!progressive.endpoints && !progressive_scene_generate(&progressive)) break;
+                    framebuffer_clear(&stream_fb, 0xFF000000);
+                    progressive_scene_schedule(&progressive, &scheduler);
+                    progressive_restart = false;
+                }
+                if (!raster_scheduler_done(&scheduler)) {
+                    // O mapa de sobreposição só contaria: o que o trabalho avança
+                    // não seria desenhado e nunca volta, então ele fica de fora
+                    OverdrawBuffer* prev_overdraw = raster_overdraw;
+                    raster_overdraw = NULL;
+                    raster_scheduler_run(&scheduler, raster_budget_ms);
+                    raster_overdraw = prev_overdraw;
+                } else {
+                    scheduler.used_ms = 0.0;
+                }
+                framebuffer_present(renderer, &stream_fb);
+
+                char line[96];
+                snprintf(line, sizeof(line), "%.1f%% (%d/%d trabalhos), orcamento %.1f ms, usado %.2f ms",
+                         scheduler.work_total ? 100.0 * (double)scheduler.work_done / (double)scheduler.work_total : 100.0,
+                         scheduler.current, scheduler.num_jobs, raster_budget_ms, scheduler.used_ms);
+                SDL_SetRenderDrawColor(renderer, 255, 255, 255, 255);
+                SDLTest_DrawString(renderer, 4, SCREEN_HEIGHT - FONT_LINE_HEIGHT, line);
+
+                // A mira segue o mouse enquanto o resto chega
+                SDL_SetRenderDrawColor(renderer, 0, 255, 0, 255);
+                SDL_RenderDrawLine(renderer, mouse_x - 10, mouse_y, mouse_x + 10, mouse_y);
+                SDL_RenderDrawLine(renderer, mouse_x, mouse_y - 10, mouse_x, mouse_y + 10);
                 break;
+            }
             default:
                 break;
         }
-
+        alloc_set_tag(ALLOC_TAG_RENDERER);
+        raster_overdraw = NULL;
+        if (overdraw_active) {
+            OverdrawSummary summary;
+            overdraw_summarize(&overdraw, &summary);
+            overdraw_present(renderer, &overdraw, &summary, &fb);
+        }
 
         // --- FIM DOS DESENHOS ---
 
+        if (mode < NUM_STATIC_MODES) {
+            static_draw_ms[blitted] += (double)(SDL_GetPerformanceCounter() - draw_start) * 1000.0 / (double)SDL_GetPerformanceFrequency();
+            static_frames[blitted]++;
+        }
+
+        perf_frame_end();
+        if (show_stats) {
+            draw_stats_overlay(renderer, &stats);
+        }
+
+        stats.arena_used = frame_arena.used;
+        stats.arena_high = frame_arena.high_water;
+        stats.arena_capacity = frame_arena.capacity;
+        stats.alloc_delta = SDL_GetNumAllocations() - allocs_before;
+        stats.shapes_total = mode == 6 ? scene.grid.num_items : 0;
+        stats.pixels_written = raster_pixels_written;
+        stats.mesh_test = mode == 13;
+        stats.render_thread = mode == 14;
+        stats.render_ms = SDL_AtomicGet(&render_thread.render_us) / 1000.0;
+        stats.render_latency_ms = SDL_AtomicGet(&render_thread.latency_us) / 1000.0;
+        stats.render_dropped = render_thread.dropped;
+        stats.frame_ms = (double)(SDL_GetPerformanceCounter() - frame_start) * 1000.0 / (double)SDL_GetPerformanceFrequency();
+
         // 7. Atualiza a tela
+        Uint64 raster_end = SDL_GetPerformanceCounter();
         SDL_RenderPresent(renderer);
+        latency_frame(&latency, draw_start, raster_end, SDL_GetPerformanceCounter());
+        if (latency.count > 0) {
+            double p[4];
+            latency_percentiles(&latency, LATENCY_TOTAL, p);
+            stats.latency_samples = latency.count;
+            stats.latency_p50 = p[0];
+            stats.latency_p95 = p[1];
+            stats.latency_p99 = p[2];
+        }
+        if (input_log.replay) {
+            frame_times_add(&frame_times, (double)(SDL_GetPerformanceCounter() - frame_start) * 1000.0 / (double)SDL_GetPerformanceFrequency());
+        }
+
+        alloc_dump_frame(alloc_since, frame_number++);
+    }
+
+    // Comparação entre redesenhar e copiar a textura (tempo de CPU)
+    for (int i = 0; i < 2; ++i) {
+        if (static_frames[i] > 0) {
+            printf("Modos estaticos, %s: %.3f ms/quadro em %llu quadros\n",
+                   i ? "textura pre-renderizada" : "redesenho imediato",
+                   static_draw_ms[i] / static_frames[i], (unsigned long long)static_frames[i]);
+        }
+    }
+
+    if (input_log.replay) {
+        printf("Reproducao: %d quadros, %d eventos\n", input_log.frames, input_log.events);
+        frame_times_print_histogram(&frame_times);
+    } else if (input_log.file) {
+        printf("Gravacao: %d quadros, %d eventos\n", input_log.frames, input_log.events);
     }
+    input_log_close(&input_log);
+    SDL_free(frame_times.ms);
+    if (latency.total_samples > 0) latency_print(&latency);
+    perf_print_run((int)frame_number);
+    perf_shutdown();
 
     // 8. Limpa e sai
+    mode_textures_invalidate(&mode_textures);
+    framebuffer_destroy(&fb);
+    for (int f = 0; f < PIXEL_FORMAT_COUNT; ++f) pixel_target_destroy(&format_targets[f]);
+    render_thread_stop(&render_thread);
+    SDL_free(mesh_counts);
+    overdraw_destroy(&overdraw);
+    raster_scheduler_clear(&scheduler);
+    progressive_scene_destroy(&progressive);
+    framebuffer_destroy(&stream_fb);
+    demo_shapes_destroy(&demo);
+    soa_destroy(&pentagono_soa);
+    scene_destroy(&scene);
+    arena_destroy(&frame_arena);
     SDL_DestroyRenderer(renderer);
     SDL_DestroyWindow(window);
     SDL_Quit();
+    alloc_dump_totals();
 
     return 0;
 }
\ No newline at end of file